@@ -6,25 +6,78 @@
 #define REALSENSERECORD_REALSENSECAPTURE_H
 
 #include <AndreiUtils/classes/Timer.hpp>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <RealsenseRecording/recording/DepthRegistration.h>
+#include <RealsenseRecording/recording/FrameView.h>
+#include <RealsenseRecording/recording/ImagePixelFormat.h>
+#include <RealsenseRecording/recording/LatencyHistogram.h>
 #include <RealsenseRecording/recording/ReadRecording.h>
 #include <RealsenseRecording/recording/WriteRecording.h>
 #include <string>
+#include <thread>
+#include <utility>
+#include <vector>
 
 namespace RealsenseRecording {
     class RealsenseCapture {
     public:
+        // With colorPixelFormat IMAGE_YUYV, the live color stream is captured in the camera's YUYV and recorded as it
+        // is (only in the "bin" image format, see WriteRecording::setImagePixelFormat); the images of the capture are
+        // converted from it
         explicit RealsenseCapture(int fps, bool withRecord = false, int recordedFileNumber = -1,
                                   const std::string &recordedBagFile = "", int colorWidth = 1280, int colorHeight = 720,
                                   int depthWidth = 640, int depthHeight = 480,
                                   const std::string &recordImageFormat = "avi",
                                   const std::string &recordDepthFormat = "bin",
                                   const std::string &recordParametersFormat = "xml", bool withOpenCV = false,
-                                  bool withFrameAlignment = true, bool writeFPSOnImage = false);
+                                  bool withFrameAlignment = true, bool writeFPSOnImage = false,
+                                  bool withRawDepth = false, int replayPrefetchSize = 0,
+                                  ImagePixelFormat colorPixelFormat = IMAGE_RGB8);
 
         ~RealsenseCapture();
 
+        // Captures (and records) frames until the stream ends or stop is called. Unless headless, the frames are shown
+        // by a separate display thread, which also stops the capture on the 'q' or Esc key
         void run();
 
+        // Can be called from any thread and from signal handlers
+        void stop();
+
+        // Without the display thread and its windows; only stop (or the end of the stream) ends run
+        void setHeadless(bool headless);
+
+        bool isHeadless() const;
+
+        // The rate at which the display thread shows the most recent frame
+        void setDisplayFps(double displayFps);
+
+        // With n > 0, the live camera frames are acquired on their own thread and aligned by n worker threads (out of
+        // order, then put back in order for run); 0 does everything on the thread of run. The conversions of the live
+        // frames are not done there: the getters below do them on first use
+        void setNrProcessingThreads(int nrProcessingThreads);
+
+        // The type of the depth in meters (also of getDepth); to be set before run. Raw depth mode keeps uint16
+        void setDepthElementType(DepthElementType depthElementType);
+
+        DepthElementType getDepthElementType() const;
+
+        // With frame alignment, the live depth is registered to the color frames with a DepthRegistration built once
+        // from the camera calibration instead of rs2::align; to be set before run. The recording then keeps the depth
+        // frames unaligned (see WriteRecording::setUnalignedDepth), since the registered depth has no rs2::frame.
+        // Replayed recordings with unaligned depth are always registered this way (see ReadRecording::setAlignedDepth)
+        void setAlignWithRegistration(bool alignWithRegistration);
+
+        bool isAlignWithRegistration() const;
+
+        // The live frames are only kept as rs2 frames: the image and depth (registered, converted to meters or to the
+        // depth element type) are converted on the first call of their getter for the frame and cached until the next
+        // one, so that frames which are only recorded cost no conversions. The const getters do not convert: they are
+        // empty until the non-const ones were called for the frame. Replayed frames are converted by ReadRecording
         #ifdef OPENCV
         cv::Mat &getImage();
 
@@ -39,6 +92,29 @@ namespace RealsenseRecording {
         void setDepth(const cv::Mat &_depth);
         #endif
 
+        // Without the OpenCV backend (withOpenCV): the RGB image, and the depth of the capture's depth type (the one of
+        // getDepthElementType in meters, uint16 in raw depth mode; nullptr for the other types) with the size of
+        // getDepthIntrinsics. They are valid until the next frame
+        const uint8_t *getImageData();
+
+        const double *getDepthData();
+
+        const float *getFloatDepthData();
+
+        const uint16_t *getRawDepthData();
+
+        // The data of the getters above with its size, without copies or transfer of ownership: the buffers behind
+        // the views are allocated once and reused for every frame, so they are only valid until the next frame. The
+        // live raw depth is viewed straight in the depth frame (stride included) when it needs no registration. Empty
+        // when the capture's representation or depth type has no such data
+        ImageView getImageView();
+
+        FrameView<double> getDepthView();
+
+        FrameView<float> getFloatDepthView();
+
+        DepthView getRawDepthView();
+
         rs2::frame &getImageFrame();
 
         rs2::video_frame getImageFrame() const;
@@ -53,17 +129,74 @@ namespace RealsenseRecording {
 
         void setDepthIntrinsics(const rs2_intrinsics &_depthIntrinsics);
 
+        // Meters per unit of the uint16 depth values handled in raw depth mode
+        float getDepthUnits() const;
+
         bool saveData();
 
+        // The latencies of the capture stages (waiting for the camera, alignment, conversions, reading the replayed
+        // recording, saveData and the whole frame), the frame rate and, when recording, the writer's stats (see
+        // WriteRecording::getStats)
+        void getStats(nlohmann::json &stats) const;
+
+        // While running, getStats is written to the json file every periodSeconds and once at the end; an empty file
+        // disables it
+        void setStatsDump(const std::string &file, double periodSeconds);
+
     private:
+        // The result of aligning one frameset
+        struct CapturedFrame {
+            rs2::frame imageFrame, depthFrame;
+            rs2_intrinsics depthIntrinsics{};
+            // not empty when processing the frameset failed
+            std::string error;
+        };
+
         bool updateFrame();
 
-        void computeAndDisplayFps();
+        bool updateCameraFrame();
+
+        bool updateProcessedFrame();
+
+        void processFrameset(rs2::frameset frameset, rs2::align &align, CapturedFrame &captured);
+
+        void takeCapturedFrame(CapturedFrame &captured);
+
+        // The conversions of the current live frame, done once by the getters
+        void convertImage();
+
+        void convertDepth();
+
+        // Registers the live depth frame into registeredDepth (with alignWithRegistration)
+        void registerDepthFrame();
+
+        void startProcessingThreads();
+
+        void stopProcessingThreads();
+
+        void acquisitionThreadRun();
+
+        void processingThreadRun();
+
+        void computeFps();
+
+        void waitForReplayTime();
+
+        void dumpStats();
+
+        #ifdef OPENCV
+        void publishDisplayFrame();
+
+        void displayThreadRun();
+        #endif
 
         int IMAGE_WIDTH, IMAGE_HEIGHT, IMAGE_FPS, DEPTH_WIDTH, DEPTH_HEIGHT, DEPTH_FPS;
+        // of the live color stream
+        ImagePixelFormat colorPixelFormat;
 
         rs2::pipeline pipeline;
         rs2::align alignTo;
+        DepthRegistration depthRegistration;
         rs2::config startConfig;
         rs2::frameset frames;
 
@@ -74,6 +207,16 @@ namespace RealsenseRecording {
         #endif
         uint8_t *imageData{};
         double *depthData{};
+        float *floatDepthData{};
+        uint16_t *rawDepthData{};
+        // the live depth registered to the image, in depth units
+        std::vector<uint16_t> registeredDepth;
+        // whether the image / depth above are the ones of the current frame
+        bool imageConverted, depthConverted;
+        // the allocated elements of the live frame buffers above (the replayed ones keep the recording's size)
+        size_t imageDataCapacity, depthDataCapacity, floatDepthDataCapacity, rawDepthDataCapacity;
+        DepthElementType depthElementType;
+        float depthUnits;
         rs2_intrinsics depthIntrinsics;
 
         ReadRecording *inputRecording;
@@ -87,9 +230,44 @@ namespace RealsenseRecording {
         const cv::Scalar SCALAR_RED = cv::Scalar(0.0, 0.0, 255.0);
         #endif
 
+        // the recorded timestamp and the time at which the replay started (or restarted after a jump back in time)
+        double replayStartTimestamp;
+        std::chrono::steady_clock::time_point replayStartTime;
+
+        LatencyHistogram waitForFramesLatency, alignLatency, conversionLatency, readLatency, saveLatency, frameLatency;
+        std::chrono::steady_clock::time_point statsStart, lastStatsDump;
+        std::string statsFile;
+        double statsDumpPeriod;
+
+        std::atomic<bool> stopRequested;
+        bool headless;
+        double displayFps;
+        std::thread displayThread;
+        #ifdef OPENCV
+        // the capture thread fills the back frames and swaps them with the pending ones, which the display thread swaps
+        // with the shown ones, so that only the swaps happen under the lock
+        std::mutex displayLock;
+        cv::Mat displayImageBack, displayDepthBack, displayImagePending, displayDepthPending;
+        bool displayFramePending = false;
+        #endif
+
+        // the processing pipeline: acquisition thread -> processingJobs -> processing threads -> processedFrames (by
+        // acquisition number) -> updateFrame; at most 2 * nrProcessingThreads frames are in flight
+        int nrProcessingThreads;
+        std::thread acquisitionThread;
+        std::vector<std::thread> processingThreads;
+        std::mutex processingLock;
+        std::condition_variable jobCondition, slotCondition, processedCondition;
+        std::deque<std::pair<unsigned long long, rs2::frameset>> processingJobs;
+        std::map<unsigned long long, CapturedFrame> processedFrames;
+        unsigned long long nrAcquiredFrames, nextProcessedFrame;
+        int nrInFlightFrames;
+        bool acquisitionEnded, processingStopped;
+        std::string acquisitionError;
+
         AndreiUtils::Timer fpsTimer;
         int fps = 0, sleepTime = 0;
-        bool writeFPSOnImage, withOpenCV, withFrameAlignment;
+        bool writeFPSOnImage, withOpenCV, withFrameAlignment, withRawDepth, alignWithRegistration;
     };
 }
 
@@ -0,0 +1,18 @@
+#ifndef REALSENSERECORD_BUFFEROVERFLOWPOLICY_H
+#define REALSENSERECORD_BUFFEROVERFLOWPOLICY_H
+
+#include <string>
+
+namespace RealsenseRecording {
+    enum BufferOverflowPolicy {
+        BLOCK_WHEN_FULL,
+        DROP_NEWEST,
+        DROP_OLDEST,
+    };
+
+    BufferOverflowPolicy bufferOverflowPolicyFromString(const std::string &policy);
+
+    std::string bufferOverflowPolicyToString(BufferOverflowPolicy policy);
+}
+
+#endif //REALSENSERECORD_BUFFEROVERFLOWPOLICY_H
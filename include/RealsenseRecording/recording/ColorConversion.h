@@ -0,0 +1,29 @@
+#ifndef REALSENSERECORD_COLORCONVERSION_H
+#define REALSENSERECORD_COLORCONVERSION_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace RealsenseRecording {
+    // Conversions of the cameras' native YUYV images (YUY2: Y0 U Y1 V for every 2 pixels) to 3 bytes per pixel, with
+    // the BT.601 coefficients librealsense uses for RS2_FORMAT_RGB8, so that recording YUYV and converting it when
+    // reading gives the images a RGB8 stream would have given. The kernels are vectorized with SSSE3 when the CPU
+    // supports it (chosen once at runtime), with a scalar fallback, and run on the calling thread
+    class ColorConversion {
+    public:
+        // yuyv holds nrPixels pixels (an even number, e.g. a number of rows of an even width), rgb 3 * nrPixels bytes
+        static void yuyvToRgb(const uint8_t *yuyv, uint8_t *rgb, size_t nrPixels);
+
+        static void yuyvToBgr(const uint8_t *yuyv, uint8_t *bgr, size_t nrPixels);
+
+        // "ssse3" or "scalar"
+        static std::string getInstructionSet();
+
+        // Forces the given instruction set (e.g. "scalar" for comparisons); false if the CPU does not support it.
+        // Not to be called while converting on other threads
+        static bool setInstructionSet(const std::string &instructionSet);
+    };
+}
+
+#endif //REALSENSERECORD_COLORCONVERSION_H
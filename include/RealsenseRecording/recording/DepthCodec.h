@@ -0,0 +1,65 @@
+#ifndef REALSENSERECORD_DEPTHCODEC_H
+#define REALSENSERECORD_DEPTHCODEC_H
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <vector>
+
+namespace RealsenseRecording {
+    // Lossless depth compression for the "rvl" depth format: each frame is split into horizontal bands of rows which
+    // are encoded independently (and in parallel) with RVL (A. D. Wilson, "Fast Lossless Depth Image Compression",
+    // 2017): runs of zeros and of valid pixels, the valid pixels as the zigzag encoded difference to the previous
+    // valid pixel, all written as variable-length 3 bit nibbles.
+    // A frame is written as: height, width, nrChunks, the byte size of each chunk (all uint32) and the chunk data.
+    class DepthCodec {
+    public:
+        static const int DEFAULT_NR_CHUNKS = 8;
+
+        explicit DepthCodec(int nrChunks = DEFAULT_NR_CHUNKS);
+
+        ~DepthCodec();
+
+        void setNrChunks(int nrChunks);
+
+        int getNrChunks() const;
+
+        void encode(const uint16_t *depth, int height, int width, std::ostream *out);
+
+        // The frame has to have the given dimensions; false at the end of the file
+        bool decode(std::istream *in, uint16_t *depth, int height, int width);
+
+        // Encodes the bands of the depth image in parallel into the chunk buffers; returns their total size
+        size_t encodeToBuffers(const uint16_t *depth, int height, int width);
+
+        // The number of chunks of the last encoded frame (at most one per row)
+        int getNrEncodedChunks() const;
+
+        const std::vector<uint8_t> &getChunkBuffer(int chunk) const;
+
+        unsigned long long getNrRawBytes() const;
+
+        unsigned long long getNrEncodedBytes() const;
+
+        // raw / encoded size of all the frames encoded so far
+        double getCompressionRatio() const;
+
+        static size_t encodeChunk(const uint16_t *depth, size_t nrPixels, std::vector<uint8_t> &out);
+
+        static bool decodeChunk(const uint8_t *data, size_t size, uint16_t *depth, size_t nrPixels);
+
+    private:
+        static int getChunkFirstRow(int chunk, int nrChunks, int height);
+
+        // Worst case byte size of an encoded chunk of nrPixels pixels
+        static size_t getMaxChunkSize(size_t nrPixels);
+
+        int nrChunks, nrEncodedChunks;
+        std::vector<std::vector<uint8_t>> chunkBuffers;
+        std::vector<uint32_t> chunkSizes;
+        unsigned long long nrRawBytes, nrEncodedBytes;
+    };
+}
+
+#endif //REALSENSERECORD_DEPTHCODEC_H
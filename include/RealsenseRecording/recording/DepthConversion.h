@@ -0,0 +1,35 @@
+#ifndef REALSENSERECORD_DEPTHCONVERSION_H
+#define REALSENSERECORD_DEPTHCONVERSION_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace RealsenseRecording {
+    // Conversions between the uint16 depth values (in depth units, see RecordingParameters::depthUnits) and meters.
+    // The kernels are vectorized with AVX2, SSE4.1 or NEON, chosen once at runtime from what the CPU supports, with a
+    // scalar fallback; they run on the calling thread, since they are bound by the memory bandwidth anyway.
+    // The conversions to depth units round to the nearest value and saturate to [0, 65535] (NaN becomes 0).
+    class DepthConversion {
+    public:
+        static void toMeters(const uint16_t *depth, double *meters, size_t nrElements, float depthUnits);
+
+        static void toMeters(const uint16_t *depth, float *meters, size_t nrElements, float depthUnits);
+
+        static void toDepthUnits(const double *meters, uint16_t *depth, size_t nrElements, float depthUnits);
+
+        static void toDepthUnits(const float *meters, uint16_t *depth, size_t nrElements, float depthUnits);
+
+        // depth * scale, e.g. from the sensor's depth units to the recording's; rescaled may be depth
+        static void rescale(const uint16_t *depth, uint16_t *rescaled, size_t nrElements, float scale);
+
+        // "avx2", "sse4.1", "neon" or "scalar"
+        static std::string getInstructionSet();
+
+        // Forces the given instruction set (e.g. "scalar" for comparisons); false if the CPU does not support it.
+        // Not to be called while converting on other threads
+        static bool setInstructionSet(const std::string &instructionSet);
+    };
+}
+
+#endif //REALSENSERECORD_DEPTHCONVERSION_H
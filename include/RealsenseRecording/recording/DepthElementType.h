@@ -0,0 +1,19 @@
+#ifndef REALSENSERECORD_DEPTHELEMENTTYPE_H
+#define REALSENSERECORD_DEPTHELEMENTTYPE_H
+
+#include <string>
+
+namespace RealsenseRecording {
+    // The type of the depth values in meters (CV_64F or CV_32F in cv::Mat); float halves the memory of a depth frame
+    // and still resolves fractions of a millimeter up to the sensors' range
+    enum DepthElementType {
+        DEPTH_DOUBLE,
+        DEPTH_FLOAT,
+    };
+
+    DepthElementType depthElementTypeFromString(const std::string &type);
+
+    std::string depthElementTypeToString(DepthElementType type);
+}
+
+#endif //REALSENSERECORD_DEPTHELEMENTTYPE_H
@@ -0,0 +1,67 @@
+#ifndef REALSENSERECORD_DEPTHREGISTRATION_H
+#define REALSENSERECORD_DEPTHREGISTRATION_H
+
+#include <cstdint>
+#include <librealsense2/rs.hpp>
+#include <vector>
+
+namespace RealsenseRecording {
+    // Registers depth frames to the color frames with the result of rs2::align(RS2_STREAM_COLOR): every depth pixel
+    // is deprojected, moved to the color camera and projected onto the color pixels it covers, which get the smallest
+    // depth that lands on them (0 where none does; depth pixels which do not land completely inside the color frame
+    // are dropped).
+    // Since the calibration does not change, the corners of the depth pixels are deprojected and rotated to the color
+    // camera once, in setParameters; per frame, they are only scaled by the depth, translated and projected (row by
+    // row, in vectorized loops), and splatted into the color frame. Both steps run in parallel over bands of rows: the
+    // splat over bands of color rows, so that each band's z-buffer is only written by one thread.
+    class DepthRegistration {
+    public:
+        static const int DEFAULT_NR_BANDS = 8;
+
+        explicit DepthRegistration(int nrBands = DEFAULT_NR_BANDS);
+
+        void setParameters(const rs2_intrinsics &_depthIntrinsics, const rs2_intrinsics &_colorIntrinsics,
+                           const rs2_extrinsics &_depthToColor, float _depthUnits);
+
+        bool isInitialized() const;
+
+        // The number of row bands processed in parallel; 1 registers on the calling thread only
+        void setNrBands(int nrBands);
+
+        int getNrBands() const;
+
+        // depth is depthIntrinsics.height x depthIntrinsics.width, registered colorIntrinsics.height x
+        // colorIntrinsics.width; both are in depth units and must not overlap
+        void registerDepth(const uint16_t *depth, uint16_t *registered);
+
+        int getRegisteredHeight() const;
+
+        int getRegisteredWidth() const;
+
+    protected:
+        static int getBandFirstRow(int band, int nrBands, int height);
+
+        // Projects the corners of the pixels of the depth row into the color frame: the color pixel rectangles, and
+        // the range of color rows they cover
+        void projectRow(int row, const uint16_t *depthRow);
+
+        rs2_intrinsics depthIntrinsics;
+        rs2_intrinsics colorIntrinsics;
+        rs2_extrinsics depthToColor;
+        float depthUnits;
+        // the vectorized loops compute the color projection themselves (otherwise rs2_project_point_to_pixel does)
+        bool vectorizedProjection;
+        // the (height + 1) x (width + 1) corners of the depth pixels, deprojected at 1 depth unit and rotated to the
+        // color camera: a pixel's corners at its depth are depth * corner + translation
+        std::vector<float> cornerX, cornerY, cornerZ;
+        // per depth pixel, row by row: the left, top, right and bottom color pixels covered by it (each as a row of
+        // the depth width), or -1 for pixels without depth or outside the color frame
+        std::vector<int16_t> pixelRectangles;
+        // per depth row: the first and last color rows covered by its pixels (first > last if none)
+        std::vector<int> rowRanges;
+        int nrBands;
+        bool initialized;
+    };
+}
+
+#endif //REALSENSERECORD_DEPTHREGISTRATION_H
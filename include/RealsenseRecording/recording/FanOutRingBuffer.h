@@ -0,0 +1,104 @@
+#ifndef REALSENSERECORD_FANOUTRINGBUFFER_H
+#define REALSENSERECORD_FANOUTRINGBUFFER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <RealsenseRecording/recording/BufferOverflowPolicy.h>
+#include <vector>
+
+namespace RealsenseRecording {
+    // Single-producer queue of slot indices which hands every published slot to each of nrReaders readers (e.g. one
+    // writer thread per stream), in publishing order. A slot returns to the producer once all readers released it.
+    // Only whole slots which no reader has started on are dropped, so the readers always see the same sequence.
+    // Besides the "capacity" queued slots, one slot is owned by the producer and one by each reader.
+    // Like SPSCRingBuffer, it is lock-free outside of waiting: the published slots are kept in a fixed ring of
+    // positions, every reader has its own atomic cursor into it and the producer reclaims the slots of the positions
+    // below the slowest cursor
+    class FanOutRingBuffer {
+    public:
+        explicit FanOutRingBuffer(int capacity = 0, int nrReaders = 1);
+
+        FanOutRingBuffer(const FanOutRingBuffer &other) = delete;
+
+        FanOutRingBuffer &operator=(const FanOutRingBuffer &other) = delete;
+
+        ~FanOutRingBuffer();
+
+        // Not thread-safe: only call before the producer and the readers start using the buffer
+        void reset(int capacity, int nrReaders);
+
+        // Producer: returns the slot to fill or -1 if no slot is available (dropped newest frame or buffer closed).
+        // With DROP_OLDEST, the newest frame is dropped instead if every reader already started on the oldest one.
+        int acquireWriteSlot(BufferOverflowPolicy policy, bool &droppedOldest);
+
+        // Producer: hands the slot returned by the last acquireWriteSlot over to the readers
+        void publishWriteSlot();
+
+        // Reader: releases the previously processed slot and waits for the next one; -1 if closed and drained
+        int acquireReadSlot(int reader);
+
+        // Reader: gives up the currently processed slot without acquiring a new one
+        void releaseReadSlot(int reader);
+
+        // Wakes up all sides; the readers still receive all slots published before the call
+        void close();
+
+        bool isClosed() const;
+
+        int getCapacity() const;
+
+        int getNrSlots() const;
+
+        int getNrReaders() const;
+
+        // Published positions which the slowest reader has not released yet (the one it processes included)
+        int size() const;
+
+    private:
+        static const size_t CACHE_LINE_SIZE = 64;
+        // the ring entry of a position: the slot index shifted left by one, with the lowest bit set once a reader
+        // started on it, or DROPPED_POSITION once the producer took the slot back
+        static const int DROPPED_POSITION = -1;
+
+        // the position a reader processes (while slot >= 0) or reads next; only written by the reader
+        struct ReaderCursor {
+            std::atomic<unsigned long long> position;
+            int slot;
+            char padding[CACHE_LINE_SIZE - sizeof(std::atomic<unsigned long long>) - sizeof(int)];
+        };
+
+        unsigned long long getSlowestPosition() const;
+
+        unsigned long long getFastestPosition() const;
+
+        // Producer: frees the slots of the positions which every reader passed
+        void reclaimSlots();
+
+        int dropOldestUnreadSlot();
+
+        void notifyProducer();
+
+        void notifyReaders();
+
+        int capacity, nrSlots, nrReaders, nrPositions;
+        std::unique_ptr<std::atomic<int>[]> positions;
+        std::unique_ptr<ReaderCursor[]> readers;
+
+        // written by the producer only
+        std::atomic<unsigned long long> head;
+        char headPadding[CACHE_LINE_SIZE - sizeof(std::atomic<unsigned long long>)]{};
+        // the producer's state: the first position whose slot was not reclaimed yet and a stack of the free slots
+        unsigned long long reclaimedPosition;
+        std::vector<int> freeSlots;
+        int nrFreeSlots, producerSlot;
+
+        std::atomic<bool> producerWaiting, closed;
+        std::atomic<int> nrWaitingReaders;
+        std::mutex waitLock;
+        std::condition_variable producerCondition, readerCondition;
+    };
+}
+
+#endif //REALSENSERECORD_FANOUTRINGBUFFER_H
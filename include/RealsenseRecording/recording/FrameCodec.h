@@ -0,0 +1,82 @@
+#ifndef REALSENSERECORD_FRAMECODEC_H
+#define REALSENSERECORD_FRAMECODEC_H
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <RealsenseRecording/recording/DepthCodec.h>
+#include <RealsenseRecording/recording/RecordingParameters.h>
+
+#ifdef OPENCV
+#include <opencv2/opencv.hpp>
+#endif
+
+namespace RealsenseRecording {
+    // The pixels of a frame: Channels elements of type T per pixel, in rows without padding
+    template<typename T, int Channels>
+    struct FrameLayout {
+        typedef T Element;
+        static const int CHANNELS = Channels;
+
+        static size_t getNrElements(int height, int width) {
+            return (size_t) height * width * Channels;
+        }
+
+        static size_t getNrBytes(int height, int width) {
+            return FrameLayout::getNrElements(height, width) * sizeof(T);
+        }
+    };
+
+    // The layouts of the recorded streams: 3 byte images, YUYV images as one 16 bit element per pixel (see
+    // ImagePixelFormat) and depth in depth units
+    typedef FrameLayout<uint8_t, 3> Rgb8Layout;
+    typedef FrameLayout<uint16_t, 1> YuyvLayout;
+    typedef FrameLayout<uint16_t, 1> DepthLayout;
+
+    // Writes and reads the frames of one stream of a recording in its format ("bin" or "rvl"). The readers and
+    // writers create the codecs of their streams once, from the recording's parameters, so that the format and the
+    // pixel layout are not looked up again per frame; the implementations are specialized on the layout at compile
+    // time. "avi" images have no codec: OpenCV writes and reads them. The "bin" frames of containers are the raw
+    // pixels (the chunk header has their size); the ones of "bin" files are AndreiUtils records, written to files only
+    class FrameCodec {
+    public:
+        // nullptr for "avi" images; the pixel layout follows the recording's image pixel format
+        static std::unique_ptr<FrameCodec> createImageCodec(const RecordingParameters &parameters);
+
+        // the recorded depth size; "rvl" frames are encoded and decoded by depthCodec
+        static std::unique_ptr<FrameCodec> createDepthCodec(const RecordingParameters &parameters,
+                                                            DepthCodec &depthCodec);
+
+        virtual ~FrameCodec();
+
+        // frame holds the getNrBytes bytes of a frame of the codec's size
+        virtual void write(std::ostream *out, const uint8_t *frame) = 0;
+
+        // false at the end of the file
+        virtual bool read(std::ifstream *in, uint8_t *frame) = 0;
+
+        #ifdef OPENCV
+
+        virtual void write(std::ostream *out, cv::Mat &frame) = 0;
+
+        // frame gets the codec's size and layout
+        virtual bool read(std::ifstream *in, cv::Mat &frame) = 0;
+
+        #endif
+
+        int getHeight() const;
+
+        int getWidth() const;
+
+        size_t getNrBytes() const;
+
+    protected:
+        FrameCodec(int height, int width, size_t nrBytes);
+
+        int height, width;
+        size_t nrBytes;
+    };
+}
+
+#endif //REALSENSERECORD_FRAMECODEC_H
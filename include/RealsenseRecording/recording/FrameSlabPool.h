@@ -0,0 +1,57 @@
+#ifndef REALSENSERECORD_FRAMESLABPOOL_H
+#define REALSENSERECORD_FRAMESLABPOOL_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace RealsenseRecording {
+    // One fixed-size slab (image bytes followed by depth values) per buffer slot. Slabs are allocated once, either
+    // upfront through preallocate or on the first use of their slot, and are then recycled together with the slot.
+    // The image and the depth slab of a slot may be requested concurrently (e.g. by the per-stream writer threads):
+    // the lazy allocation of a slot is published with a compare-and-swap, so requesting a slab never takes a lock.
+    class FrameSlabPool {
+    public:
+        FrameSlabPool();
+
+        FrameSlabPool(const FrameSlabPool &other) = delete;
+
+        FrameSlabPool &operator=(const FrameSlabPool &other) = delete;
+
+        ~FrameSlabPool();
+
+        void reset(int nrSlots, size_t nrImageBytes, size_t nrDepthElements);
+
+        void preallocate(int nrPreallocatedSlots);
+
+        uint8_t *getImageSlab(int slot);
+
+        uint16_t *getDepthSlab(int slot);
+
+        bool isInitialized() const;
+
+        int getNrSlots() const;
+
+        size_t getNrImageBytes() const;
+
+        size_t getNrDepthElements() const;
+
+        unsigned long long getNrAllocations() const;
+
+    private:
+        static const size_t SLAB_ALIGNMENT = 64;
+
+        uint8_t *getSlab(int slot);
+
+        void releaseSlabs();
+
+        // the allocations of the slots, SLAB_ALIGNMENT - 1 bytes larger than a slab to align its start
+        std::unique_ptr<std::atomic<uint8_t *>[]> slabs;
+        int nrSlots;
+        size_t nrImageBytes, nrDepthElements, depthOffset;
+        std::atomic<unsigned long long> nrAllocations;
+    };
+}
+
+#endif //REALSENSERECORD_FRAMESLABPOOL_H
@@ -0,0 +1,30 @@
+#ifndef REALSENSERECORD_FRAMEVIEW_H
+#define REALSENSERECORD_FRAMEVIEW_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace RealsenseRecording {
+    // Read-only view of a frame stored elsewhere (e.g. in a memory mapped recording); stride is in elements of T
+    template<typename T>
+    struct FrameView {
+        const T *data;
+        int height, width, channels;
+        size_t stride;
+
+        FrameView() : data(nullptr), height(0), width(0), channels(0), stride(0) {}
+
+        const T *row(int r) const {
+            return this->data + (size_t) r * this->stride;
+        }
+
+        bool empty() const {
+            return this->data == nullptr;
+        }
+    };
+
+    typedef FrameView<uint8_t> ImageView;
+    typedef FrameView<uint16_t> DepthView;
+}
+
+#endif //REALSENSERECORD_FRAMEVIEW_H
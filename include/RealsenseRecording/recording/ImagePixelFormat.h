@@ -0,0 +1,20 @@
+#ifndef REALSENSERECORD_IMAGEPIXELFORMAT_H
+#define REALSENSERECORD_IMAGEPIXELFORMAT_H
+
+#include <string>
+
+namespace RealsenseRecording {
+    // The pixels of the recorded images: 3 bytes per pixel (in the channel order they were written with), or the
+    // camera's native YUYV (YUY2: Y0 U Y1 V for every 2 pixels), which takes 2 bytes per pixel and is only converted
+    // when reading (see ColorConversion)
+    enum ImagePixelFormat {
+        IMAGE_RGB8,
+        IMAGE_YUYV,
+    };
+
+    ImagePixelFormat imagePixelFormatFromString(const std::string &format);
+
+    std::string imagePixelFormatToString(ImagePixelFormat format);
+}
+
+#endif //REALSENSERECORD_IMAGEPIXELFORMAT_H
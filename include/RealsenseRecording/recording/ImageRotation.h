@@ -0,0 +1,29 @@
+#ifndef REALSENSERECORD_IMAGEROTATION_H
+#define REALSENSERECORD_IMAGEROTATION_H
+
+#include <AndreiUtils/enums/RotationType.h>
+#include <cstddef>
+#include <cstdint>
+
+namespace RealsenseRecording {
+    // Out-of-place rotations of the 3-channel uint8 images and of the uint16 depth, in one pass over the frame.
+    // LEFT_90 rotates counterclockwise, LEFT_270 clockwise (as AndreiUtils::imageDataRotation does). The 90/270 degree
+    // rotations are transposes that go through the frame in tiles which fit the L1 cache (the depth tiles in 8x8 SSE2
+    // blocks), instead of striding through the whole destination for each source row.
+    class ImageRotation {
+    public:
+        // The source is height x width with its rows sourceStride bytes apart; the destination is continuous, with
+        // the height and width swapped for LEFT_90 and LEFT_270. The buffers must not overlap
+        static void rotateImage(const uint8_t *source, int height, int width, size_t sourceStride, uint8_t *destination,
+                                AndreiUtils::RotationType rotation);
+
+        // As rotateImage, but with the rows sourceStride elements apart
+        static void rotateDepth(const uint16_t *source, int height, int width, size_t sourceStride,
+                                uint16_t *destination, AndreiUtils::RotationType rotation);
+
+        static void getRotatedSize(AndreiUtils::RotationType rotation, int height, int width, int &rotatedHeight,
+                                   int &rotatedWidth);
+    };
+}
+
+#endif //REALSENSERECORD_IMAGEROTATION_H
@@ -0,0 +1,71 @@
+#ifndef REALSENSERECORD_LATENCYHISTOGRAM_H
+#define REALSENSERECORD_LATENCYHISTOGRAM_H
+
+#include <AndreiUtils/json.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+
+namespace RealsenseRecording {
+    // Histogram of durations in nanoseconds with log-linear buckets (as HdrHistogram): each power of two is split
+    // into SUB_BUCKETS linear buckets, so that the percentiles have a relative error below 1 / SUB_BUCKETS over the
+    // whole range. Recording is lock-free and can be done from several threads while the histogram is read.
+    class LatencyHistogram {
+    public:
+        LatencyHistogram();
+
+        LatencyHistogram(const LatencyHistogram &other) = delete;
+
+        LatencyHistogram &operator=(const LatencyHistogram &other) = delete;
+
+        void record(uint64_t nanoseconds);
+
+        void recordSince(std::chrono::steady_clock::time_point start);
+
+        // Not consistent with concurrent records: only call it when no other thread records
+        void reset();
+
+        unsigned long long getCount() const;
+
+        uint64_t getMax() const;
+
+        double getMean() const;
+
+        // The upper bound of the bucket holding the given fraction (in [0, 1]) of the recorded durations
+        uint64_t getPercentile(double fraction) const;
+
+        // count, mean, p50, p99 and max, in milliseconds
+        void to_json(nlohmann::json &data) const;
+
+        // Records the time until it goes out of scope
+        class ScopedTimer {
+        public:
+            explicit ScopedTimer(LatencyHistogram &histogram);
+
+            ScopedTimer(const ScopedTimer &other) = delete;
+
+            ScopedTimer &operator=(const ScopedTimer &other) = delete;
+
+            ~ScopedTimer();
+
+        private:
+            LatencyHistogram &histogram;
+            std::chrono::steady_clock::time_point start;
+        };
+
+    private:
+        static const int SUB_BUCKET_BITS = 5, SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+        static const int NR_BUCKETS = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+        static int getBucket(uint64_t nanoseconds);
+
+        static uint64_t getBucketUpperBound(int bucket);
+
+        std::unique_ptr<std::atomic<unsigned long long>[]> buckets;
+        std::atomic<unsigned long long> count, sum;
+        std::atomic<uint64_t> max;
+    };
+}
+
+#endif //REALSENSERECORD_LATENCYHISTOGRAM_H
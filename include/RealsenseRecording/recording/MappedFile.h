@@ -0,0 +1,47 @@
+#ifndef REALSENSERECORD_MAPPEDFILE_H
+#define REALSENSERECORD_MAPPEDFILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace RealsenseRecording {
+    enum MappedFileAccess {
+        SEQUENTIAL_ACCESS,
+        RANDOM_ACCESS,
+    };
+
+    // Read-only memory mapping of a whole file
+    class MappedFile {
+    public:
+        MappedFile();
+
+        MappedFile(const MappedFile &other) = delete;
+
+        MappedFile &operator=(const MappedFile &other) = delete;
+
+        ~MappedFile();
+
+        void open(const std::string &file);
+
+        void close();
+
+        // Only forwards the hint to the kernel when it differs from the previous one
+        void advise(MappedFileAccess access);
+
+        bool isOpen() const;
+
+        const uint8_t *getData() const;
+
+        size_t getSize() const;
+
+    private:
+        const uint8_t *data;
+        size_t size;
+        int fileDescriptor;
+        MappedFileAccess access;
+        bool accessAdvised;
+    };
+}
+
+#endif //REALSENSERECORD_MAPPEDFILE_H
@@ -5,7 +5,16 @@
 #ifndef REALSENSERECORD_READRECORDING_H
 #define REALSENSERECORD_READRECORDING_H
 
+#include <RealsenseRecording/recording/DepthCodec.h>
+#include <RealsenseRecording/recording/DepthElementType.h>
+#include <RealsenseRecording/recording/DepthRegistration.h>
+#include <RealsenseRecording/recording/FrameCodec.h>
+#include <RealsenseRecording/recording/FrameView.h>
+#include <RealsenseRecording/recording/MappedFile.h>
 #include <RealsenseRecording/recording/Recording.h>
+#include <RealsenseRecording/recording/RecordingContainer.h>
+#include <RealsenseRecording/recording/RecordingIndex.h>
+#include <RealsenseRecording/recording/SPSCRingBuffer.h>
 
 namespace RealsenseRecording {
     class ReadRecording : public Recording {
@@ -22,23 +31,131 @@ namespace RealsenseRecording {
         bool readData(cv::Mat &image, cv::Mat &depth);
         #endif
 
+        // *image and *depth are allocated (with new[]) when they are nullptr and reused by the next calls otherwise, so
+        // that reading frame after frame into the same buffers does not allocate; they have to hold getImageSize bytes
+        // and getDepthHeight * getDepthWidth elements
         bool readData(uint8_t **image, uint16_t **depth);
 
         bool readData(uint8_t **image, double **depth);
 
+        bool readData(uint8_t **image, float **depth);
+
         bool readData(uint8_t *image, uint16_t *depth);
 
         bool readData(uint8_t *image, double *depth);
 
+        bool readData(uint8_t *image, float *depth);
+
         bool readData(uint8_t **image, int imageSize, uint16_t **depth, int depthSize);
 
         bool readData(uint8_t **image, int imageSize, double **depth, int depthSize);
 
+        bool readData(uint8_t **image, int imageSize, float **depth, int depthSize);
+
         bool readData(uint8_t *image, int imageSize, uint16_t *depth, int depthSize);
 
         bool readData(uint8_t *image, int imageSize, double *depth, int depthSize);
 
+        bool readData(uint8_t *image, int imageSize, float *depth, int depthSize);
+
+        // Scans the image and depth files of a recording made without an index and writes its index file; for
+        // containers, rewrites the footer from the complete frame chunks (e.g. after a crash while recording)
+        static void rebuildIndex(int fileNumber);
+
+        // Whether the recording has an index (of all of its segments); the seeking functions below need it
+        bool hasIndex() const;
+
+        // The segments of the recording (see WriteRecording::setSegmentLimits) are read one after the other, as one
+        // recording; the frame indices run over all segments
+        int getNrSegments() const;
+
+        int getNrFrames() const;
+
+        // The offsets, counter, timestamps and rs2 frame numbers recorded for the frame
+        const FrameIndexEntry &getFrameIndexEntry(int frameIndex) const;
+
+        // The number of the frame returned by the last readData call; -1 before the first one
+        int getCurrentFrameIndex() const;
+
+        // See RecordingIndex::getFrameNumberGaps
+        std::vector<int> getFrameNumberGaps() const;
+
+        // The next readData call returns the frame with the number frameIndex
+        void seek(int frameIndex);
+
+        #ifdef OPENCV
+        bool readFrame(int frameIndex, cv::Mat &image, cv::Mat &depth);
+        #endif
+
+        bool readFrame(int frameIndex, uint8_t **image, uint16_t **depth);
+
+        bool readFrame(int frameIndex, uint8_t **image, double **depth);
+
+        bool readFrame(int frameIndex, uint8_t **image, float **depth);
+
+        // Memory mapped reading of the "bin" files of a recording with an index and a single segment: the views point
+        // straight into the mapped files (no copies, no syscalls per frame) and stay valid as long as this
+        // ReadRecording exists. The views are independent of the stream based readData/seek position; pass nullptr
+        // to skip a stream.
+        bool readDataView(ImageView *image, DepthView *depth);
+
+        bool readFrameView(int frameIndex, ImageView *image, DepthView *depth);
+
+        // Decodes up to nrFrames frames ahead on one background thread per stream; readData then only takes the next
+        // decoded frame. Prefetching always reads both streams; 0 disables it
+        void setPrefetchSize(int nrFrames);
+
+        int getPrefetchSize() const;
+
+        // Decoded frames waiting to be read: close to the prefetch size when the consumer is the bottleneck, close to 0
+        // when the decoder is
+        int getNrPrefetchedFrames() const;
+
+        // Number of readData calls which had to wait for the decoder
+        unsigned long long getNrPrefetchStalls() const;
+
+        // In raw depth mode, depth read into cv::Mat keeps the recorded uint16 values (see parameters.depthUnits)
+        void setRawDepth(bool rawDepth);
+
+        bool isRawDepth() const;
+
+        // For recordings of YUYV images (see RecordingParameters::setImagePixelFormat): in raw image mode, the images
+        // keep the recorded YUYV (CV_8UC2, 2 bytes per pixel); otherwise they are converted when reading, to BGR for
+        // cv::Mat and to RGB for the other readData overloads. No effect on the other recordings and the frame views
+        void setRawImage(bool rawImage);
+
+        bool isRawImage() const;
+
+        // The bytes of the images returned by readData ("bin" images)
+        int getImageSize() const;
+
+        // The type of the depth in meters read into cv::Mat (CV_64F or CV_32F); the other readData overloads take it
+        // from the type of the depth pointer
+        void setDepthElementType(DepthElementType type);
+
+        DepthElementType getDepthElementType() const;
+
+        // For recordings with unaligned depth (see RecordingParameters::hasUnalignedDepth): registers the depth to
+        // the images while reading, so that readData returns depth of the image's size, as if it had been aligned
+        // when recording. Not for the frame views, which always hold the recorded depth. Has to be set before the
+        // prefetching starts; no effect on recordings with aligned depth
+        void setAlignedDepth(bool alignedDepth);
+
+        bool isAlignedDepth() const;
+
+        // The size of the depth returned by readData
+        int getDepthHeight() const;
+
+        int getDepthWidth() const;
+
     private:
+        // the readData overloads for depth in meters (double or float)
+        template<class T>
+        bool readMetersData(uint8_t **image, T **depth);
+
+        template<class T>
+        bool readMetersData(uint8_t **image, int imageSize, T **depth, int depthSize);
+
         #ifdef OPENCV
         bool readImage(cv::Mat **image);
 
@@ -49,13 +166,93 @@ namespace RealsenseRecording {
 
         bool readDepth(uint16_t **depth);
 
-        bool readDepth(double **depth);
+        template<class T>
+        bool readMetersDepth(T **depth);
 
         bool readImage(uint8_t **image, int imageSize);
 
+        // The recorded bytes of the next "bin" image (YUYV as it is), of getRecordedImageSize bytes
+        bool readRecordedImage(uint8_t *image);
+
+        // Reads the next YUYV image into image: as it is in raw image mode, converted to BGR or RGB otherwise
+        bool readYuyvImage(uint8_t *image, bool bgr);
+
+        bool isConvertingImage() const;
+
+        void convertYuyvImage(const uint8_t *yuyv, uint8_t *image, bool bgr) const;
+
+        int getRecordedImageSize() const;
+
         bool readDepth(uint16_t **depth, int depthSize);
 
-        bool readDepth(double **depth, int depthSize);
+        template<class T>
+        bool readMetersDepth(T **depth, int depthSize);
+
+        // The recorded depth, into rawDepthBuffer
+        bool readRawDepth(int depthSize);
+
+        bool isRegisteringDepth() const;
+
+        // Reads the recorded depth and registers it to the image size into registered
+        bool readRegisteredDepth(uint16_t *registered);
+
+        // Called before reading a frame of the stream: continues with the next segment at the end of the current one
+        // and, for containers, moves the reader to the payload of the stream's next chunk; false at the end of the
+        // recording (only detected for containers and segments other than the last one: the read fails otherwise)
+        bool prepareImageRead();
+
+        bool prepareDepthRead();
+
+        bool isImageSegmentEnd() const;
+
+        void openImageSegment(int segment);
+
+        void openDepthSegment(int segment);
+
+        bool hasSegment(int segment) const;
+
+        // Counts the segments and joins their indices into one
+        void loadIndex();
+
+        int getSegmentOfFrame(int frameIndex) const;
+
+        template<class T>
+        void convertRawDepthToMeters(const uint16_t *rawDepth, T *depth, int depthSize) const;
+
+        #ifdef OPENCV
+        int getMetersDepthMatType() const;
+        #endif
+
+        void startPrefetching();
+
+        void stopPrefetching();
+
+        void imagePrefetchThreadRead();
+
+        void depthPrefetchThreadRead();
+
+        // false at the end of the recording
+        bool acquirePrefetchedFrame(int &imageSlot, int &depthSlot);
+
+        #ifdef OPENCV
+        bool readPrefetchedData(cv::Mat **image, cv::Mat **depth);
+        #endif
+
+        // imageSize / depthSize < 0: allocate the output if it is nullptr
+        bool readPrefetchedData(uint8_t **image, int imageSize, uint16_t **depth, int depthSize);
+
+        void readPrefetchedImage(int slot, uint8_t **image, int imageSize);
+
+        template<class T>
+        bool readPrefetchedMetersData(uint8_t **image, int imageSize, T **depth, int depthSize);
+
+        void initializeReaders(bool withImage, bool withDepth);
+
+        void initializeMappedFiles(bool withImage, bool withDepth);
+
+        size_t getMappedRecordSize(const MappedFile &file, bool image) const;
+
+        const uint8_t *getMappedFrame(const MappedFile &file, int64_t offset, size_t recordSize, size_t dataSize) const;
 
         void initializeImageReader();
 
@@ -67,9 +264,40 @@ namespace RealsenseRecording {
 
         #ifdef OPENCV
         cv::VideoCapture *imageReader{};
+        // the last "avi" image, decoded into the same allocation every frame
+        cv::Mat decodedImage{};
         #endif
         std::ifstream *imageReaderBinary{}, *depthReaderBinary{};
         bool imageReaderInitialized, depthReaderInitialized;
+        DepthCodec depthCodec;
+        // the recorded formats of the streams (no image codec for "avi" images)
+        std::unique_ptr<FrameCodec> imageFrameCodec, depthFrameCodec;
+        RecordingIndex index;
+        int nrSegments, imageSegment, depthSegment;
+        // the index of the first frame of each segment
+        std::vector<int> segmentStartFrames;
+        MappedFile mappedImageFile, mappedDepthFile;
+        size_t mappedImageRecordSize, mappedDepthRecordSize;
+        int nextViewFrame, nextFrameIndex;
+        std::vector<uint16_t> rawDepthBuffer;
+        bool rawDepth;
+        bool rawImage;
+        // the recorded YUYV image before its conversion, 2 bytes per element
+        std::vector<uint16_t> yuyvBuffer;
+        DepthElementType depthElementType;
+        bool alignedDepth;
+        DepthRegistration depthRegistration;
+        // the registered depth before its conversion to meters
+        std::vector<uint16_t> registeredDepthBuffer;
+
+        int prefetchSize;
+        // the streams are decoded independently; both rings have the same number of slots
+        SPSCRingBuffer imagePrefetchBuffer, depthPrefetchBuffer;
+        std::thread imagePrefetchThread, depthPrefetchThread;
+        // the recorded images (YUYV is only converted when the frame is taken)
+        std::vector<std::vector<uint8_t>> prefetchedImages;
+        std::vector<std::vector<uint16_t>> prefetchedDepths;
+        unsigned long long nrPrefetchStalls;
     };
 }
 
@@ -19,6 +19,10 @@ namespace RealsenseRecording {
 
         static std::string format(int number, const char *type, const std::string &format);
 
+        // The file of the given segment of a recording split into segments (see WriteRecording::setSegmentLimits):
+        // segment 0 is the file itself, segment k > 0 has "_seg<k>" appended to its name (before the extension)
+        static std::string getSegmentFile(const std::string &file, int segment);
+
         explicit Recording(const std::string &imageFormat = "avi", const std::string &depthFormat = "bin",
                            const std::string &parameterFormat = "json",
                            AndreiUtils::RotationType rotationType = AndreiUtils::RotationType::NO_ROTATION);
@@ -44,12 +48,22 @@ namespace RealsenseRecording {
 
         const RecordingParameters *getParameters();
 
+        // Whether the parameters and all the frames are in one recording container (see RecordingContainer)
+        bool isContainer() const;
+
     protected:
+        explicit Recording(RecordingParameters _parameters);
+
+        // Deletes the files of the segments k > 0 of the given file
+        static void deleteSegmentFiles(const std::string &file);
+
         static std::string outputDirectory;
         static bool outputDirectoryInitialized;
 
         RecordingParameters parameters;
-        std::string imageFile, depthFile, parameterFile;
+        // the index file is optional when reading (see RecordingIndex); all files are the same for containers, which
+        // have no separate index file
+        std::string imageFile, depthFile, parameterFile, indexFile;
     };
 }
 
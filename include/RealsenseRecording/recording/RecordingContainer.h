@@ -0,0 +1,127 @@
+#ifndef REALSENSERECORD_RECORDINGCONTAINER_H
+#define REALSENSERECORD_RECORDINGCONTAINER_H
+
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <RealsenseRecording/recording/RecordingIndex.h>
+#include <RealsenseRecording/recording/RecordingParameters.h>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+namespace RealsenseRecording {
+    enum ContainerChunkType {
+        IMAGE_CHUNK = 1,
+        DEPTH_CHUNK = 2,
+        // the index entry of a frame, written once both of its streams are in the container
+        METADATA_CHUNK = 3,
+        // all index entries, written when the recording is closed
+        FOOTER_CHUNK = 4,
+    };
+
+    // Single file recording (recording_container_N.rsrec, parameters format "rsrec"), written append-only:
+    //  - header: magic, version, size of the parameters and the parameters as json
+    //  - chunks: type, reserved, payload size (uint32, uint32, uint64) and the payload; the image and depth payloads
+    //    are the raw pixels ("bin") or the "rvl" frames, the metadata payloads are RecordingIndex entries whose
+    //    offsets point to the payloads of the frame's image and depth chunks
+    //  - footer chunk (the RecordingIndex of all frames) and the trailer: offset of the footer chunk and end magic
+    // A container without footer (e.g. after a crash) is indexed by its metadata chunks instead.
+    class RecordingContainer {
+    public:
+        static const uint64_t CHUNK_HEADER_SIZE = 2 * sizeof(uint32_t) + sizeof(uint64_t);
+
+        static void writeHeader(std::ofstream *out, const RecordingParameters &parameters);
+
+        // The parameters in the header, as json (see RecordingParameters::deserialize)
+        static std::string readParametersJson(const std::string &containerFile);
+
+        // Positions a stream opened at the start of the container at its first chunk
+        static void skipHeader(std::ifstream *in, const std::string &containerFile);
+
+        // Positions the stream at the payload of the next chunk of the given type; false at the footer or at the end
+        static bool enterChunk(std::istream *in, ContainerChunkType type);
+
+        // Reads the footer of the container, or collects its metadata chunks if it has none; true if it has a footer
+        static bool loadIndex(const std::string &containerFile, RecordingIndex &index);
+
+        // Appends the footer and the trailer; the stream has to be at the end of the last chunk
+        static void writeFooter(std::ostream *out, const RecordingIndex &index);
+
+        // Collects the metadata chunks of the container (which may still be written, once flushed); returns the end
+        // of the last complete chunk before the footer
+        static int64_t indexChunks(const std::string &containerFile, RecordingIndex &index);
+
+        // Cuts off a partially written last chunk and an old footer and appends a footer for the remaining frames
+        static int rebuildFooter(const std::string &containerFile);
+
+        // The payload size of the chunk whose payload starts at the given offset of the mapped container
+        static uint64_t getPayloadSize(const uint8_t *containerData, int64_t payloadOffset);
+
+        // Stages the payload of one chunk in memory: the payload is written to the stream returned by startPayload
+        // (e.g. by a FrameCodec) without holding any lock, then append writes the chunk header with the real payload
+        // size and the payload to the container under the container's lock, so that the chunks of several writer
+        // threads only take turns for the copy. The memory is kept for the next chunks.
+        class ChunkBuffer {
+        public:
+            ChunkBuffer();
+
+            ChunkBuffer(const ChunkBuffer &other) = delete;
+
+            ChunkBuffer &operator=(const ChunkBuffer &other) = delete;
+
+            ~ChunkBuffer();
+
+            // Empties the payload; the stream writes into the buffer
+            std::ostream *startPayload();
+
+            uint64_t getPayloadSize() const;
+
+            // Returns the offset of the payload in the container
+            int64_t append(std::ofstream *out, std::mutex &containerLock, ContainerChunkType type);
+
+        private:
+            // a growing buffer which only supports appending
+            class MemoryStreamBuffer : public std::streambuf {
+            public:
+                void clear();
+
+                uint64_t size() const;
+
+                const char *getData() const;
+
+            protected:
+                std::streamsize xsputn(const char *data, std::streamsize nrBytes) override;
+
+                int_type overflow(int_type c) override;
+
+            private:
+                void reserve(size_t nrBytes);
+
+                std::vector<char> memory;
+            };
+
+            MemoryStreamBuffer payload;
+            std::ostream payloadStream;
+        };
+
+    private:
+        static const char MAGIC[4], END_MAGIC[4];
+        static const uint32_t VERSION;
+        static const uint64_t TRAILER_SIZE;
+
+        static void writeChunkHeader(std::ostream *out, ContainerChunkType type, uint64_t payloadSize);
+
+        static bool readChunkHeader(std::istream *in, uint32_t &type, uint64_t &payloadSize);
+
+        // Offset of the first chunk
+        static int64_t readHeader(std::ifstream &in, const std::string &containerFile, std::string *parametersJson);
+
+        static bool readFooter(std::ifstream &in, RecordingIndex &index);
+
+        // Collects the metadata chunks; returns the end of the last complete chunk before the footer
+        static int64_t scanChunks(std::ifstream &in, int64_t firstChunk, RecordingIndex &index);
+    };
+}
+
+#endif //REALSENSERECORD_RECORDINGCONTAINER_H
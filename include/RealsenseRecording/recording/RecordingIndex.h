@@ -0,0 +1,86 @@
+#ifndef REALSENSERECORD_RECORDINGINDEX_H
+#define REALSENSERECORD_RECORDINGINDEX_H
+
+#include <cstdint>
+#include <fstream>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace RealsenseRecording {
+    // Timing of one stream of a frame; the timestamps are in milliseconds and < 0 if unknown (e.g. in rebuilt indices)
+    struct StreamFrameInfo {
+        static const unsigned long long UNKNOWN_FRAME_NUMBER = (unsigned long long) -1;
+
+        // device clock timestamp of the rs2 frame
+        double hardwareTimestamp;
+        // host clock (system time) of the frame arrival, or of the writeData call for frames not written as rs2 frames
+        double systemTimestamp;
+        // rs2 frame number
+        unsigned long long frameNumber;
+    };
+
+    struct FrameIndexEntry {
+        // byte offsets of the frame in the image and depth files; -1 if the frame has no such data or, for images in
+        // the "avi" format, if the frame can only be found by its number
+        int64_t imageOffset, depthOffset;
+        // the counter passed to WriteRecording::writeData
+        unsigned long long counter;
+        StreamFrameInfo image, depth;
+
+        static FrameIndexEntry unknown();
+
+        // The best timestamp to replay the frame with: the hardware clock if known (it has no host scheduling jitter),
+        // the system clock otherwise; depth before image; < 0 if no timestamp is known
+        double getReplayTimestamp() const;
+    };
+
+    // Sidecar file of a recording (recording_index_N.bin) mapping each frame number to the position of the frame in
+    // the image and depth files and to its timing: a small header followed by one fixed-size entry per written frame.
+    class RecordingIndex {
+    public:
+        RecordingIndex();
+
+        ~RecordingIndex();
+
+        void clear();
+
+        // Reads all the entries of the index file; a partially written last entry is ignored
+        bool load(const std::string &indexFile);
+
+        // Reads the index from its header on; name is only used in error messages
+        void load(std::istream &in, const std::string &name);
+
+        void save(const std::string &indexFile) const;
+
+        void save(std::ostream *out) const;
+
+        void addEntry(const FrameIndexEntry &entry);
+
+        const FrameIndexEntry &getEntry(int frameIndex) const;
+
+        int getNrFrames() const;
+
+        bool empty() const;
+
+        // Indices of the frames which come after missing frames according to the recorded rs2 frame numbers (of the
+        // depth stream, or of the image stream if the depth frame numbers are unknown)
+        std::vector<int> getFrameNumberGaps() const;
+
+        static void writeHeader(std::ostream *out);
+
+        static void writeEntry(std::ostream *out, const FrameIndexEntry &entry);
+
+        // Reads an entry as written by writeEntry
+        static bool readEntry(std::istream &in, FrameIndexEntry &entry);
+
+    private:
+        static const char MAGIC[4];
+        static const uint32_t VERSION;
+
+        std::vector<FrameIndexEntry> entries;
+    };
+}
+
+#endif //REALSENSERECORD_RECORDINGINDEX_H
@@ -8,6 +8,7 @@
 #include <AndreiUtils/enums/RotationType.h>
 #include <AndreiUtils/json.hpp>
 #include <librealsense2/rs.hpp>
+#include <RealsenseRecording/recording/ImagePixelFormat.h>
 #include <string>
 #include <vector>
 #include "RecordingParametersType.h"
@@ -75,16 +76,61 @@ namespace RealsenseRecording {
 
         rs2_intrinsics getIntrinsics();
 
+        // The depth is recorded unaligned, at the resolution and rate of the depth stream, instead of aligned to the
+        // image (which the other parameters describe); ReadRecording::setAlignedDepth registers it when reading.
+        // Not supported together with a rotation
+        void setUnalignedDepth(double _depthFps, const rs2_intrinsics &_depthIntrinsics,
+                               const rs2_extrinsics &_depthToColor);
+
+        void setAlignedDepth();
+
+        bool hasUnalignedDepth() const;
+
+        // The size of the recorded depth: the image's one, unless the depth is unaligned
+        int getDepthHeight() const;
+
+        int getDepthWidth() const;
+
+        // Of the unaligned depth stream; the image's intrinsics when the depth is aligned
+        rs2_intrinsics getDepthIntrinsics() const;
+
+        // From the unaligned depth stream's camera to the image's one; the identity when the depth is aligned
+        rs2_extrinsics getDepthToColorExtrinsics() const;
+
+        // The images are recorded as the camera's YUYV instead of 3 bytes per pixel, and converted when reading. Only
+        // supported for the "bin" image format, without a rotation and for an even width
+        void setImagePixelFormat(ImagePixelFormat format);
+
+        // The bytes per recorded image pixel: 3, or 2 for YUYV
+        int getImageBytesPerPixel() const;
+
         bool isInitialized() const;
 
+        static const float DEFAULT_DEPTH_UNITS;
+
         double fps;
         int width{}, height{};
         float ppx{}, ppy{}, fx{}, fy{}, coefficients[5];
+        // meters per unit of the recorded uint16 depth values
+        float depthUnits;
         rs2_distortion model;
         std::string imageFormat, depthFormat, parametersFormat;
         AndreiUtils::RotationType rotation;
+        ImagePixelFormat imagePixelFormat;
+        bool unalignedDepth;
+        // the depth stream, only set for unaligned depth
+        double depthFps;
+        int depthWidth{}, depthHeight{};
+        float depthPpx{}, depthPpy{}, depthFx{}, depthFy{}, depthCoefficients[5];
+        rs2_distortion depthModel;
+        // depth to color: the column major rotation and the translation in meters, as in rs2_extrinsics
+        float depthToColorRotation[9], depthToColorTranslation[3];
 
     private:
+        static rs2_distortion distortionModelFromString(const std::string &distortionModel);
+
+        void setDepthToColorIdentity();
+
         void setRotationDependentParameters(AndreiUtils::RotationType rotation, int _width, int _height);
 
         void setRotationDependentParameters(AndreiUtils::RotationType rotation, int _width, int _height,
@@ -0,0 +1,83 @@
+#ifndef REALSENSERECORD_SPSCRINGBUFFER_H
+#define REALSENSERECORD_SPSCRINGBUFFER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <RealsenseRecording/recording/BufferOverflowPolicy.h>
+
+namespace RealsenseRecording {
+    // Single-producer/single-consumer queue of slot indices. The slot data itself lives in the owner's arrays (of
+    // size getNrSlots()); the queue only hands out slot indices: the producer fills the slot it acquired and
+    // publishes it, the consumer processes the slot it acquired until it asks for the next one.
+    // Besides the "capacity" queued slots, one slot is owned by the producer and one by the consumer.
+    class SPSCRingBuffer {
+    public:
+        explicit SPSCRingBuffer(int capacity = 0);
+
+        SPSCRingBuffer(const SPSCRingBuffer &other) = delete;
+
+        SPSCRingBuffer &operator=(const SPSCRingBuffer &other) = delete;
+
+        ~SPSCRingBuffer();
+
+        // Not thread-safe: only call before the producer and the consumer start using the buffer
+        void reset(int capacity);
+
+        // Producer: returns the slot to fill or -1 if no slot is available (dropped newest frame or buffer closed)
+        int acquireWriteSlot(BufferOverflowPolicy policy, bool &droppedOldest);
+
+        // Producer: hands the slot returned by the last acquireWriteSlot over to the consumer
+        void publishWriteSlot();
+
+        // Consumer: releases the previously processed slot and waits for the next one; -1 if closed and drained
+        int acquireReadSlot();
+
+        // Consumer: returns the currently processed slot to the producer without acquiring a new one
+        void releaseReadSlot();
+
+        // Wakes up both sides; the consumer still receives all slots published before the call
+        void close();
+
+        bool isClosed() const;
+
+        int getCapacity() const;
+
+        int getNrSlots() const;
+
+        int size() const;
+
+    private:
+        static const size_t CACHE_LINE_SIZE = 64;
+
+        bool popFreeSlot(int &slot);
+
+        void pushFreeSlot(int slot);
+
+        void notifyProducer();
+
+        void notifyConsumer();
+
+        int capacity, nrSlots;
+        std::unique_ptr<std::atomic<int>[]> readySlots, freeSlots;
+
+        // head/tail of the published slots: written by the producer / by the consumer (and by a dropping producer)
+        std::atomic<unsigned long long> readyHead;
+        char readyHeadPadding[CACHE_LINE_SIZE - sizeof(std::atomic<unsigned long long>)]{};
+        std::atomic<unsigned long long> readyTail;
+        char readyTailPadding[CACHE_LINE_SIZE - sizeof(std::atomic<unsigned long long>)]{};
+        // head/tail of the free slots: written by the consumer / by the producer
+        std::atomic<unsigned long long> freeHead;
+        char freeHeadPadding[CACHE_LINE_SIZE - sizeof(std::atomic<unsigned long long>)]{};
+        std::atomic<unsigned long long> freeTail;
+        char freeTailPadding[CACHE_LINE_SIZE - sizeof(std::atomic<unsigned long long>)]{};
+
+        int producerSlot, consumerSlot;
+        std::atomic<bool> producerWaiting, consumerWaiting, closed;
+        std::mutex waitLock;
+        std::condition_variable producerCondition, consumerCondition;
+    };
+}
+
+#endif //REALSENSERECORD_SPSCRINGBUFFER_H
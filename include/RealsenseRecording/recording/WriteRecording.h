@@ -5,7 +5,17 @@
 #ifndef REALSENSERECORD_WRITERECORDING_H
 #define REALSENSERECORD_WRITERECORDING_H
 
+#include <chrono>
+#include <map>
+#include <RealsenseRecording/recording/DepthCodec.h>
+#include <RealsenseRecording/recording/FanOutRingBuffer.h>
+#include <RealsenseRecording/recording/FrameCodec.h>
+#include <RealsenseRecording/recording/FrameSlabPool.h>
+#include <RealsenseRecording/recording/LatencyHistogram.h>
 #include <RealsenseRecording/recording/Recording.h>
+#include <RealsenseRecording/recording/RecordingContainer.h>
+#include <RealsenseRecording/recording/RecordingIndex.h>
+#include <RealsenseRecording/recording/WriteStatus.h>
 
 namespace RealsenseRecording {
     class WriteRecording : public Recording {
@@ -15,6 +25,13 @@ namespace RealsenseRecording {
                                               const std::string &parametersWriteFormat = "xml", bool withOpenCV = false,
                                               AndreiUtils::RotationType rotationType = AndreiUtils::NO_ROTATION);
 
+        // Overrides the writeBufferSize of recordingOutputDirectory.cfg for the WriteRecordings created afterwards
+        static void setBufferSize(int bufferSize);
+
+        // Overrides the writePreallocatedFrames of recordingOutputDirectory.cfg for the WriteRecordings created
+        // afterwards; the slabs of the other buffer slots are allocated on their first use
+        static void setNrPreallocatedFrames(int nrFrames);
+
         WriteRecording(const std::string &imageFormat, const std::string &depthFormat,
                        const std::string &parameterFormat, const void *parameters,
                        RecordingParametersType parametersType, bool withOpenCV = false,
@@ -46,33 +63,175 @@ namespace RealsenseRecording {
         void setParameters(double fps, int width, int height, float fx, float fy, float ppx, float ppy,
                            rs2_distortion model, const float *coefficients);
 
+        // Meters per unit of the written uint16 depth values; set it to the sensor's depth scale (before the first
+        // write) to store the Z16 frames as they are
+        void setDepthUnits(float depthUnits);
+
+        float getDepthUnits() const;
+
+        // Records the depth at its own resolution instead of aligned to the image (before the first write and not
+        // with a rotation); the depth frames passed to writeData then have the size of the depth intrinsics. The
+        // readers can register the depth to the image afterwards (see ReadRecording::setAlignedDepth)
+        void setUnalignedDepth(double depthFps, const rs2_intrinsics &depthIntrinsics,
+                               const rs2_extrinsics &depthToColor);
+
+        void setAlignedDepth();
+
+        // Records the images as the camera's YUYV (before the first write; see RecordingParameters::
+        // setImagePixelFormat): the images passed to writeData then have 2 bytes per pixel (CV_8UC2 matrices or
+        // RS2_FORMAT_YUYV frames), and are only converted when reading
+        void setImagePixelFormat(ImagePixelFormat format);
+
         #ifdef OPENCV
 
-        bool writeData(cv::Mat *image, rs2::depth_frame *depth, unsigned long long counter = -1);
+        WriteStatus writeData(cv::Mat *image, rs2::depth_frame *depth, unsigned long long counter = -1);
 
-        bool writeData(cv::Mat *image, cv::Mat *depth, unsigned long long counter = -1);
+        WriteStatus writeData(cv::Mat *image, cv::Mat *depth, unsigned long long counter = -1);
 
-        bool writeData(cv::Mat &image, cv::Mat &depth, unsigned long long counter = -1);
+        WriteStatus writeData(cv::Mat &image, cv::Mat &depth, unsigned long long counter = -1);
 
         #endif
 
-        bool writeData(rs2::video_frame *image, rs2::depth_frame *depth, unsigned long long counter = -1);
+        WriteStatus writeData(rs2::video_frame *image, rs2::depth_frame *depth, unsigned long long counter = -1);
+
+        WriteStatus writeData(uint8_t *image, int nrImageElements, uint16_t *depth, int nrDepthElements,
+                              unsigned long long counter = -1);
+
+        WriteStatus writeData(uint8_t *image, int nrImageElements, const double *depth, int nrDepthElements,
+                              unsigned long long counter = -1);
+
+        WriteStatus writeData(uint8_t *image, int nrImageElements, const float *depth, int nrDepthElements,
+                              unsigned long long counter = -1);
+
+        void setOverflowPolicy(BufferOverflowPolicy policy);
+
+        BufferOverflowPolicy getOverflowPolicy() const;
+
+        unsigned long long getNrDroppedFrames() const;
+
+        int getNrBufferedFrames() const;
+
+        unsigned long long getNrSlabAllocations() const;
 
-        bool writeData(uint8_t *image, int nrImageElements, uint16_t *depth, int nrDepthElements,
-                       unsigned long long counter = -1);
+        // Frames passed as rs2 frames are buffered as they are (without copies) while less than maxHeldFrames frames
+        // are held, and copied into the buffer otherwise; 0 disables holding frames
+        void setMaxHeldFrames(int maxHeldFrames);
 
-        bool writeData(uint8_t *image, int nrImageElements, const double *depth, int nrDepthElements,
-                       unsigned long long counter = -1);
+        int getMaxHeldFrames() const;
+
+        int getNrHeldFrames() const;
+
+        // Starts a new segment of the recording (see Recording::getSegmentFile) once the current one has maxFrames
+        // frames, maxBytes written bytes or lasts maxSeconds; 0 disables a limit. The segment of each frame is chosen
+        // when it is buffered, and each writer thread switches its files when it reaches the first frame of the next
+        // segment, so writing goes on without waiting. The bytes are counted when a frame is buffered, from the frame
+        // sizes of the recording's formats: the pixels for "bin" (without the record headers) and, as an upper bound,
+        // for "rvl"; "avi" images are not counted
+        void setSegmentLimits(unsigned long long maxFrames, unsigned long long maxBytes, double maxSeconds);
+
+        int getNrSegments() const;
+
+        // Since the construction or the last resetStats: the latencies of writeData, of the frames waiting in the
+        // buffer and of the image / depth writing on the writer threads, the written frames and bytes with their
+        // rates, and the current and maximal buffer depth
+        void getStats(nlohmann::json &stats) const;
+
+        // Only exact while no frames are written
+        void resetStats();
 
     private:
+        // The members of all the constructors, which start the writer threads themselves
+        WriteRecording(RecordingParameters _parameters, bool _parametersSet, bool withOpenCV,
+                       AndreiUtils::RotationType rotationType);
+
         explicit WriteRecording(bool iWillSetParametersLater, const std::string &imageWriteFormat = "avi",
                                 const std::string &depthWriteFormat = "bin",
                                 const std::string &parametersWriteFormat = "xml", bool withOpenCV = false,
                                 AndreiUtils::RotationType rotationType = AndreiUtils::RotationType::NO_ROTATION);
 
+        static void readConfig();
+
+        static bool configRead;
         static int dataBufferSize;
+        static BufferOverflowPolicy defaultOverflowPolicy;
+        static int nrPreallocatedFrames;
+        static int defaultMaxHeldFrames;
+        static int nrDepthCodecChunks;
+        static unsigned long long defaultSegmentMaxFrames, defaultSegmentMaxBytes;
+        static double defaultSegmentMaxSeconds;
+        // the buffer readers: one writer thread per stream
+        static const int IMAGE_WRITER = 0, DEPTH_WRITER = 1, NR_STREAM_WRITERS = 2;
+
+        void imageThreadWrite(bool useOpenCV);
+
+        void depthThreadWrite(bool useOpenCV);
+
+        // Called by each stream writer once it is done with the frame of the slot; the last one writes the index entry
+        void finishSlotStream(int slot, int writer, int64_t offset, bool written);
+
+        // The writeData overloads for depth in meters (double or float)
+        template<class T>
+        WriteStatus writeMetersData(uint8_t *image, int nrImageElements, const T *depth, int nrDepthElements,
+                                    unsigned long long counter);
+
+        int acquireBufferSlot(WriteStatus &status);
+
+        void publishBufferSlot(int slot);
+
+        // Producer: the segment of the frame in the slot
+        int selectSegment(int slot);
 
-        void bufferThreadWrite(bool useOpenCV);
+        // Producer: the recorded size of the frame in the slot, see setSegmentLimits
+        unsigned long long getSlotFrameBytes(int slot) const;
+
+        // The writers of the stream switch to the files of the given segment
+        void startImageSegment(int segment);
+
+        void startDepthSegment(int segment);
+
+        void startIndexSegment(int segment);
+
+        // For containers: the container of the segment, created on first use; nullptr otherwise
+        std::ofstream *getContainerWriter(int segment);
+
+        void writeImageData(uint8_t *imageData, bool useOpenCV);
+
+        void writeDepthData(uint16_t *depthData, bool useOpenCV);
+
+        uint8_t *prepareImageFrame(const rs2::video_frame &frame, int slot, bool forceCopy);
+
+        uint16_t *prepareDepthFrame(const rs2::depth_frame &frame, int slot, bool forceCopy);
+
+        void releaseHeldFrames(int slot);
+
+        static double getSystemTimestamp();
+
+        static StreamFrameInfo getStreamFrameInfo(const rs2::frame &frame);
+
+        void setSlotFrameInfo(int slot, unsigned long long counter, const StreamFrameInfo &imageInfo,
+                              const StreamFrameInfo &depthInfo);
+
+        int64_t getImageWriterOffset() const;
+
+        int64_t getDepthWriterOffset() const;
+
+        void writeIndexEntry(const FrameIndexEntry &entry, int segment);
+
+        bool initializeWriters(bool withImage, bool withDepth);
+
+        void initializeSlabPool();
+
+        uint8_t *getImageSlab(int slot, size_t nrImageBytes);
+
+        uint16_t *getDepthSlab(int slot, size_t nrDepthElements);
+
+        // Producer: copies the image (rows stride bytes apart) / depth (rows stride elements apart) of the frame size
+        // into the slab of the slot, rotated on the way, so that the writer threads serialize the slabs as they are
+        uint8_t *copyImageToSlab(int slot, uint8_t *image, size_t nrImageBytes, size_t stride);
+
+        uint16_t *copyDepthToSlab(int slot, uint16_t *depth, size_t nrDepthElements, size_t stride);
+
+        uint16_t *getDepthRotationScratch(size_t nrDepthElements);
 
         void initializeThreadAndBuffers(bool useOpenCV = false);
 
@@ -82,6 +241,9 @@ namespace RealsenseRecording {
 
         void writeDepth(cv::Mat *depth);
 
+        // From meters (CV_64F or CV_32F) to the recording's depth units
+        void convertDepthToUnits(cv::Mat *depth, cv::Mat &converted) const;
+
         #endif
 
         void writeImage(uint8_t *imageData);
@@ -96,25 +258,80 @@ namespace RealsenseRecording {
 
         void releaseDepthWriter();
 
+        void releaseIndexWriter();
+
+        // Completes the container of the segment with the footer of its indexed frames
+        void releaseContainerWriter(int segment);
+
+        void releaseContainerWriters();
+
         #ifdef OPENCV
         cv::VideoWriter *imageWriter{};
         #endif
-        std::ofstream *imageWriterBinary{}, *depthWriterBinary{};
+        // for containers, the image and depth writers are the streams of their chunk buffers
+        std::ostream *imageWriterBinary{}, *depthWriterBinary{};
+        std::ofstream *indexWriterBinary{};
+        // the open containers by segment: the ones of the last indexed segment and of the segments the writers are on
+        std::map<int, std::ofstream *> containerWriters;
+        // the image and depth writer threads append their chunks to the container in turns
+        std::mutex containerLock;
+        // the chunks are encoded into these outside of containerLock; the index chunk is guarded by indexLock
+        RecordingContainer::ChunkBuffer imageChunk, depthChunk, indexChunk;
         bool imageWriterInitialized, depthWriterInitialized;
+        // only used by the writer thread, for the "rvl" depth format
+        DepthCodec depthCodec;
+        // the formats of the streams, created with the writers (nullptr before, and for "avi" images)
+        std::unique_ptr<FrameCodec> imageFrameCodec, depthFrameCodec;
 
-        std::thread writerThread;
-        std::mutex lock;
+        std::thread imageWriterThread, depthWriterThread;
+        FanOutRingBuffer buffer;
+        BufferOverflowPolicy overflowPolicy;
+        // counted by the producer, read by getStats from other threads
+        std::atomic<unsigned long long> nrDroppedFrames;
 
         AndreiUtils::RotationType writeRotation;
 
-        #ifdef OPENCV
-        std::vector<cv::Mat *> imageBuffer{}, depthBuffer{};
-        #endif
+        FrameSlabPool slabPool;
+        // the size of the images passed to writeData, i.e. before the rotation; the slabs hold the rotated frames
+        int frameHeight, frameWidth;
+        // the same for the depth, which differs from the image's size when the depth is unaligned
+        int depthFrameHeight, depthFrameWidth;
+        // producer only: depth that is converted to depth units before it is rotated into its slab
+        std::vector<uint16_t> depthRotationScratch;
+        // the slab data of each slot or nullptr if the frame of the slot has no copied image / depth
         std::vector<uint8_t *> imageBytesBuffer;
         std::vector<uint16_t *> depthBytesBuffer;
-        std::vector<unsigned long long> countBuffer;
-        bool writeFlag, parametersSet;
-        int bufferStartIndex, bufferEndIndex, bufferSize;
+        // the frames held by each slot instead of copies
+        std::vector<rs2::frame> imageFrameBuffer, depthFrameBuffer;
+        std::atomic<int> nrHeldFrames;
+        int maxHeldFrames;
+        // the counter and timing of the frame of each slot; the offsets are only set when the frame is written
+        std::vector<FrameIndexEntry> indexEntryBuffer;
+        // guards the index entries, the stream writers' progress on each slot and the index writer
+        std::mutex indexLock;
+        std::vector<int> nrPendingStreamsBuffer, nrWrittenStreamsBuffer;
+
+        unsigned long long segmentMaxFrames, segmentMaxBytes;
+        double segmentMaxSeconds;
+        // the segment of the frame of each slot
+        std::vector<int> segmentBuffer;
+        // the producer's segment and its progress
+        int producerSegment;
+        unsigned long long nrSegmentFrames, nrSegmentBytes;
+        std::chrono::steady_clock::time_point segmentStart;
+        // bytes written by the stream writers over all segments
+        std::atomic<unsigned long long> nrWrittenBytes;
+
+        LatencyHistogram enqueueLatency, imageQueueLatency, depthQueueLatency, imageWriteLatency, depthWriteLatency;
+        // when the frame of each slot was handed over to the writers
+        std::vector<std::chrono::steady_clock::time_point> publishTimeBuffer;
+        std::atomic<unsigned long long> nrWrittenImages, nrWrittenDepths;
+        std::atomic<int> maxQueueDepth;
+        std::chrono::steady_clock::time_point statsStart;
+        unsigned long long statsStartBytes, statsStartDroppedFrames;
+        // the segment of the files of each writer; the index writer's is guarded by indexLock
+        int imageWriterSegment, depthWriterSegment, indexWriterSegment;
+        bool parametersSet, writeWithOpenCV;
     };
 }
 
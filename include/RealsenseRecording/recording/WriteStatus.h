@@ -0,0 +1,19 @@
+#ifndef REALSENSERECORD_WRITESTATUS_H
+#define REALSENSERECORD_WRITESTATUS_H
+
+namespace RealsenseRecording {
+    enum WriteStatus {
+        WRITE_FAILED,
+        WRITE_ENQUEUED,
+        // the buffer was full and the frame passed to writeData was discarded
+        WRITE_DROPPED_NEWEST,
+        // the buffer was full and the oldest buffered frame was discarded to make room for the new one
+        WRITE_DROPPED_OLDEST,
+    };
+
+    inline bool writeStatusEnqueued(WriteStatus status) {
+        return status == WRITE_ENQUEUED || status == WRITE_DROPPED_OLDEST;
+    }
+}
+
+#endif //REALSENSERECORD_WRITESTATUS_H
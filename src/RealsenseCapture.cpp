@@ -4,8 +4,13 @@
 
 #include <RealsenseRecording/RealsenseCapture.h>
 #include <AndreiUtils/enums/StandardTypes.h>
+#include <AndreiUtils/utilsJson.h>
 #include <AndreiUtils/utilsRealsense.h>
+#include <algorithm>
+#include <cstring>
 #include <iostream>
+#include <RealsenseRecording/recording/ColorConversion.h>
+#include <RealsenseRecording/recording/DepthConversion.h>
 
 #ifdef OPENCV
 
@@ -18,31 +23,132 @@ using namespace RealsenseRecording;
 using namespace rs2;
 using namespace std;
 
+namespace {
+    // row by row, since the rows of the frame may be padded
+    template<class T>
+    void convertDepthFrameToMeters(const rs2::frame &frame, T *meters) {
+        auto depthFrame = frame.as<rs2::depth_frame>();
+        int height = depthFrame.get_height(), width = depthFrame.get_width();
+        int stride = depthFrame.get_stride_in_bytes() / (int) sizeof(uint16_t);
+        auto *depth = (const uint16_t *) depthFrame.get_data();
+        float depthUnits = depthFrame.get_units();
+        for (int row = 0; row < height; row++) {
+            DepthConversion::toMeters(depth + (size_t) row * stride, meters + (size_t) row * width, width, depthUnits);
+        }
+    }
+
+    // the registered depth if there is one, otherwise the depth frame
+    template<class T>
+    void convertDepthToMeters(const rs2::frame &frame, const vector<uint16_t> *registeredDepth, T *meters) {
+        if (registeredDepth == nullptr) {
+            convertDepthFrameToMeters(frame, meters);
+            return;
+        }
+        DepthConversion::toMeters(registeredDepth->data(), meters, registeredDepth->size(),
+                                  frame.as<rs2::depth_frame>().get_units());
+    }
+
+    // grows the buffer only for larger frames, so that the steady state does not allocate
+    template<class T>
+    void reserveFrameBuffer(T *&buffer, size_t &capacity, size_t nrElements) {
+        if (nrElements <= capacity) {
+            return;
+        }
+        delete[] buffer;
+        buffer = new T[nrElements];
+        capacity = nrElements;
+    }
+
+    template<class T>
+    FrameView<T> makeFrameView(const T *data, int height, int width, int channels, size_t stride) {
+        FrameView<T> view;
+        if (data == nullptr) {
+            return view;
+        }
+        view.data = data;
+        view.height = height;
+        view.width = width;
+        view.channels = channels;
+        view.stride = stride;
+        return view;
+    }
+
+    // without the padding of the rows
+    void copyDepthFrame(const rs2::frame &frame, uint16_t *depth) {
+        auto depthFrame = frame.as<rs2::video_frame>();
+        int height = depthFrame.get_height(), width = depthFrame.get_width();
+        int stride = depthFrame.get_stride_in_bytes();
+        auto *frameData = (const uint8_t *) depthFrame.get_data();
+        for (int row = 0; row < height; row++) {
+            memcpy(depth + (size_t) row * width, frameData + (size_t) row * stride, width * sizeof(uint16_t));
+        }
+    }
+
+    // row by row as well, into 3 bytes per pixel
+    void convertYuyvFrame(const rs2::frame &frame, uint8_t *color, bool bgr) {
+        auto videoFrame = frame.as<rs2::video_frame>();
+        int height = videoFrame.get_height(), width = videoFrame.get_width();
+        int stride = videoFrame.get_stride_in_bytes();
+        auto *yuyv = (const uint8_t *) videoFrame.get_data();
+        for (int row = 0; row < height; row++) {
+            const uint8_t *yuyvRow = yuyv + (size_t) row * stride;
+            uint8_t *colorRow = color + (size_t) row * 3 * width;
+            if (bgr) {
+                ColorConversion::yuyvToBgr(yuyvRow, colorRow, width);
+            } else {
+                ColorConversion::yuyvToRgb(yuyvRow, colorRow, width);
+            }
+        }
+    }
+}
+
 RealsenseCapture::RealsenseCapture(int fps, bool withRecord, int recordedFileNumber, const string &recordedBagFile,
                                    int colorWidth, int colorHeight, int depthWidth, int depthHeight,
                                    const string &recordImageFormat, const string &recordDepthFormat,
                                    const string &recordParametersFormat, bool withOpenCV, bool withFrameAlignment,
-                                   bool writeFPSOnImage) :
-        IMAGE_FPS(fps), DEPTH_FPS(fps), inputRecording(), outputRecording(), IMAGE_HEIGHT(colorHeight),
-        IMAGE_WIDTH(colorWidth), DEPTH_HEIGHT(depthHeight), DEPTH_WIDTH(depthWidth), depthIntrinsics(),
-        writeFPSOnImage(writeFPSOnImage), alignTo(RS2_STREAM_COLOR), withOpenCV(withOpenCV),
-        withFrameAlignment(withFrameAlignment) {
+                                   bool writeFPSOnImage, bool withRawDepth, int replayPrefetchSize,
+                                   ImagePixelFormat colorPixelFormat) :
+        IMAGE_WIDTH(colorWidth), IMAGE_HEIGHT(colorHeight), IMAGE_FPS(fps), DEPTH_WIDTH(depthWidth),
+        DEPTH_HEIGHT(depthHeight), DEPTH_FPS(fps), colorPixelFormat(IMAGE_RGB8), alignTo(RS2_STREAM_COLOR),
+        depthRegistration(), registeredDepth(), imageConverted(false), depthConverted(false), imageDataCapacity(0),
+        depthDataCapacity(0), floatDepthDataCapacity(0), rawDepthDataCapacity(0), depthElementType(DEPTH_DOUBLE),
+        depthUnits(RecordingParameters::DEFAULT_DEPTH_UNITS), depthIntrinsics(), inputRecording(), outputRecording(),
+        replayStartTimestamp(-1), replayStartTime(), statsStart(chrono::steady_clock::now()), lastStatsDump(),
+        statsFile(), statsDumpPeriod(0), stopRequested(false), headless(false), displayFps(30), displayThread(),
+        nrProcessingThreads(0), acquisitionThread(), processingThreads(), nrAcquiredFrames(0), nextProcessedFrame(0),
+        nrInFlightFrames(0), acquisitionEnded(false), processingStopped(false), writeFPSOnImage(writeFPSOnImage),
+        withOpenCV(withOpenCV), withFrameAlignment(withFrameAlignment), withRawDepth(withRawDepth),
+        alignWithRegistration(false) {
     if (recordedFileNumber > -1) {
         this->inputRecording = new ReadRecording(recordedFileNumber);
+        this->inputRecording->setRawDepth(withRawDepth);
+        // decode the next frames ahead, so that the decoding latency does not show up as frame jitter
+        this->inputRecording->setPrefetchSize(replayPrefetchSize);
+        this->depthUnits = this->inputRecording->getParameters()->depthUnits;
+        // depth recorded without alignment is registered to the images while reading
+        this->inputRecording->setAlignedDepth(withFrameAlignment);
         if (withRecord) {
             this->outputRecording = new WriteRecording(recordImageFormat, recordDepthFormat, recordParametersFormat,
                                                        this->inputRecording->getParameters(),
-                                                       RecordingParametersType::RECORDING_PARAMETERS);
+                                                       RecordingParametersType::RECORDING_PARAMETERS, withOpenCV);
+            if (withFrameAlignment) {
+                this->outputRecording->setAlignedDepth();
+            }
+            // the replayed images are converted from YUYV when reading
+            this->outputRecording->setImagePixelFormat(IMAGE_RGB8);
         }
-        this->DEPTH_HEIGHT = this->IMAGE_HEIGHT = this->inputRecording->getParameters()->height;
-        this->DEPTH_WIDTH = this->IMAGE_WIDTH = this->inputRecording->getParameters()->width;
+        this->IMAGE_HEIGHT = this->inputRecording->getParameters()->height;
+        this->IMAGE_WIDTH = this->inputRecording->getParameters()->width;
+        this->DEPTH_HEIGHT = this->inputRecording->getDepthHeight();
+        this->DEPTH_WIDTH = this->inputRecording->getDepthWidth();
         this->DEPTH_FPS = this->IMAGE_FPS = (int) this->inputRecording->getParameters()->fps;
         this->sleepTime = 1000 / fps;
     } else {
         if (!recordedBagFile.empty()) {
             this->startConfig.enable_device_from_file(recordedBagFile, false);
         } else {
-            this->startConfig.enable_stream(RS2_STREAM_COLOR, this->IMAGE_WIDTH, this->IMAGE_HEIGHT, RS2_FORMAT_RGB8,
+            rs2_format colorFormat = (colorPixelFormat == IMAGE_YUYV) ? RS2_FORMAT_YUYV : RS2_FORMAT_RGB8;
+            this->startConfig.enable_stream(RS2_STREAM_COLOR, this->IMAGE_WIDTH, this->IMAGE_HEIGHT, colorFormat,
                                             this->IMAGE_FPS);
             this->startConfig.enable_stream(RS2_STREAM_DEPTH, this->DEPTH_WIDTH, this->DEPTH_HEIGHT, RS2_FORMAT_Z16,
                                             this->DEPTH_FPS);
@@ -54,13 +160,30 @@ RealsenseCapture::RealsenseCapture(int fps, bool withRecord, int recordedFileNum
         this->IMAGE_WIDTH = colorProfile.width();
         this->IMAGE_HEIGHT = colorProfile.height();
         this->IMAGE_FPS = colorProfile.fps();
+        // the format of the stream of a bag file is the recorded one
+        this->colorPixelFormat = (colorProfile.format() == RS2_FORMAT_YUYV) ? IMAGE_YUYV : IMAGE_RGB8;
         video_stream_profile depthProfile = config.get_stream(RS2_STREAM_DEPTH).as<video_stream_profile>();
         this->DEPTH_WIDTH = depthProfile.width();
         this->DEPTH_HEIGHT = depthProfile.height();
         this->DEPTH_FPS = depthProfile.fps();
+        if (withRawDepth) {
+            this->depthUnits = config.get_device().first<depth_sensor>().get_depth_scale();
+        }
         if (withRecord) {
             this->outputRecording = new WriteRecording(recordImageFormat, recordDepthFormat, recordParametersFormat,
-                                                       &colorProfile, RecordingParametersType::REALSENSE_INTRINSICS);
+                                                       &colorProfile, RecordingParametersType::REALSENSE_INTRINSICS,
+                                                       withOpenCV);
+            if (withRawDepth) {
+                // store the sensor's Z16 values unchanged instead of rescaling them to millimeters
+                this->outputRecording->setDepthUnits(this->depthUnits);
+            }
+            // the YUYV frames are recorded as they are, without their conversion
+            this->outputRecording->setImagePixelFormat(this->colorPixelFormat);
+            if (!withFrameAlignment) {
+                // the depth is stored at its own resolution, with what it takes to register it when reading
+                this->outputRecording->setUnalignedDepth(depthProfile.fps(), depthProfile.get_intrinsics(),
+                                                         depthProfile.get_extrinsics_to(colorProfile));
+            }
         }
     }
 
@@ -70,6 +193,13 @@ RealsenseCapture::RealsenseCapture(int fps, bool withRecord, int recordedFileNum
 }
 
 RealsenseCapture::~RealsenseCapture() {
+    // when run was left by an exception
+    this->stop();
+    if (this->displayThread.joinable()) {
+        this->displayThread.join();
+    }
+    this->stopProcessingThreads();
+
     delete this->outputRecording;
     this->outputRecording = nullptr;
 
@@ -80,98 +210,228 @@ RealsenseCapture::~RealsenseCapture() {
         delete this->inputRecording;
         this->inputRecording = nullptr;
     }
-
-    #ifdef OPENCV
-    // Close all OpenCV windows
-    cv::destroyAllWindows();
-    #endif
+    delete[] this->imageData;
+    delete[] this->depthData;
+    delete[] this->floatDepthData;
+    delete[] this->rawDepthData;
 }
 
 void RealsenseCapture::run() {
     #ifdef OPENCV
     cv::setUseOptimized(true);
-    cout << "Terminate by pressing the 'q' or Esc key\n";
-
-    // Set the location of OpenCV windows
-    cv::namedWindow("Color Image");
-    cv::moveWindow("Color Image", 50, 100);
-    cv::namedWindow("Depth Image");
-    cv::moveWindow("Depth Image", this->IMAGE_WIDTH + 50 + 17, 100);
+    if (!this->headless) {
+        cout << "Terminate by pressing the 'q' or Esc key\n";
+        this->displayThread = thread(&RealsenseCapture::displayThreadRun, this);
+    }
     #endif
+    if (this->inputRecording == nullptr && this->nrProcessingThreads > 0) {
+        this->startProcessingThreads();
+    }
 
     this->fpsTimer.start();
-    while (true) {
+    this->lastStatsDump = chrono::steady_clock::now();
+    while (!this->stopRequested.load()) {
         if (!this->updateFrame()) {
             break;
         }
         this->saveData();
-        this->computeAndDisplayFps();
-
-        #ifdef OPENCV
-        // Show frame streams
-        if (this->image.rows != 0 && this->image.cols != 0) {
-            cv::imshow("Color Image", this->image);
-        }
-        if (this->depth.rows != 0 && this->depth.cols != 0) {
-            cv::imshow("Depth Image", this->depth);
+        this->computeFps();
+        if (!this->statsFile.empty() &&
+            chrono::duration<double>(chrono::steady_clock::now() - this->lastStatsDump).count() >=
+            this->statsDumpPeriod) {
+            this->dumpStats();
         }
 
-        char c = (char) cv::waitKey(1);
-        if (c == 'q' || c == 27) {
-            break;
+        #ifdef OPENCV
+        if (!this->headless) {
+            this->publishDisplayFrame();
         }
         #endif
     }
+    this->stopProcessingThreads();
+    // also ends the display thread when the stream ended
+    this->stopRequested = true;
+    if (this->displayThread.joinable()) {
+        this->displayThread.join();
+    }
+    this->stopRequested = false;
+    if (!this->statsFile.empty()) {
+        this->dumpStats();
+    }
+}
+
+void RealsenseCapture::stop() {
+    this->stopRequested = true;
+}
+
+void RealsenseCapture::setHeadless(bool _headless) {
+    this->headless = _headless;
+}
+
+bool RealsenseCapture::isHeadless() const {
+    return this->headless;
+}
+
+void RealsenseCapture::setDisplayFps(double _displayFps) {
+    if (_displayFps <= 0) {
+        throw runtime_error("The display fps has to be positive! Was " + to_string(_displayFps));
+    }
+    this->displayFps = _displayFps;
+}
+
+void RealsenseCapture::setDepthElementType(DepthElementType _depthElementType) {
+    this->depthElementType = _depthElementType;
+    if (this->inputRecording != nullptr) {
+        this->inputRecording->setDepthElementType(_depthElementType);
+    }
+}
+
+DepthElementType RealsenseCapture::getDepthElementType() const {
+    return this->depthElementType;
+}
+
+void RealsenseCapture::setAlignWithRegistration(bool _alignWithRegistration) {
+    if (!this->withFrameAlignment || this->inputRecording != nullptr) {
+        return;
+    }
+    this->alignWithRegistration = _alignWithRegistration;
+    if (!_alignWithRegistration) {
+        return;
+    }
+    auto profile = this->pipeline.get_active_profile();
+    auto colorProfile = profile.get_stream(RS2_STREAM_COLOR).as<video_stream_profile>();
+    auto depthProfile = profile.get_stream(RS2_STREAM_DEPTH).as<video_stream_profile>();
+    rs2_extrinsics depthToColor = depthProfile.get_extrinsics_to(colorProfile);
+    this->depthRegistration.setParameters(depthProfile.get_intrinsics(), colorProfile.get_intrinsics(), depthToColor,
+                                          profile.get_device().first<depth_sensor>().get_depth_scale());
+    if (this->outputRecording != nullptr) {
+        this->outputRecording->setUnalignedDepth(depthProfile.fps(), depthProfile.get_intrinsics(), depthToColor);
+    }
+}
+
+bool RealsenseCapture::isAlignWithRegistration() const {
+    return this->alignWithRegistration;
+}
+
+void RealsenseCapture::setNrProcessingThreads(int _nrProcessingThreads) {
+    if (_nrProcessingThreads < 0) {
+        throw runtime_error("Can not work with a negative number of processing threads! Was " +
+                            to_string(_nrProcessingThreads));
+    }
+    this->nrProcessingThreads = _nrProcessingThreads;
 }
 
 bool RealsenseCapture::saveData() {
     if (this->outputRecording == nullptr) {
         return false;
     }
-    if (this->IMAGE_WIDTH != this->DEPTH_WIDTH || this->IMAGE_HEIGHT != this->DEPTH_HEIGHT) {
-        cout << "Recording with different image and depth resolutions is not yet supported..." << endl;
-        // TODO: support it :D
-        return false;
+    LatencyHistogram::ScopedTimer saveTimer(this->saveLatency);
+    if (this->inputRecording == nullptr) {
+        // hand the librealsense frames over as they are; the writer converts them on its own thread
+        auto image = this->imageFrame.as<rs2::video_frame>();
+        auto depth = this->depthFrame.as<rs2::depth_frame>();
+        return writeStatusEnqueued(this->outputRecording->writeData(&image, &depth));
     }
     if (this->withOpenCV) {
         #ifdef OPENCV
-        return this->outputRecording->writeData(&(this->image), &(this->depth));
+        return writeStatusEnqueued(this->outputRecording->writeData(&(this->image), &(this->depth)));
         #else
         throw runtime_error("Can not save data in opencv format without opencv backend enabled!");
         #endif
     }
-    int nrElements = this->IMAGE_WIDTH * this->IMAGE_HEIGHT;
-    return this->outputRecording->writeData(this->imageData, 3 * nrElements, this->depthData, nrElements);
+    int nrImageElements = 3 * this->IMAGE_WIDTH * this->IMAGE_HEIGHT;
+    int nrDepthElements = this->DEPTH_WIDTH * this->DEPTH_HEIGHT;
+    if (this->withRawDepth) {
+        return writeStatusEnqueued(this->outputRecording->writeData(this->imageData, nrImageElements,
+                                                                    this->rawDepthData, nrDepthElements));
+    } else if (this->depthElementType == DEPTH_FLOAT) {
+        return writeStatusEnqueued(this->outputRecording->writeData(this->imageData, nrImageElements,
+                                                                    this->floatDepthData, nrDepthElements));
+    }
+    return writeStatusEnqueued(this->outputRecording->writeData(this->imageData, nrImageElements, this->depthData,
+                                                                nrDepthElements));
 }
 
 #ifdef OPENCV
 
 cv::Mat &RealsenseCapture::getImage() {
+    this->convertImage();
     return this->image;
 }
 
 cv::Mat RealsenseCapture::getImage() const {
-    return this->image;
+    return this->imageConverted ? this->image : cv::Mat();
 }
 
 void RealsenseCapture::setImage(const cv::Mat &_image) {
     this->image = _image;
+    this->imageConverted = true;
 }
 
 cv::Mat &RealsenseCapture::getDepth() {
+    this->convertDepth();
     return this->depth;
 }
 
 cv::Mat RealsenseCapture::getDepth() const {
-    return this->depth;
+    return this->depthConverted ? this->depth : cv::Mat();
 }
 
 void RealsenseCapture::setDepth(const cv::Mat &_depth) {
     this->depth = _depth;
+    this->depthConverted = true;
 }
 
 #endif
 
+const uint8_t *RealsenseCapture::getImageData() {
+    this->convertImage();
+    return this->imageData;
+}
+
+const double *RealsenseCapture::getDepthData() {
+    this->convertDepth();
+    return this->depthData;
+}
+
+const float *RealsenseCapture::getFloatDepthData() {
+    this->convertDepth();
+    return this->floatDepthData;
+}
+
+const uint16_t *RealsenseCapture::getRawDepthData() {
+    this->convertDepth();
+    return this->rawDepthData;
+}
+
+ImageView RealsenseCapture::getImageView() {
+    int width = this->IMAGE_WIDTH;
+    return makeFrameView<uint8_t>(this->getImageData(), this->IMAGE_HEIGHT, width, 3, (size_t) 3 * width);
+}
+
+FrameView<double> RealsenseCapture::getDepthView() {
+    int width = this->depthIntrinsics.width;
+    return makeFrameView<double>(this->getDepthData(), this->depthIntrinsics.height, width, 1, width);
+}
+
+FrameView<float> RealsenseCapture::getFloatDepthView() {
+    int width = this->depthIntrinsics.width;
+    return makeFrameView<float>(this->getFloatDepthData(), this->depthIntrinsics.height, width, 1, width);
+}
+
+DepthView RealsenseCapture::getRawDepthView() {
+    if (this->inputRecording == nullptr && this->depthFrame && this->withRawDepth && !this->withOpenCV &&
+        !this->alignWithRegistration) {
+        // straight into the live depth frame, padded rows included, instead of copying it
+        auto depthVideoFrame = this->depthFrame.as<rs2::video_frame>();
+        return makeFrameView<uint16_t>((const uint16_t *) depthVideoFrame.get_data(), depthVideoFrame.get_height(),
+                                       depthVideoFrame.get_width(), 1,
+                                       depthVideoFrame.get_stride_in_bytes() / sizeof(uint16_t));
+    }
+    int width = this->depthIntrinsics.width;
+    return makeFrameView<uint16_t>(this->getRawDepthData(), this->depthIntrinsics.height, width, 1, width);
+}
+
 rs2::frame &RealsenseCapture::getImageFrame() {
     return this->imageFrame;
 }
@@ -200,10 +460,45 @@ void RealsenseCapture::setDepthIntrinsics(const rs2_intrinsics &_depthIntrinsics
     this->depthIntrinsics = _depthIntrinsics;
 }
 
+float RealsenseCapture::getDepthUnits() const {
+    return this->depthUnits;
+}
+
+void RealsenseCapture::getStats(nlohmann::json &stats) const {
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - this->statsStart).count();
+    stats["elapsedSeconds"] = seconds;
+    stats["nrFrames"] = this->frameLatency.getCount();
+    stats["framesPerSecond"] = (seconds > 0) ? (double) this->frameLatency.getCount() / seconds : 0;
+    if (this->inputRecording != nullptr) {
+        this->readLatency.to_json(stats["stages"]["readRecording"]);
+    } else {
+        this->waitForFramesLatency.to_json(stats["stages"]["waitForFrames"]);
+        if (this->withFrameAlignment) {
+            this->alignLatency.to_json(stats["stages"]["align"]);
+        }
+        this->conversionLatency.to_json(stats["stages"]["conversion"]);
+        stats["nrProcessingThreads"] = this->nrProcessingThreads;
+    }
+    this->saveLatency.to_json(stats["stages"]["saveData"]);
+    this->frameLatency.to_json(stats["stages"]["frame"]);
+    if (this->outputRecording != nullptr) {
+        this->outputRecording->getStats(stats["writer"]);
+    }
+}
+
+void RealsenseCapture::setStatsDump(const string &file, double periodSeconds) {
+    if (periodSeconds <= 0) {
+        throw runtime_error("The stats dump period has to be positive! Was " + to_string(periodSeconds));
+    }
+    this->statsFile = file;
+    this->statsDumpPeriod = periodSeconds;
+}
+
 bool RealsenseCapture::updateFrame() {
     if (this->inputRecording != nullptr) {
         if (this->withOpenCV) {
             #ifdef OPENCV
+            LatencyHistogram::ScopedTimer readTimer(this->readLatency);
             if (!this->inputRecording->readData(&(this->image), &(this->depth))) {
                 return false;
             }
@@ -211,70 +506,419 @@ bool RealsenseCapture::updateFrame() {
             throw runtime_error("Can not use opencv backend to read recording data when opencv is not enabled!");
             #endif
         } else {
-            // the readData function will delete old and allocate new memory for the new image data
-            if (!this->inputRecording->readData(this->imageData, this->depthData)) {
+            LatencyHistogram::ScopedTimer readTimer(this->readLatency);
+            // readData allocates the buffers for the first frame and reads the next ones into them
+            if (this->withRawDepth) {
+                if (!this->inputRecording->readData(&(this->imageData), &(this->rawDepthData))) {
+                    return false;
+                }
+            } else if (this->depthElementType == DEPTH_FLOAT) {
+                if (!this->inputRecording->readData(&(this->imageData), &(this->floatDepthData))) {
+                    return false;
+                }
+            } else if (!this->inputRecording->readData(&(this->imageData), &(this->depthData))) {
                 return false;
             }
         }
-        this->depthIntrinsics = this->inputRecording->getIntrinsics();
-        this_thread::sleep_for(chrono::milliseconds(this->sleepTime - 5));
-    } else {
+        // ReadRecording already converted them
+        this->imageConverted = true;
+        this->depthConverted = true;
+        // the image's intrinsics, unless the depth was recorded unaligned and is not registered
+        this->depthIntrinsics = this->inputRecording->isAlignedDepth() ?
+                                this->inputRecording->getIntrinsics() :
+                                this->inputRecording->getParameters()->getDepthIntrinsics();
+        this->waitForReplayTime();
+        return true;
+    }
+    return this->processingThreads.empty() ? this->updateCameraFrame() : this->updateProcessedFrame();
+}
+
+bool RealsenseCapture::updateCameraFrame() {
+    CapturedFrame captured;
+    try {
         // Wait for next set of frames
-        try {
-            this->frames = this->pipeline.wait_for_frames(1000);
-            if (this->withFrameAlignment) {
-                // Make sure the frames are spatially aligned
-                this->frames = this->alignTo.process(this->frames);
+        auto stageStart = chrono::steady_clock::now();
+        this->frames = this->pipeline.wait_for_frames(1000);
+        this->waitForFramesLatency.recordSince(stageStart);
+        this->processFrameset(this->frames, this->alignTo, captured);
+    } catch (exception &e) {
+        cout << "Caught exception while waiting for frames: " << e.what() << endl;
+        return false;
+    }
+    this->takeCapturedFrame(captured);
+    return true;
+}
+
+bool RealsenseCapture::updateProcessedFrame() {
+    CapturedFrame captured;
+    {
+        unique_lock<mutex> processingGuard(this->processingLock);
+        while (this->processedFrames.count(this->nextProcessedFrame) == 0) {
+            if (this->acquisitionEnded && this->nextProcessedFrame >= this->nrAcquiredFrames) {
+                cout << "Caught exception while waiting for frames: " << this->acquisitionError << endl;
+                return false;
             }
-        } catch (exception &e) {
-            cout << "Caught exception while waiting for frames: " << e.what() << endl;
-            return false;
+            if (this->stopRequested.load()) {
+                return false;
+            }
+            // with a timeout, because stop can not notify (it may be called from a signal handler)
+            this->processedCondition.wait_for(processingGuard, chrono::milliseconds(100));
         }
+        auto processedFrame = this->processedFrames.find(this->nextProcessedFrame);
+        captured = move(processedFrame->second);
+        this->processedFrames.erase(processedFrame);
+        this->nextProcessedFrame++;
+        this->nrInFlightFrames--;
+    }
+    this->slotCondition.notify_one();
+    if (!captured.error.empty()) {
+        cout << "Caught exception while processing frames: " << captured.error << endl;
+        return false;
+    }
+    this->takeCapturedFrame(captured);
+    return true;
+}
 
-        // Get color & depth frames
-        this->imageFrame = this->frames.get_color_frame();
-        this->depthFrame = this->frames.get_depth_frame();
+void RealsenseCapture::processFrameset(rs2::frameset frameset, rs2::align &align, CapturedFrame &captured) {
+    if (this->withFrameAlignment && !this->alignWithRegistration) {
+        // Make sure the frames are spatially aligned; the recording needs the aligned frames, so this is not left to
+        // the getters
+        auto stageStart = chrono::steady_clock::now();
+        frameset = align.process(frameset);
+        this->alignLatency.recordSince(stageStart);
+    }
 
-        if (this->withOpenCV) {
-            #ifdef OPENCV
+    // Get color & depth frames
+    captured.imageFrame = frameset.get_color_frame();
+    captured.depthFrame = frameset.get_depth_frame();
+
+    auto depthFrame = captured.depthFrame.as<rs2::video_frame>();
+    if (this->alignWithRegistration && depthFrame.get_stride_in_bytes() != depthFrame.get_width() * 2) {
+        throw runtime_error("Can not register depth frames with padded rows!");
+    }
+
+    // the registered depth has the image's intrinsics, as the aligned depth frame does
+    const rs2::frame &intrinsicsFrame = this->alignWithRegistration ? captured.imageFrame : captured.depthFrame;
+    captured.depthIntrinsics = intrinsicsFrame.get_profile().as<video_stream_profile>().get_intrinsics();
+}
+
+void RealsenseCapture::takeCapturedFrame(CapturedFrame &captured) {
+    this->imageFrame = captured.imageFrame;
+    this->depthFrame = captured.depthFrame;
+    this->depthIntrinsics = captured.depthIntrinsics;
+    // converted again on demand
+    this->imageConverted = false;
+    this->depthConverted = false;
+}
+
+void RealsenseCapture::convertImage() {
+    if (this->imageConverted) {
+        return;
+    }
+    this->imageConverted = true;
+    if (this->inputRecording != nullptr || !this->imageFrame) {
+        return;
+    }
+    LatencyHistogram::ScopedTimer conversionTimer(this->conversionLatency);
+    if (this->withOpenCV) {
+        #ifdef OPENCV
+        if (this->colorPixelFormat == IMAGE_YUYV) {
+            auto videoFrame = this->imageFrame.as<rs2::video_frame>();
+            this->image.create(videoFrame.get_height(), videoFrame.get_width(), CV_8UC3);
+            convertYuyvFrame(this->imageFrame, this->image.data, true);
+        } else {
             this->image = frame_to_mat(this->imageFrame);
-            this->depth = depth_frame_to_meters(this->depthFrame);
-            #else
-            cout << "Can not use opencv backend without opencv enabled..." << endl;
-            #endif
+        }
+        #else
+        cout << "Can not use opencv backend without opencv enabled..." << endl;
+        #endif
+        return;
+    }
+    auto videoFrame = this->imageFrame.as<rs2::video_frame>();
+    // YUYV is converted to 3 bytes per pixel
+    int bytesPerPixel = (this->colorPixelFormat == IMAGE_YUYV) ? 3 : videoFrame.get_bytes_per_pixel();
+    int nrElements = videoFrame.get_height() * videoFrame.get_width() * bytesPerPixel;
+    reserveFrameBuffer(this->imageData, this->imageDataCapacity, nrElements);
+    if (this->colorPixelFormat == IMAGE_YUYV) {
+        convertYuyvFrame(this->imageFrame, this->imageData, false);
+    } else {
+        int imageDataType;
+        frameToBytes(this->imageFrame, this->imageData, imageDataType, nrElements);
+        assert (imageDataType == StandardTypes::TYPE_UINT_8);
+    }
+}
+
+void RealsenseCapture::convertDepth() {
+    if (this->depthConverted) {
+        return;
+    }
+    this->depthConverted = true;
+    if (this->inputRecording != nullptr || !this->depthFrame) {
+        return;
+    }
+    // the depth in depth units at the color resolution, instead of the aligned depth frame
+    const vector<uint16_t> *registered = nullptr;
+    auto depthVideoFrame = this->depthFrame.as<rs2::video_frame>();
+    int depthHeight = depthVideoFrame.get_height(), depthWidth = depthVideoFrame.get_width();
+    if (this->alignWithRegistration) {
+        this->registerDepthFrame();
+        registered = &(this->registeredDepth);
+        depthHeight = this->depthRegistration.getRegisteredHeight();
+        depthWidth = this->depthRegistration.getRegisteredWidth();
+    }
+
+    LatencyHistogram::ScopedTimer conversionTimer(this->conversionLatency);
+    if (this->withOpenCV) {
+        #ifdef OPENCV
+        if (this->withRawDepth && registered != nullptr) {
+            cv::Mat(depthHeight, depthWidth, CV_16UC1, this->registeredDepth.data()).copyTo(this->depth);
+        } else if (this->withRawDepth) {
+            this->depth = frame_to_mat(this->depthFrame);
+        } else if (this->depthElementType == DEPTH_FLOAT) {
+            this->depth.create(depthHeight, depthWidth, CV_32FC1);
+            convertDepthToMeters(this->depthFrame, registered, this->depth.ptr<float>());
         } else {
-            delete[] this->imageData;
-            auto videoFrame = this->imageFrame.as<rs2::video_frame>();
-            int nrElements = videoFrame.get_height() * videoFrame.get_width() * videoFrame.get_bytes_per_pixel();
-            this->imageData = new uint8_t[nrElements];
-            int imageDataType;
-            frameToBytes(this->imageFrame, this->imageData, imageDataType, nrElements);
-            assert (imageDataType == StandardTypes::TYPE_UINT_8);
-            delete[] this->depthData;
-            videoFrame = this->depthFrame.as<rs2::video_frame>();
-            nrElements = videoFrame.get_height() * videoFrame.get_width();
-            this->depthData = new double[nrElements];
-            depthFrameToMeters(this->depthFrame, this->depthData, nrElements);
+            this->depth.create(depthHeight, depthWidth, CV_64FC1);
+            convertDepthToMeters(this->depthFrame, registered, this->depth.ptr<double>());
         }
+        #else
+        cout << "Can not use opencv backend without opencv enabled..." << endl;
+        #endif
+        return;
+    }
+    // in raw depth mode, the Z16 frame is recorded as it is (see saveData) and never converted to meters here
+    int nrElements = depthHeight * depthWidth;
+    if (this->withRawDepth) {
+        reserveFrameBuffer(this->rawDepthData, this->rawDepthDataCapacity, nrElements);
+        if (registered != nullptr) {
+            memcpy(this->rawDepthData, registered->data(), nrElements * sizeof(uint16_t));
+        } else {
+            copyDepthFrame(this->depthFrame, this->rawDepthData);
+        }
+    } else if (this->depthElementType == DEPTH_FLOAT) {
+        reserveFrameBuffer(this->floatDepthData, this->floatDepthDataCapacity, nrElements);
+        convertDepthToMeters(this->depthFrame, registered, this->floatDepthData);
+    } else {
+        reserveFrameBuffer(this->depthData, this->depthDataCapacity, nrElements);
+        convertDepthToMeters(this->depthFrame, registered, this->depthData);
+    }
+}
 
-        this->depthIntrinsics = this->depthFrame.get_profile().as<video_stream_profile>().get_intrinsics();
+void RealsenseCapture::registerDepthFrame() {
+    auto stageStart = chrono::steady_clock::now();
+    this->registeredDepth.resize(
+            (size_t) this->depthRegistration.getRegisteredHeight() * this->depthRegistration.getRegisteredWidth());
+    this->depthRegistration.registerDepth((const uint16_t *) this->depthFrame.get_data(),
+                                          this->registeredDepth.data());
+    this->alignLatency.recordSince(stageStart);
+}
+
+void RealsenseCapture::startProcessingThreads() {
+    this->processingJobs.clear();
+    this->processedFrames.clear();
+    this->nrAcquiredFrames = 0;
+    this->nextProcessedFrame = 0;
+    this->nrInFlightFrames = 0;
+    this->acquisitionEnded = false;
+    this->processingStopped = false;
+    this->acquisitionError.clear();
+    for (int i = 0; i < this->nrProcessingThreads; i++) {
+        this->processingThreads.emplace_back(&RealsenseCapture::processingThreadRun, this);
+    }
+    this->acquisitionThread = thread(&RealsenseCapture::acquisitionThreadRun, this);
+}
+
+void RealsenseCapture::stopProcessingThreads() {
+    {
+        lock_guard<mutex> processingGuard(this->processingLock);
+        this->processingStopped = true;
+    }
+    this->jobCondition.notify_all();
+    this->slotCondition.notify_all();
+    this->processedCondition.notify_all();
+    if (this->acquisitionThread.joinable()) {
+        this->acquisitionThread.join();
+    }
+    for (auto &processingThread: this->processingThreads) {
+        processingThread.join();
+    }
+    this->processingThreads.clear();
+    this->processingJobs.clear();
+    this->processedFrames.clear();
+}
+
+void RealsenseCapture::acquisitionThreadRun() {
+    while (true) {
+        {
+            // bounds the memory and the reordering when the consumer or the processing threads fall behind
+            unique_lock<mutex> processingGuard(this->processingLock);
+            this->slotCondition.wait(processingGuard, [this]() {
+                return this->processingStopped || this->nrInFlightFrames < 2 * this->nrProcessingThreads;
+            });
+            if (this->processingStopped) {
+                return;
+            }
+            this->nrInFlightFrames++;
+        }
+        rs2::frameset frameset;
+        try {
+            auto stageStart = chrono::steady_clock::now();
+            frameset = this->pipeline.wait_for_frames(1000);
+            this->waitForFramesLatency.recordSince(stageStart);
+            // hold on to the frames beyond librealsense's frame queue while they wait for a processing thread
+            frameset.keep();
+        } catch (exception &e) {
+            {
+                lock_guard<mutex> processingGuard(this->processingLock);
+                this->acquisitionEnded = true;
+                this->acquisitionError = e.what();
+                this->nrInFlightFrames--;
+            }
+            this->processedCondition.notify_all();
+            return;
+        }
+        {
+            lock_guard<mutex> processingGuard(this->processingLock);
+            this->processingJobs.emplace_back(this->nrAcquiredFrames++, frameset);
+        }
+        this->jobCondition.notify_one();
+    }
+}
+
+void RealsenseCapture::processingThreadRun() {
+    // a processing block handles one frameset at a time, so that every thread needs its own; the registration is
+    // left to the getters of the frame
+    rs2::align align(RS2_STREAM_COLOR);
+    while (true) {
+        pair<unsigned long long, rs2::frameset> job;
+        {
+            unique_lock<mutex> processingGuard(this->processingLock);
+            this->jobCondition.wait(processingGuard, [this]() {
+                return this->processingStopped || !this->processingJobs.empty();
+            });
+            if (this->processingStopped) {
+                return;
+            }
+            job = move(this->processingJobs.front());
+            this->processingJobs.pop_front();
+        }
+        CapturedFrame captured;
+        try {
+            this->processFrameset(job.second, align, captured);
+        } catch (exception &e) {
+            captured.error = e.what();
+        }
+        {
+            lock_guard<mutex> processingGuard(this->processingLock);
+            this->processedFrames[job.first] = move(captured);
+        }
+        this->processedCondition.notify_all();
     }
-    return true;
 }
 
-void RealsenseCapture::computeAndDisplayFps() {
-    // Calculate frames per second (fps) and show it on depth frame
+void RealsenseCapture::waitForReplayTime() {
+    double timestamp = -1;
+    int frameIndex = this->inputRecording->getCurrentFrameIndex();
+    if (this->inputRecording->hasIndex() && frameIndex >= 0 && frameIndex < this->inputRecording->getNrFrames()) {
+        timestamp = this->inputRecording->getFrameIndexEntry(frameIndex).getReplayTimestamp();
+    }
+    if (timestamp < 0) {
+        // no recorded timing: replay at the recorded fps
+        this_thread::sleep_for(chrono::milliseconds(this->sleepTime - 5));
+        return;
+    }
+
+    auto now = chrono::steady_clock::now();
+    if (this->replayStartTimestamp < 0 || timestamp < this->replayStartTimestamp) {
+        this->replayStartTimestamp = timestamp;
+        this->replayStartTime = now;
+        return;
+    }
+    // sleep until the frame's offset from the replay start, so that the sleeping errors do not accumulate
+    auto offset = chrono::duration<double, milli>(timestamp - this->replayStartTimestamp);
+    this_thread::sleep_until(this->replayStartTime + chrono::duration_cast<chrono::steady_clock::duration>(offset));
+}
+
+void RealsenseCapture::dumpStats() {
+    nlohmann::json stats;
+    this->getStats(stats);
+    writeJsonFile(this->statsFile, stats);
+    this->lastStatsDump = chrono::steady_clock::now();
+}
+
+#ifdef OPENCV
+
+void RealsenseCapture::publishDisplayFrame() {
+    // copy outside of the lock: the captured frames are overwritten (or released) by the next updateFrame. Without
+    // the OpenCV representation there is nothing to show, and nothing is converted for it
+    if (this->withOpenCV) {
+        this->getImage().copyTo(this->displayImageBack);
+        this->getDepth().copyTo(this->displayDepthBack);
+        if (this->writeFPSOnImage) {
+            // only on the displayed copy, never on the captured (or recorded) image
+            cv::putText(this->displayImageBack, to_string(this->fps) + "fps", cv::Point(2, 28),
+                        cv::FONT_HERSHEY_COMPLEX, 1.0, this->SCALAR_BLUE, 1, cv::LINE_AA);
+        }
+    } else {
+        this->displayImageBack.release();
+        this->displayDepthBack.release();
+    }
+    lock_guard<mutex> displayGuard(this->displayLock);
+    swap(this->displayImageBack, this->displayImagePending);
+    swap(this->displayDepthBack, this->displayDepthPending);
+    this->displayFramePending = true;
+}
+
+void RealsenseCapture::displayThreadRun() {
+    // all the window handling stays on this thread
+    cv::namedWindow("Color Image");
+    cv::moveWindow("Color Image", 50, 100);
+    cv::namedWindow("Depth Image");
+    cv::moveWindow("Depth Image", this->IMAGE_WIDTH + 50 + 17, 100);
+
+    int displayPeriod = max(1, (int) (1000 / this->displayFps));
+    cv::Mat shownImage, shownDepth;
+    while (!this->stopRequested.load()) {
+        bool newFrame = false;
+        {
+            lock_guard<mutex> displayGuard(this->displayLock);
+            if (this->displayFramePending) {
+                swap(this->displayImagePending, shownImage);
+                swap(this->displayDepthPending, shownDepth);
+                this->displayFramePending = false;
+                newFrame = true;
+            }
+        }
+        // Show frame streams
+        if (newFrame && shownImage.rows != 0 && shownImage.cols != 0) {
+            cv::imshow("Color Image", shownImage);
+        }
+        if (newFrame && shownDepth.rows != 0 && shownDepth.cols != 0) {
+            cv::imshow("Depth Image", shownDepth);
+        }
+
+        // also paces the display thread
+        char c = (char) cv::waitKey(displayPeriod);
+        if (c == 'q' || c == 27) {
+            this->stop();
+        }
+    }
+    cv::destroyAllWindows();
+}
+
+#endif
+
+void RealsenseCapture::computeFps() {
+    // Calculate frames per second (fps); publishDisplayFrame shows it on the displayed image. Only the frame time is
+    // measured here, so that nothing is converted for it
     double time = this->fpsTimer.measure("ms");
+    this->frameLatency.record((uint64_t) (time * 1e6));
     this->fps = (int) (1000.0 / time);
-    string fps_str = string(to_string(this->fps) + "fps");
     // cout << "fps = " << fps << endl;
+    #ifndef OPENCV
     if (this->writeFPSOnImage) {
-        #ifdef OPENCV
-        cv::putText(this->image, fps_str, cv::Point(2, 28), cv::FONT_HERSHEY_COMPLEX, 1.0, this->SCALAR_BLUE, 1,
-                    cv::LINE_AA);
-        #else
         cout << "Can not write fps on image when opencv is not enabled; fps = " << fps << endl;
-        #endif
     }
+    #endif
     this->fpsTimer.start();
 }
@@ -0,0 +1,81 @@
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <RealsenseRecording/recording/ColorConversion.h>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace RealsenseRecording;
+using namespace std;
+
+// in megapixels per second
+double measurePixelRate(const function<void()> &convert, size_t nrPixels, int nrIterations) {
+    convert();
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < nrIterations; i++) {
+        convert();
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return (double) nrPixels * nrIterations / seconds / 1e6;
+}
+
+void printPixelRate(const string &conversion, const string &implementation, double pixelRate) {
+    cout << setw(14) << conversion << setw(10) << implementation << fixed << setprecision(1) << setw(10) << pixelRate
+         << " MP/s" << endl;
+}
+
+int main(int argc, char **argv) {
+    if (argc > 4 || (argc > 1 && (string(argv[1]) == "-h" || string(argv[1]) == "--help"))) {
+        cout << "Usage: " << argv[0] << " [width] [height] [nrIterations]" << endl;
+        return 1;
+    }
+    try {
+        int width = (argc > 1) ? stoi(argv[1]) : 1280;
+        int height = (argc > 2) ? stoi(argv[2]) : 720;
+        int nrIterations = (argc > 3) ? stoi(argv[3]) : 200;
+        if (width % 2 != 0) {
+            throw runtime_error("YUYV frames have an even width! Was " + to_string(width));
+        }
+        size_t nrPixels = (size_t) width * height;
+
+        // random values cover the saturated channels as well
+        vector<uint8_t> yuyv(2 * nrPixels), scalarRgb(3 * nrPixels), scalarBgr(3 * nrPixels), color(3 * nrPixels);
+        srand(17);
+        for (uint8_t &value: yuyv) {
+            value = (uint8_t) (rand() & 0xFF);
+        }
+        string defaultInstructionSet = ColorConversion::getInstructionSet();
+        ColorConversion::setInstructionSet("scalar");
+        ColorConversion::yuyvToRgb(yuyv.data(), scalarRgb.data(), nrPixels);
+        ColorConversion::yuyvToBgr(yuyv.data(), scalarBgr.data(), nrPixels);
+
+        cout << nrIterations << " conversions of " << width << "x" << height << " YUYV frames ("
+             << 2 * nrPixels / 1024 << " KB recorded instead of " << 3 * nrPixels / 1024
+             << " KB); default instruction set: " << defaultInstructionSet << endl;
+        for (const string instructionSet: {"scalar", "ssse3"}) {
+            if (!ColorConversion::setInstructionSet(instructionSet)) {
+                continue;
+            }
+            printPixelRate("yuyv -> rgb", instructionSet, measurePixelRate([&]() {
+                ColorConversion::yuyvToRgb(yuyv.data(), color.data(), nrPixels);
+            }, nrPixels, nrIterations));
+            if (color != scalarRgb) {
+                throw runtime_error("The " + instructionSet + " RGB conversion differs from the scalar one");
+            }
+            printPixelRate("yuyv -> bgr", instructionSet, measurePixelRate([&]() {
+                ColorConversion::yuyvToBgr(yuyv.data(), color.data(), nrPixels);
+            }, nrPixels, nrIterations));
+            if (color != scalarBgr) {
+                throw runtime_error("The " + instructionSet + " BGR conversion differs from the scalar one");
+            }
+        }
+    } catch (exception &ex) {
+        cout << "Caught exception while benchmarking the color conversions: " << ex.what() << endl;
+        return 1;
+    }
+
+    return 0;
+}
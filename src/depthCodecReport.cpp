@@ -0,0 +1,82 @@
+#include <chrono>
+#include <iostream>
+#include <RealsenseRecording/recording/DepthCodec.h>
+#include <RealsenseRecording/recording/ReadRecording.h>
+#include <RealsenseRecording/utils.h>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace RealsenseRecording;
+using namespace std;
+
+void reportDepthCompression(int fileNumber) {
+    ReadRecording recording(fileNumber);
+    const RecordingParameters *p = recording.getParameters();
+    // the recorded depth, which is not registered to the image when it is unaligned
+    int height = p->getDepthHeight(), width = p->getDepthWidth(), depthSize = height * width;
+    vector<vector<uint16_t>> frames;
+    uint8_t *image = nullptr;
+    uint16_t *depth = nullptr;
+    while (recording.readData(&image, &depth)) {
+        frames.emplace_back(depth, depth + depthSize);
+    }
+    delete[] image;
+    delete[] depth;
+    if (frames.empty()) {
+        cout << "Recording " << fileNumber << " has no depth frames" << endl;
+        return;
+    }
+
+    double rawMB = (double) frames.size() * depthSize * sizeof(uint16_t) / (1024.0 * 1024.0);
+    cout << "Recording " << fileNumber << ": " << frames.size() << " depth frames of " << width << "x" << height
+         << endl;
+    // decoded into their own buffers, so that the timed loop does not include the comparison
+    vector<vector<uint16_t>> decodedFrames(frames.size(), vector<uint16_t>(depthSize));
+    for (int nrChunks: {1, 2, 4, 8, 16}) {
+        DepthCodec codec(nrChunks);
+        auto start = chrono::steady_clock::now();
+        for (const auto &frame: frames) {
+            codec.encodeToBuffers(frame.data(), height, width);
+        }
+        double encodeSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        stringstream encoded;
+        for (const auto &frame: frames) {
+            codec.encode(frame.data(), height, width, &encoded);
+        }
+        start = chrono::steady_clock::now();
+        for (auto &decoded: decodedFrames) {
+            if (!codec.decode(&encoded, decoded.data(), height, width)) {
+                throw runtime_error("Could not decode an encoded depth frame");
+            }
+        }
+        double decodeSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        if (decodedFrames != frames) {
+            throw runtime_error("A decoded depth frame differs from the original one");
+        }
+
+        cout << "\t" << nrChunks << " chunks: ratio " << codec.getCompressionRatio() << ", encode "
+             << rawMB / encodeSeconds << " MB/s, decode " << rawMB / decodeSeconds << " MB/s" << endl;
+    }
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        cout << "Usage: " << argv[0] << " <recordedFileNumber>..." << endl;
+        return 1;
+    }
+    setConfigDirectoryLocation("../config/");
+
+    try {
+        for (int i = 1; i < argc; i++) {
+            reportDepthCompression(stoi(argv[i]));
+        }
+    } catch (exception &ex) {
+        cout << "Caught exception while measuring the depth compression: " << ex.what() << endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,119 @@
+#include <chrono>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <RealsenseRecording/recording/DepthConversion.h>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace RealsenseRecording;
+using namespace std;
+
+const float DEPTH_UNITS = 0.001f;
+
+// the loops the depth conversions used before
+void toMetersOpenMPLoop(const uint16_t *depth, double *meters, int nrElements, float depthUnits) {
+    double units = depthUnits;
+    #pragma omp parallel for shared(depth, meters, nrElements, units) default(none)
+    for (int i = 0; i < nrElements; i++) {
+        meters[i] = depth[i] * units;
+    }
+}
+
+void toDepthUnitsOpenMPLoop(const double *meters, uint16_t *depth, size_t nrElements, float depthUnits) {
+    double unitsPerMeter = 1.0 / depthUnits;
+    #pragma omp parallel for shared(depth, meters, nrElements, unitsPerMeter) default(none)
+    for (size_t i = 0; i < nrElements; i++) {
+        depth[i] = (uint16_t) (meters[i] * unitsPerMeter + 0.5);
+    }
+}
+
+void rescaleLoop(const uint16_t *depth, uint16_t *rescaled, size_t nrElements, float scale) {
+    for (size_t i = 0; i < nrElements; i++) {
+        rescaled[i] = (uint16_t) (depth[i] * scale + 0.5f);
+    }
+}
+
+// in GB/s of read and written memory
+double measureThroughput(const function<void()> &convert, size_t nrBytesPerCall, int nrIterations) {
+    convert();
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < nrIterations; i++) {
+        convert();
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return (double) nrBytesPerCall * nrIterations / seconds / 1e9;
+}
+
+void printThroughput(const string &conversion, const string &implementation, double throughput) {
+    cout << setw(22) << conversion << setw(14) << implementation << fixed << setprecision(2) << setw(9) << throughput
+         << " GB/s" << endl;
+}
+
+int main(int argc, char **argv) {
+    if (argc > 4 || (argc > 1 && (string(argv[1]) == "-h" || string(argv[1]) == "--help"))) {
+        cout << "Usage: " << argv[0] << " [width] [height] [nrIterations]" << endl;
+        return 1;
+    }
+    try {
+        int width = (argc > 1) ? stoi(argv[1]) : 1280;
+        int height = (argc > 2) ? stoi(argv[2]) : 720;
+        int nrIterations = (argc > 3) ? stoi(argv[3]) : 200;
+        size_t nrElements = (size_t) width * height;
+
+        vector<uint16_t> depth(nrElements), depthResult(nrElements);
+        vector<double> meters(nrElements);
+        vector<float> metersFloat(nrElements);
+        for (size_t i = 0; i < nrElements; i++) {
+            // a slanted plane with invalid pixels
+            depth[i] = (i % 37 == 0) ? 0 : (uint16_t) (500 + (i % width) / 2 + (i / width));
+            meters[i] = depth[i] * (double) DEPTH_UNITS;
+            metersFloat[i] = (float) meters[i];
+        }
+        size_t toMetersBytes = nrElements * (sizeof(uint16_t) + sizeof(double));
+        size_t toMetersFloatBytes = nrElements * (sizeof(uint16_t) + sizeof(float));
+        size_t rescaleBytes = nrElements * 2 * sizeof(uint16_t);
+
+        cout << nrIterations << " conversions of " << width << "x" << height
+             << " depth frames; default instruction set: " << DepthConversion::getInstructionSet() << endl;
+        printThroughput("uint16 -> double", "openmp loop", measureThroughput([&]() {
+            toMetersOpenMPLoop(depth.data(), meters.data(), (int) nrElements, DEPTH_UNITS);
+        }, toMetersBytes, nrIterations));
+        printThroughput("double -> uint16", "openmp loop", measureThroughput([&]() {
+            toDepthUnitsOpenMPLoop(meters.data(), depthResult.data(), nrElements, DEPTH_UNITS);
+        }, toMetersBytes, nrIterations));
+        printThroughput("uint16 rescale", "loop", measureThroughput([&]() {
+            rescaleLoop(depth.data(), depthResult.data(), nrElements, 0.5f);
+        }, rescaleBytes, nrIterations));
+
+        for (const string instructionSet: {"scalar", "sse4.1", "avx2", "neon"}) {
+            if (!DepthConversion::setInstructionSet(instructionSet)) {
+                continue;
+            }
+            printThroughput("uint16 -> double", instructionSet, measureThroughput([&]() {
+                DepthConversion::toMeters(depth.data(), meters.data(), nrElements, DEPTH_UNITS);
+            }, toMetersBytes, nrIterations));
+            printThroughput("double -> uint16", instructionSet, measureThroughput([&]() {
+                DepthConversion::toDepthUnits(meters.data(), depthResult.data(), nrElements, DEPTH_UNITS);
+            }, toMetersBytes, nrIterations));
+            if (depthResult != depth) {
+                throw runtime_error("The " + instructionSet + " conversion did not restore the depth values");
+            }
+            printThroughput("uint16 -> float", instructionSet, measureThroughput([&]() {
+                DepthConversion::toMeters(depth.data(), metersFloat.data(), nrElements, DEPTH_UNITS);
+            }, toMetersFloatBytes, nrIterations));
+            printThroughput("float -> uint16", instructionSet, measureThroughput([&]() {
+                DepthConversion::toDepthUnits(metersFloat.data(), depthResult.data(), nrElements, DEPTH_UNITS);
+            }, toMetersFloatBytes, nrIterations));
+            printThroughput("uint16 rescale", instructionSet, measureThroughput([&]() {
+                DepthConversion::rescale(depth.data(), depthResult.data(), nrElements, 0.5f);
+            }, rescaleBytes, nrIterations));
+        }
+    } catch (exception &ex) {
+        cout << "Caught exception while benchmarking the depth conversions: " << ex.what() << endl;
+        return 1;
+    }
+
+    return 0;
+}
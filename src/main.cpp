@@ -3,7 +3,9 @@
 //
 
 #include <AndreiUtils/utilsJson.h>
+#include <atomic>
 #include <configDirectoryLocation.h>
+#include <csignal>
 #include <iostream>
 #include <RealsenseRecording/RealsenseCapture.h>
 #include <RealsenseRecording/utils.h>
@@ -13,6 +15,15 @@ using namespace AndreiUtils;
 using namespace RealsenseRecording;
 using namespace std;
 
+atomic<RealsenseCapture *> runningCapture(nullptr);
+
+void stopCapture(int) {
+    RealsenseCapture *capture = runningCapture.load();
+    if (capture != nullptr) {
+        capture->stop();
+    }
+}
+
 int main() {
     cout << "Hello World!" << endl;
     setConfigDirectoryLocation("../config/");
@@ -54,23 +65,83 @@ int main() {
     if (config.contains("recordParametersFormat") && !config["recordParametersFormat"].get<string>().empty()) {
         recordParametersFormat = config["recordParametersFormat"].get<string>();
     }
-    bool withOpenCV = true, withFrameAlignment = true, writeFPSOnImage = true;
+    bool withOpenCV = true, withFrameAlignment = true, writeFPSOnImage = true, withRawDepth = false;
     if (config.contains("withOpenCV")) {
         withOpenCV = config["withOpenCV"].get<bool>();
     }
     if (config.contains("withFrameAlignment")) {
         withFrameAlignment = config["withFrameAlignment"].get<bool>();
     }
+    // registers the depth with a precomputed lookup table instead of rs2::align
+    bool alignWithRegistration = false;
+    if (config.contains("alignWithRegistration")) {
+        alignWithRegistration = config["alignWithRegistration"].get<bool>();
+    }
     if (config.contains("writeFPSOnImage")) {
         writeFPSOnImage = config["writeFPSOnImage"].get<bool>();
     }
+    if (config.contains("withRawDepth")) {
+        withRawDepth = config["withRawDepth"].get<bool>();
+    }
+    int replayPrefetchSize = 0;
+    if (config.contains("replayPrefetchSize")) {
+        replayPrefetchSize = config["replayPrefetchSize"].get<int>();
+    }
+    string statsFile;
+    if (config.contains("statsFile")) {
+        statsFile = config["statsFile"].get<string>();
+    }
+    double statsDumpPeriod = 10;
+    if (config.contains("statsDumpPeriod")) {
+        statsDumpPeriod = config["statsDumpPeriod"].get<double>();
+    }
+    bool headless = false;
+    if (config.contains("headless")) {
+        headless = config["headless"].get<bool>();
+    }
+    double displayFps = 30;
+    if (config.contains("displayFps")) {
+        displayFps = config["displayFps"].get<double>();
+    }
+    int nrProcessingThreads = 0;
+    if (config.contains("nrProcessingThreads")) {
+        nrProcessingThreads = config["nrProcessingThreads"].get<int>();
+    }
+    // "double" or "float"
+    string depthElementType = "double";
+    if (config.contains("depthElementType")) {
+        depthElementType = config["depthElementType"].get<string>();
+    }
+    // "rgb8" or "yuyv": the latter records the camera's YUYV (only with the "bin" image format)
+    string colorPixelFormat = "rgb8";
+    if (config.contains("colorPixelFormat")) {
+        colorPixelFormat = config["colorPixelFormat"].get<string>();
+    }
 
     try {
         RealsenseCapture capture(fps, withRecord, recordedFileNumber, bagFile, colorWidth, colorHeight, depthWidth,
                                  depthHeight, recordImageFormat, recordDepthFormat, recordParametersFormat,
-                                 withOpenCV, withFrameAlignment, writeFPSOnImage);
+                                 withOpenCV, withFrameAlignment, writeFPSOnImage, withRawDepth, replayPrefetchSize,
+                                 imagePixelFormatFromString(colorPixelFormat));
+        if (!statsFile.empty()) {
+            capture.setStatsDump(statsFile, statsDumpPeriod);
+        }
+        capture.setHeadless(headless);
+        capture.setDisplayFps(displayFps);
+        capture.setNrProcessingThreads(nrProcessingThreads);
+        capture.setDepthElementType(depthElementTypeFromString(depthElementType));
+        capture.setAlignWithRegistration(alignWithRegistration);
+        // Ctrl+C (or a kill) ends the capture loop, so that the recording is closed properly
+        runningCapture = &capture;
+        signal(SIGINT, stopCapture);
+        signal(SIGTERM, stopCapture);
+        if (headless) {
+            cout << "Running headless; terminate with Ctrl+C" << endl;
+        }
         capture.run();
+        runningCapture = nullptr;
     } catch (exception &ex) {
+        runningCapture = nullptr;
         #ifdef OPENCV
         cv::destroyAllWindows();
         #endif
@@ -0,0 +1,27 @@
+#include <iostream>
+#include <RealsenseRecording/recording/ReadRecording.h>
+#include <RealsenseRecording/utils.h>
+#include <stdexcept>
+#include <string>
+
+using namespace RealsenseRecording;
+using namespace std;
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        cout << "Usage: " << argv[0] << " <recordedFileNumber>..." << endl;
+        return 1;
+    }
+    setConfigDirectoryLocation("../config/");
+
+    try {
+        for (int i = 1; i < argc; i++) {
+            ReadRecording::rebuildIndex(stoi(argv[i]));
+        }
+    } catch (exception &ex) {
+        cout << "Caught exception while rebuilding the recording index: " << ex.what() << endl;
+        return 1;
+    }
+
+    return 0;
+}
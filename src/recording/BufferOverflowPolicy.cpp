@@ -0,0 +1,29 @@
+#include <RealsenseRecording/recording/BufferOverflowPolicy.h>
+#include <stdexcept>
+
+using namespace RealsenseRecording;
+using namespace std;
+
+BufferOverflowPolicy RealsenseRecording::bufferOverflowPolicyFromString(const string &policy) {
+    if (policy == "block") {
+        return BLOCK_WHEN_FULL;
+    } else if (policy == "dropNewest") {
+        return DROP_NEWEST;
+    } else if (policy == "dropOldest") {
+        return DROP_OLDEST;
+    }
+    throw runtime_error("Unknown buffer overflow policy: \"" + policy +
+                        R"(". Accepted are "block", "dropNewest" and "dropOldest")");
+}
+
+string RealsenseRecording::bufferOverflowPolicyToString(BufferOverflowPolicy policy) {
+    switch (policy) {
+        case BLOCK_WHEN_FULL:
+            return "block";
+        case DROP_NEWEST:
+            return "dropNewest";
+        case DROP_OLDEST:
+            return "dropOldest";
+    }
+    throw runtime_error("Unknown buffer overflow policy: " + to_string((int) policy));
+}
@@ -0,0 +1,156 @@
+#include <RealsenseRecording/recording/ColorConversion.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define COLOR_CONVERSION_X86
+
+#include <immintrin.h>
+
+#endif
+
+using namespace RealsenseRecording;
+using namespace std;
+
+namespace {
+    struct ColorConversionKernels {
+        const char *instructionSet;
+        void (*yuyvToRgb)(const uint8_t *, uint8_t *, size_t);
+        void (*yuyvToBgr)(const uint8_t *, uint8_t *, size_t);
+    };
+
+    inline uint8_t saturateColor(int value) {
+        return (uint8_t) ((value < 0) ? 0 : ((value > 255) ? 255 : value));
+    }
+
+    // the integer BT.601 (limited range) conversion of librealsense's YUY2 unpacking; the vectorized kernels compute
+    // the same sums
+    template<bool BGR>
+    void yuyvToColorScalar(const uint8_t *yuyv, uint8_t *color, size_t nrPixels) {
+        for (size_t i = 0; i + 1 < nrPixels; i += 2, yuyv += 4) {
+            int d = yuyv[1] - 128, e = yuyv[3] - 128;
+            int red = 409 * e + 128, green = -100 * d - 208 * e + 128, blue = 516 * d + 128;
+            for (int j = 0; j < 2; j++, color += 3) {
+                int luma = 298 * (yuyv[2 * j] - 16);
+                color[BGR ? 2 : 0] = saturateColor((luma + red) >> 8);
+                color[1] = saturateColor((luma + green) >> 8);
+                color[BGR ? 0 : 2] = saturateColor((luma + blue) >> 8);
+            }
+        }
+    }
+
+    const ColorConversionKernels scalarKernels = {"scalar", yuyvToColorScalar<false>, yuyvToColorScalar<true>};
+
+    #ifdef COLOR_CONVERSION_X86
+
+    // the channels of 8 pixels (4 pairs sharing their U and V) as int16, not yet saturated to bytes
+    __attribute__((target("ssse3")))
+    inline void yuyvToChannelsSSSE3(__m128i yuyv, __m128i &red, __m128i &green, __m128i &blue) {
+        const __m128i lowBytes = _mm_set1_epi16(0x00FF);
+        // 298 * (Y - 16) + 128 for the pixels 0-3 and 4-7, from the pairs (Y - 16, 1)
+        __m128i luma = _mm_sub_epi16(_mm_and_si128(yuyv, lowBytes), _mm_set1_epi16(16));
+        const __m128i lumaFactors = _mm_setr_epi16(298, 128, 298, 128, 298, 128, 298, 128);
+        __m128i lumaLow = _mm_madd_epi16(_mm_unpacklo_epi16(luma, _mm_set1_epi16(1)), lumaFactors);
+        __m128i lumaHigh = _mm_madd_epi16(_mm_unpackhi_epi16(luma, _mm_set1_epi16(1)), lumaFactors);
+        // (U - 128, V - 128) of the 4 pixel pairs, weighted per channel, for both pixels of each pair
+        __m128i chroma = _mm_sub_epi16(_mm_srli_epi16(yuyv, 8), _mm_set1_epi16(128));
+        __m128i redChroma = _mm_madd_epi16(chroma, _mm_setr_epi16(0, 409, 0, 409, 0, 409, 0, 409));
+        __m128i greenChroma = _mm_madd_epi16(chroma, _mm_setr_epi16(-100, -208, -100, -208, -100, -208, -100, -208));
+        __m128i blueChroma = _mm_madd_epi16(chroma, _mm_setr_epi16(516, 0, 516, 0, 516, 0, 516, 0));
+        red = _mm_packs_epi32(_mm_srai_epi32(_mm_add_epi32(lumaLow, _mm_unpacklo_epi32(redChroma, redChroma)), 8),
+                              _mm_srai_epi32(_mm_add_epi32(lumaHigh, _mm_unpackhi_epi32(redChroma, redChroma)), 8));
+        green = _mm_packs_epi32(
+                _mm_srai_epi32(_mm_add_epi32(lumaLow, _mm_unpacklo_epi32(greenChroma, greenChroma)), 8),
+                _mm_srai_epi32(_mm_add_epi32(lumaHigh, _mm_unpackhi_epi32(greenChroma, greenChroma)), 8));
+        blue = _mm_packs_epi32(_mm_srai_epi32(_mm_add_epi32(lumaLow, _mm_unpacklo_epi32(blueChroma, blueChroma)), 8),
+                               _mm_srai_epi32(_mm_add_epi32(lumaHigh, _mm_unpackhi_epi32(blueChroma, blueChroma)), 8));
+    }
+
+    // interleaves 16 bytes of each channel into 48 bytes: every output vector takes its bytes from all 3 channels
+    __attribute__((target("ssse3")))
+    inline void storeInterleavedSSSE3(uint8_t *color, __m128i first, __m128i second, __m128i third) {
+        const __m128i firstMasks[3] = {
+                _mm_setr_epi8(0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1, -1, 5),
+                _mm_setr_epi8(-1, -1, 6, -1, -1, 7, -1, -1, 8, -1, -1, 9, -1, -1, 10, -1),
+                _mm_setr_epi8(-1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15, -1, -1)};
+        const __m128i secondMasks[3] = {
+                _mm_setr_epi8(-1, 0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1, -1),
+                _mm_setr_epi8(5, -1, -1, 6, -1, -1, 7, -1, -1, 8, -1, -1, 9, -1, -1, 10),
+                _mm_setr_epi8(-1, -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15, -1)};
+        const __m128i thirdMasks[3] = {
+                _mm_setr_epi8(-1, -1, 0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1),
+                _mm_setr_epi8(-1, 5, -1, -1, 6, -1, -1, 7, -1, -1, 8, -1, -1, 9, -1, -1),
+                _mm_setr_epi8(10, -1, -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15)};
+        for (int i = 0; i < 3; i++) {
+            __m128i interleaved = _mm_or_si128(_mm_shuffle_epi8(first, firstMasks[i]),
+                                               _mm_or_si128(_mm_shuffle_epi8(second, secondMasks[i]),
+                                                            _mm_shuffle_epi8(third, thirdMasks[i])));
+            _mm_storeu_si128((__m128i *) (color + 16 * i), interleaved);
+        }
+    }
+
+    template<bool BGR>
+    __attribute__((target("ssse3")))
+    void yuyvToColorSSSE3(const uint8_t *yuyv, uint8_t *color, size_t nrPixels) {
+        size_t i = 0;
+        for (; i + 16 <= nrPixels; i += 16) {
+            __m128i red[2], green[2], blue[2];
+            for (int half = 0; half < 2; half++) {
+                __m128i pixels = _mm_loadu_si128((const __m128i *) (yuyv + 2 * i + 16 * half));
+                yuyvToChannelsSSSE3(pixels, red[half], green[half], blue[half]);
+            }
+            __m128i red8 = _mm_packus_epi16(red[0], red[1]), green8 = _mm_packus_epi16(green[0], green[1]);
+            __m128i blue8 = _mm_packus_epi16(blue[0], blue[1]);
+            if (BGR) {
+                storeInterleavedSSSE3(color + 3 * i, blue8, green8, red8);
+            } else {
+                storeInterleavedSSSE3(color + 3 * i, red8, green8, blue8);
+            }
+        }
+        yuyvToColorScalar<BGR>(yuyv + 2 * i, color + 3 * i, nrPixels - i);
+    }
+
+    const ColorConversionKernels ssse3Kernels = {"ssse3", yuyvToColorSSSE3<false>, yuyvToColorSSSE3<true>};
+
+    #endif
+
+    const ColorConversionKernels *getSupportedKernels(const string &instructionSet) {
+        if (instructionSet == "scalar") {
+            return &scalarKernels;
+        }
+        #ifdef COLOR_CONVERSION_X86
+        __builtin_cpu_init();
+        if (instructionSet == "ssse3" && __builtin_cpu_supports("ssse3")) {
+            return &ssse3Kernels;
+        }
+        #endif
+        return nullptr;
+    }
+
+    const ColorConversionKernels *&getKernels() {
+        static const ColorConversionKernels *kernels = []() {
+            const ColorConversionKernels *supportedKernels = getSupportedKernels("ssse3");
+            return (supportedKernels != nullptr) ? supportedKernels : &scalarKernels;
+        }();
+        return kernels;
+    }
+}
+
+void ColorConversion::yuyvToRgb(const uint8_t *yuyv, uint8_t *rgb, size_t nrPixels) {
+    getKernels()->yuyvToRgb(yuyv, rgb, nrPixels);
+}
+
+void ColorConversion::yuyvToBgr(const uint8_t *yuyv, uint8_t *bgr, size_t nrPixels) {
+    getKernels()->yuyvToBgr(yuyv, bgr, nrPixels);
+}
+
+string ColorConversion::getInstructionSet() {
+    return getKernels()->instructionSet;
+}
+
+bool ColorConversion::setInstructionSet(const string &instructionSet) {
+    const ColorConversionKernels *supportedKernels = getSupportedKernels(instructionSet);
+    if (supportedKernels == nullptr) {
+        return false;
+    }
+    getKernels() = supportedKernels;
+    return true;
+}
@@ -0,0 +1,284 @@
+#include <RealsenseRecording/recording/DepthCodec.h>
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+using namespace RealsenseRecording;
+using namespace std;
+
+namespace {
+    class NibbleWriter {
+    public:
+        explicit NibbleWriter(vector<uint8_t> &out) : out(out), byte(0), halfByte(false) {}
+
+        // 3 bits per nibble, the highest nibble bit marks that more nibbles follow
+        void writeVLE(uint32_t value) {
+            do {
+                auto nibble = (uint8_t) (value & 0x7u);
+                value >>= 3;
+                if (value != 0) {
+                    nibble |= 0x8u;
+                }
+                this->write(nibble);
+            } while (value != 0);
+        }
+
+        void flush() {
+            if (this->halfByte) {
+                this->out.push_back(this->byte);
+                this->halfByte = false;
+            }
+        }
+
+    private:
+        void write(uint8_t nibble) {
+            if (!this->halfByte) {
+                this->byte = (uint8_t) (nibble << 4);
+                this->halfByte = true;
+            } else {
+                this->out.push_back((uint8_t) (this->byte | nibble));
+                this->halfByte = false;
+            }
+        }
+
+        vector<uint8_t> &out;
+        uint8_t byte;
+        bool halfByte;
+    };
+
+    class NibbleReader {
+    public:
+        NibbleReader(const uint8_t *data, size_t size) : data(data), size(size), position(0), halfByte(false) {}
+
+        bool readVLE(uint32_t &value) {
+            value = 0;
+            uint8_t nibble;
+            for (int shift = 0; shift < 32; shift += 3) {
+                if (!this->read(nibble)) {
+                    return false;
+                }
+                value |= (uint32_t) (nibble & 0x7u) << shift;
+                if ((nibble & 0x8u) == 0) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+    private:
+        bool read(uint8_t &nibble) {
+            if (this->position >= this->size) {
+                return false;
+            }
+            if (!this->halfByte) {
+                nibble = (uint8_t) (this->data[this->position] >> 4);
+                this->halfByte = true;
+            } else {
+                nibble = (uint8_t) (this->data[this->position++] & 0xFu);
+                this->halfByte = false;
+            }
+            return true;
+        }
+
+        const uint8_t *data;
+        size_t size, position;
+        bool halfByte;
+    };
+}
+
+DepthCodec::DepthCodec(int nrChunks) : nrChunks(1), nrEncodedChunks(0), chunkBuffers(), chunkSizes(), nrRawBytes(0),
+                                       nrEncodedBytes(0) {
+    this->setNrChunks(nrChunks);
+}
+
+DepthCodec::~DepthCodec() = default;
+
+void DepthCodec::setNrChunks(int _nrChunks) {
+    if (_nrChunks < 1) {
+        throw runtime_error("Can not encode depth in < 1 chunks! Was " + to_string(_nrChunks));
+    }
+    this->nrChunks = _nrChunks;
+}
+
+int DepthCodec::getNrChunks() const {
+    return this->nrChunks;
+}
+
+void DepthCodec::encode(const uint16_t *depth, int height, int width, ostream *out) {
+    this->encodeToBuffers(depth, height, width);
+    auto header = {(uint32_t) height, (uint32_t) width, (uint32_t) this->nrEncodedChunks};
+    for (uint32_t value: header) {
+        out->write((const char *) &value, sizeof(value));
+    }
+    out->write((const char *) this->chunkSizes.data(), (streamsize) (this->nrEncodedChunks * sizeof(uint32_t)));
+    for (int chunk = 0; chunk < this->nrEncodedChunks; chunk++) {
+        out->write((const char *) this->chunkBuffers[chunk].data(), this->chunkSizes[chunk]);
+    }
+}
+
+bool DepthCodec::decode(istream *in, uint16_t *depth, int height, int width) {
+    uint32_t header[3];
+    in->read((char *) header, sizeof(header));
+    if (!*in) {
+        return false;
+    }
+    if ((int) header[0] != height || (int) header[1] != width) {
+        throw runtime_error("The rvl depth frame of size " + to_string(header[0]) + "x" + to_string(header[1]) +
+                            " does not have the expected size " + to_string(height) + "x" + to_string(width));
+    }
+    int nrFrameChunks = (int) header[2];
+    if (nrFrameChunks < 1 || nrFrameChunks > height) {
+        throw runtime_error("Corrupted rvl depth frame: " + to_string(nrFrameChunks) + " chunks");
+    }
+    this->chunkSizes.resize(nrFrameChunks);
+    in->read((char *) this->chunkSizes.data(), (streamsize) (nrFrameChunks * sizeof(uint32_t)));
+    if (!*in) {
+        return false;
+    }
+    if ((int) this->chunkBuffers.size() < nrFrameChunks) {
+        this->chunkBuffers.resize(nrFrameChunks);
+    }
+    for (int chunk = 0; chunk < nrFrameChunks; chunk++) {
+        size_t nrChunkPixels = (size_t) width * (DepthCodec::getChunkFirstRow(chunk + 1, nrFrameChunks, height) -
+                                                 DepthCodec::getChunkFirstRow(chunk, nrFrameChunks, height));
+        // a valid chunk is never larger than the worst case of encodeChunk, so the buffers are allocated once
+        if (this->chunkSizes[chunk] > DepthCodec::getMaxChunkSize(nrChunkPixels)) {
+            throw runtime_error("Corrupted rvl depth frame: chunk " + to_string(chunk) + " has " +
+                                to_string(this->chunkSizes[chunk]) + " bytes");
+        }
+        this->chunkBuffers[chunk].reserve(DepthCodec::getMaxChunkSize(nrChunkPixels));
+        this->chunkBuffers[chunk].resize(this->chunkSizes[chunk]);
+        in->read((char *) this->chunkBuffers[chunk].data(), this->chunkSizes[chunk]);
+    }
+    if (!*in) {
+        return false;
+    }
+
+    bool decodeSuccess = true;
+    #pragma omp parallel for shared(depth, height, width, nrFrameChunks) reduction(&&:decodeSuccess) default(none)
+    for (int chunk = 0; chunk < nrFrameChunks; chunk++) {
+        int firstRow = DepthCodec::getChunkFirstRow(chunk, nrFrameChunks, height);
+        int nrRows = DepthCodec::getChunkFirstRow(chunk + 1, nrFrameChunks, height) - firstRow;
+        decodeSuccess = DepthCodec::decodeChunk(this->chunkBuffers[chunk].data(), this->chunkSizes[chunk],
+                                                depth + (size_t) firstRow * width, (size_t) nrRows * width) &&
+                        decodeSuccess;
+    }
+    if (!decodeSuccess) {
+        throw runtime_error("Corrupted rvl depth frame: could not decode all of its chunks");
+    }
+    return true;
+}
+
+size_t DepthCodec::encodeToBuffers(const uint16_t *depth, int height, int width) {
+    this->nrEncodedChunks = min(this->nrChunks, max(height, 1));
+    if ((int) this->chunkBuffers.size() < this->nrEncodedChunks) {
+        this->chunkBuffers.resize(this->nrEncodedChunks);
+    }
+    this->chunkSizes.resize(this->nrEncodedChunks);
+
+    int nrFrameChunks = this->nrEncodedChunks;
+    #pragma omp parallel for shared(depth, height, width, nrFrameChunks) default(none)
+    for (int chunk = 0; chunk < nrFrameChunks; chunk++) {
+        int firstRow = DepthCodec::getChunkFirstRow(chunk, nrFrameChunks, height);
+        int nrRows = DepthCodec::getChunkFirstRow(chunk + 1, nrFrameChunks, height) - firstRow;
+        this->chunkSizes[chunk] = (uint32_t) DepthCodec::encodeChunk(depth + (size_t) firstRow * width,
+                                                                     (size_t) nrRows * width,
+                                                                     this->chunkBuffers[chunk]);
+    }
+
+    size_t encodedSize = (3 + nrFrameChunks) * sizeof(uint32_t);
+    for (int chunk = 0; chunk < nrFrameChunks; chunk++) {
+        encodedSize += this->chunkSizes[chunk];
+    }
+    this->nrRawBytes += (unsigned long long) height * width * sizeof(uint16_t);
+    this->nrEncodedBytes += encodedSize;
+    return encodedSize;
+}
+
+int DepthCodec::getNrEncodedChunks() const {
+    return this->nrEncodedChunks;
+}
+
+const vector<uint8_t> &DepthCodec::getChunkBuffer(int chunk) const {
+    return this->chunkBuffers.at(chunk);
+}
+
+unsigned long long DepthCodec::getNrRawBytes() const {
+    return this->nrRawBytes;
+}
+
+unsigned long long DepthCodec::getNrEncodedBytes() const {
+    return this->nrEncodedBytes;
+}
+
+double DepthCodec::getCompressionRatio() const {
+    if (this->nrEncodedBytes == 0) {
+        return 0;
+    }
+    return (double) this->nrRawBytes / (double) this->nrEncodedBytes;
+}
+
+size_t DepthCodec::encodeChunk(const uint16_t *depth, size_t nrPixels, vector<uint8_t> &out) {
+    out.clear();
+    // reserving the worst case once keeps the buffer allocation-free for the following frames
+    out.reserve(DepthCodec::getMaxChunkSize(nrPixels));
+    NibbleWriter writer(out);
+    int previous = 0;
+    size_t i = 0;
+    while (i < nrPixels) {
+        size_t zerosStart = i;
+        while (i < nrPixels && depth[i] == 0) {
+            i++;
+        }
+        writer.writeVLE((uint32_t) (i - zerosStart));
+
+        size_t nonZerosStart = i;
+        while (i < nrPixels && depth[i] != 0) {
+            i++;
+        }
+        writer.writeVLE((uint32_t) (i - nonZerosStart));
+        for (size_t j = nonZerosStart; j < i; j++) {
+            int delta = (int) depth[j] - previous;
+            writer.writeVLE(((uint32_t) delta << 1) ^ (uint32_t) (delta >> 31));
+            previous = depth[j];
+        }
+    }
+    writer.flush();
+    return out.size();
+}
+
+bool DepthCodec::decodeChunk(const uint8_t *data, size_t size, uint16_t *depth, size_t nrPixels) {
+    NibbleReader reader(data, size);
+    int previous = 0;
+    size_t i = 0;
+    uint32_t nrZeros, nrNonZeros, positive;
+    while (i < nrPixels) {
+        if (!reader.readVLE(nrZeros) || nrZeros > nrPixels - i) {
+            return false;
+        }
+        fill(depth + i, depth + i + nrZeros, (uint16_t) 0);
+        i += nrZeros;
+
+        if (!reader.readVLE(nrNonZeros) || nrNonZeros > nrPixels - i) {
+            return false;
+        }
+        for (uint32_t j = 0; j < nrNonZeros; j++) {
+            if (!reader.readVLE(positive)) {
+                return false;
+            }
+            previous += (int) (positive >> 1) ^ -(int) (positive & 1u);
+            depth[i++] = (uint16_t) previous;
+        }
+    }
+    return true;
+}
+
+int DepthCodec::getChunkFirstRow(int chunk, int nrChunks, int height) {
+    return (int) ((long long) chunk * height / nrChunks);
+}
+
+size_t DepthCodec::getMaxChunkSize(size_t nrPixels) {
+    // a zigzag encoded delta of up to 17 bits takes 6 nibbles and a run length at most one nibble per pixel of the
+    // run: at most 7 nibbles per pixel, plus the length nibbles of the empty first and last runs
+    return (nrPixels * 7 + 16) / 2 + 16;
+}
@@ -0,0 +1,377 @@
+#include <RealsenseRecording/recording/DepthConversion.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define DEPTH_CONVERSION_X86
+
+#include <immintrin.h>
+
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define DEPTH_CONVERSION_NEON
+
+#include <arm_neon.h>
+
+#endif
+
+using namespace RealsenseRecording;
+using namespace std;
+
+namespace {
+    struct DepthConversionKernels {
+        const char *instructionSet;
+        void (*toMetersDouble)(const uint16_t *, double *, size_t, double);
+        void (*toMetersFloat)(const uint16_t *, float *, size_t, float);
+        void (*toDepthUnitsDouble)(const double *, uint16_t *, size_t, double);
+        void (*toDepthUnitsFloat)(const float *, uint16_t *, size_t, float);
+        void (*rescale)(const uint16_t *, uint16_t *, size_t, float);
+    };
+
+    // value is the rounded (+ 0.5) depth
+    template<class T>
+    inline uint16_t saturateDepth(T value) {
+        if (!(value > 0)) {
+            return 0;
+        }
+        return (value >= 65535) ? (uint16_t) 65535 : (uint16_t) value;
+    }
+
+    // the vectorized kernels convert the remaining (< vector width) elements with these
+    void toMetersDoubleScalar(const uint16_t *depth, double *meters, size_t nrElements, double depthUnits) {
+        for (size_t i = 0; i < nrElements; i++) {
+            meters[i] = depth[i] * depthUnits;
+        }
+    }
+
+    void toMetersFloatScalar(const uint16_t *depth, float *meters, size_t nrElements, float depthUnits) {
+        for (size_t i = 0; i < nrElements; i++) {
+            meters[i] = depth[i] * depthUnits;
+        }
+    }
+
+    void toDepthUnitsDoubleScalar(const double *meters, uint16_t *depth, size_t nrElements, double unitsPerMeter) {
+        for (size_t i = 0; i < nrElements; i++) {
+            depth[i] = saturateDepth(meters[i] * unitsPerMeter + 0.5);
+        }
+    }
+
+    void toDepthUnitsFloatScalar(const float *meters, uint16_t *depth, size_t nrElements, float unitsPerMeter) {
+        for (size_t i = 0; i < nrElements; i++) {
+            depth[i] = saturateDepth(meters[i] * unitsPerMeter + 0.5f);
+        }
+    }
+
+    void rescaleScalar(const uint16_t *depth, uint16_t *rescaled, size_t nrElements, float scale) {
+        for (size_t i = 0; i < nrElements; i++) {
+            rescaled[i] = saturateDepth(depth[i] * scale + 0.5f);
+        }
+    }
+
+    const DepthConversionKernels scalarKernels = {"scalar", toMetersDoubleScalar, toMetersFloatScalar,
+                                                  toDepthUnitsDoubleScalar, toDepthUnitsFloatScalar, rescaleScalar};
+
+    #ifdef DEPTH_CONVERSION_X86
+
+    // max(x, 0) is 0 for NaN, because maxps/maxpd return the second operand when one of them is NaN
+    __attribute__((target("sse4.1")))
+    void toMetersDoubleSSE41(const uint16_t *depth, double *meters, size_t nrElements, double depthUnits) {
+        __m128d units = _mm_set1_pd(depthUnits);
+        size_t i = 0;
+        for (; i + 8 <= nrElements; i += 8) {
+            __m128i values = _mm_loadu_si128((const __m128i *) (depth + i));
+            __m128i low = _mm_cvtepu16_epi32(values), high = _mm_unpackhi_epi16(values, _mm_setzero_si128());
+            _mm_storeu_pd(meters + i, _mm_mul_pd(_mm_cvtepi32_pd(low), units));
+            _mm_storeu_pd(meters + i + 2, _mm_mul_pd(_mm_cvtepi32_pd(_mm_unpackhi_epi64(low, low)), units));
+            _mm_storeu_pd(meters + i + 4, _mm_mul_pd(_mm_cvtepi32_pd(high), units));
+            _mm_storeu_pd(meters + i + 6, _mm_mul_pd(_mm_cvtepi32_pd(_mm_unpackhi_epi64(high, high)), units));
+        }
+        toMetersDoubleScalar(depth + i, meters + i, nrElements - i, depthUnits);
+    }
+
+    __attribute__((target("sse4.1")))
+    void toMetersFloatSSE41(const uint16_t *depth, float *meters, size_t nrElements, float depthUnits) {
+        __m128 units = _mm_set1_ps(depthUnits);
+        size_t i = 0;
+        for (; i + 8 <= nrElements; i += 8) {
+            __m128i values = _mm_loadu_si128((const __m128i *) (depth + i));
+            __m128i low = _mm_cvtepu16_epi32(values), high = _mm_unpackhi_epi16(values, _mm_setzero_si128());
+            _mm_storeu_ps(meters + i, _mm_mul_ps(_mm_cvtepi32_ps(low), units));
+            _mm_storeu_ps(meters + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(high), units));
+        }
+        toMetersFloatScalar(depth + i, meters + i, nrElements - i, depthUnits);
+    }
+
+    __attribute__((target("sse4.1")))
+    inline __m128i roundDepthSSE41(__m128d values, __m128d scale) {
+        values = _mm_add_pd(_mm_mul_pd(values, scale), _mm_set1_pd(0.5));
+        values = _mm_min_pd(_mm_max_pd(values, _mm_setzero_pd()), _mm_set1_pd(65535));
+        return _mm_cvttpd_epi32(values);
+    }
+
+    __attribute__((target("sse4.1")))
+    void toDepthUnitsDoubleSSE41(const double *meters, uint16_t *depth, size_t nrElements, double unitsPerMeter) {
+        __m128d scale = _mm_set1_pd(unitsPerMeter);
+        size_t i = 0;
+        for (; i + 8 <= nrElements; i += 8) {
+            __m128i low = _mm_unpacklo_epi64(roundDepthSSE41(_mm_loadu_pd(meters + i), scale),
+                                             roundDepthSSE41(_mm_loadu_pd(meters + i + 2), scale));
+            __m128i high = _mm_unpacklo_epi64(roundDepthSSE41(_mm_loadu_pd(meters + i + 4), scale),
+                                              roundDepthSSE41(_mm_loadu_pd(meters + i + 6), scale));
+            _mm_storeu_si128((__m128i *) (depth + i), _mm_packus_epi32(low, high));
+        }
+        toDepthUnitsDoubleScalar(meters + i, depth + i, nrElements - i, unitsPerMeter);
+    }
+
+    __attribute__((target("sse4.1")))
+    inline __m128i roundDepthSSE41(__m128 values, __m128 scale) {
+        values = _mm_add_ps(_mm_mul_ps(values, scale), _mm_set1_ps(0.5f));
+        values = _mm_min_ps(_mm_max_ps(values, _mm_setzero_ps()), _mm_set1_ps(65535));
+        return _mm_cvttps_epi32(values);
+    }
+
+    __attribute__((target("sse4.1")))
+    void toDepthUnitsFloatSSE41(const float *meters, uint16_t *depth, size_t nrElements, float unitsPerMeter) {
+        __m128 scale = _mm_set1_ps(unitsPerMeter);
+        size_t i = 0;
+        for (; i + 8 <= nrElements; i += 8) {
+            __m128i low = roundDepthSSE41(_mm_loadu_ps(meters + i), scale);
+            __m128i high = roundDepthSSE41(_mm_loadu_ps(meters + i + 4), scale);
+            _mm_storeu_si128((__m128i *) (depth + i), _mm_packus_epi32(low, high));
+        }
+        toDepthUnitsFloatScalar(meters + i, depth + i, nrElements - i, unitsPerMeter);
+    }
+
+    __attribute__((target("sse4.1")))
+    void rescaleSSE41(const uint16_t *depth, uint16_t *rescaled, size_t nrElements, float scale) {
+        __m128 scaleVector = _mm_set1_ps(scale);
+        size_t i = 0;
+        for (; i + 8 <= nrElements; i += 8) {
+            __m128i values = _mm_loadu_si128((const __m128i *) (depth + i));
+            __m128i low = _mm_cvtepu16_epi32(values), high = _mm_unpackhi_epi16(values, _mm_setzero_si128());
+            low = roundDepthSSE41(_mm_cvtepi32_ps(low), scaleVector);
+            high = roundDepthSSE41(_mm_cvtepi32_ps(high), scaleVector);
+            _mm_storeu_si128((__m128i *) (rescaled + i), _mm_packus_epi32(low, high));
+        }
+        rescaleScalar(depth + i, rescaled + i, nrElements - i, scale);
+    }
+
+    const DepthConversionKernels sse41Kernels = {"sse4.1", toMetersDoubleSSE41, toMetersFloatSSE41,
+                                                 toDepthUnitsDoubleSSE41, toDepthUnitsFloatSSE41, rescaleSSE41};
+
+    __attribute__((target("avx2")))
+    void toMetersDoubleAVX2(const uint16_t *depth, double *meters, size_t nrElements, double depthUnits) {
+        __m256d units = _mm256_set1_pd(depthUnits);
+        size_t i = 0;
+        for (; i + 8 <= nrElements; i += 8) {
+            __m256i values = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *) (depth + i)));
+            __m256d low = _mm256_cvtepi32_pd(_mm256_castsi256_si128(values));
+            __m256d high = _mm256_cvtepi32_pd(_mm256_extracti128_si256(values, 1));
+            _mm256_storeu_pd(meters + i, _mm256_mul_pd(low, units));
+            _mm256_storeu_pd(meters + i + 4, _mm256_mul_pd(high, units));
+        }
+        toMetersDoubleScalar(depth + i, meters + i, nrElements - i, depthUnits);
+    }
+
+    __attribute__((target("avx2")))
+    void toMetersFloatAVX2(const uint16_t *depth, float *meters, size_t nrElements, float depthUnits) {
+        __m256 units = _mm256_set1_ps(depthUnits);
+        size_t i = 0;
+        for (; i + 16 <= nrElements; i += 16) {
+            __m256i low = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *) (depth + i)));
+            __m256i high = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *) (depth + i + 8)));
+            _mm256_storeu_ps(meters + i, _mm256_mul_ps(_mm256_cvtepi32_ps(low), units));
+            _mm256_storeu_ps(meters + i + 8, _mm256_mul_ps(_mm256_cvtepi32_ps(high), units));
+        }
+        toMetersFloatScalar(depth + i, meters + i, nrElements - i, depthUnits);
+    }
+
+    __attribute__((target("avx2")))
+    inline __m128i roundDepthAVX2(__m256d values, __m256d scale) {
+        values = _mm256_add_pd(_mm256_mul_pd(values, scale), _mm256_set1_pd(0.5));
+        values = _mm256_min_pd(_mm256_max_pd(values, _mm256_setzero_pd()), _mm256_set1_pd(65535));
+        return _mm256_cvttpd_epi32(values);
+    }
+
+    __attribute__((target("avx2")))
+    void toDepthUnitsDoubleAVX2(const double *meters, uint16_t *depth, size_t nrElements, double unitsPerMeter) {
+        __m256d scale = _mm256_set1_pd(unitsPerMeter);
+        size_t i = 0;
+        for (; i + 8 <= nrElements; i += 8) {
+            __m128i low = roundDepthAVX2(_mm256_loadu_pd(meters + i), scale);
+            __m128i high = roundDepthAVX2(_mm256_loadu_pd(meters + i + 4), scale);
+            _mm_storeu_si128((__m128i *) (depth + i), _mm_packus_epi32(low, high));
+        }
+        toDepthUnitsDoubleScalar(meters + i, depth + i, nrElements - i, unitsPerMeter);
+    }
+
+    __attribute__((target("avx2")))
+    inline __m128i roundDepthAVX2(__m256 values, __m256 scale) {
+        values = _mm256_add_ps(_mm256_mul_ps(values, scale), _mm256_set1_ps(0.5f));
+        values = _mm256_min_ps(_mm256_max_ps(values, _mm256_setzero_ps()), _mm256_set1_ps(65535));
+        __m256i rounded = _mm256_cvttps_epi32(values);
+        return _mm_packus_epi32(_mm256_castsi256_si128(rounded), _mm256_extracti128_si256(rounded, 1));
+    }
+
+    __attribute__((target("avx2")))
+    void toDepthUnitsFloatAVX2(const float *meters, uint16_t *depth, size_t nrElements, float unitsPerMeter) {
+        __m256 scale = _mm256_set1_ps(unitsPerMeter);
+        size_t i = 0;
+        for (; i + 8 <= nrElements; i += 8) {
+            _mm_storeu_si128((__m128i *) (depth + i), roundDepthAVX2(_mm256_loadu_ps(meters + i), scale));
+        }
+        toDepthUnitsFloatScalar(meters + i, depth + i, nrElements - i, unitsPerMeter);
+    }
+
+    __attribute__((target("avx2")))
+    void rescaleAVX2(const uint16_t *depth, uint16_t *rescaled, size_t nrElements, float scale) {
+        __m256 scaleVector = _mm256_set1_ps(scale);
+        size_t i = 0;
+        for (; i + 8 <= nrElements; i += 8) {
+            __m256i values = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *) (depth + i)));
+            _mm_storeu_si128((__m128i *) (rescaled + i), roundDepthAVX2(_mm256_cvtepi32_ps(values), scaleVector));
+        }
+        rescaleScalar(depth + i, rescaled + i, nrElements - i, scale);
+    }
+
+    const DepthConversionKernels avx2Kernels = {"avx2", toMetersDoubleAVX2, toMetersFloatAVX2, toDepthUnitsDoubleAVX2,
+                                                toDepthUnitsFloatAVX2, rescaleAVX2};
+
+    #endif
+
+    #ifdef DEPTH_CONVERSION_NEON
+
+    void toMetersDoubleNEON(const uint16_t *depth, double *meters, size_t nrElements, double depthUnits) {
+        size_t i = 0;
+        for (; i + 4 <= nrElements; i += 4) {
+            uint32x4_t values = vmovl_u16(vld1_u16(depth + i));
+            float64x2_t low = vcvtq_f64_u64(vmovl_u32(vget_low_u32(values)));
+            float64x2_t high = vcvtq_f64_u64(vmovl_u32(vget_high_u32(values)));
+            vst1q_f64(meters + i, vmulq_n_f64(low, depthUnits));
+            vst1q_f64(meters + i + 2, vmulq_n_f64(high, depthUnits));
+        }
+        toMetersDoubleScalar(depth + i, meters + i, nrElements - i, depthUnits);
+    }
+
+    void toMetersFloatNEON(const uint16_t *depth, float *meters, size_t nrElements, float depthUnits) {
+        size_t i = 0;
+        for (; i + 8 <= nrElements; i += 8) {
+            uint16x8_t values = vld1q_u16(depth + i);
+            vst1q_f32(meters + i, vmulq_n_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(values))), depthUnits));
+            vst1q_f32(meters + i + 4, vmulq_n_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(values))), depthUnits));
+        }
+        toMetersFloatScalar(depth + i, meters + i, nrElements - i, depthUnits);
+    }
+
+    // vmaxnm returns the number when one of the operands is NaN; the conversions to unsigned truncate
+    inline uint32x2_t roundDepthNEON(float64x2_t values, double scale) {
+        values = vaddq_f64(vmulq_n_f64(values, scale), vdupq_n_f64(0.5));
+        values = vminq_f64(vmaxnmq_f64(values, vdupq_n_f64(0)), vdupq_n_f64(65535));
+        return vmovn_u64(vcvtq_u64_f64(values));
+    }
+
+    void toDepthUnitsDoubleNEON(const double *meters, uint16_t *depth, size_t nrElements, double unitsPerMeter) {
+        size_t i = 0;
+        for (; i + 4 <= nrElements; i += 4) {
+            uint32x4_t values = vcombine_u32(roundDepthNEON(vld1q_f64(meters + i), unitsPerMeter),
+                                             roundDepthNEON(vld1q_f64(meters + i + 2), unitsPerMeter));
+            vst1_u16(depth + i, vmovn_u32(values));
+        }
+        toDepthUnitsDoubleScalar(meters + i, depth + i, nrElements - i, unitsPerMeter);
+    }
+
+    inline uint16x4_t roundDepthNEON(float32x4_t values, float scale) {
+        values = vaddq_f32(vmulq_n_f32(values, scale), vdupq_n_f32(0.5f));
+        values = vminq_f32(vmaxnmq_f32(values, vdupq_n_f32(0)), vdupq_n_f32(65535));
+        return vmovn_u32(vcvtq_u32_f32(values));
+    }
+
+    void toDepthUnitsFloatNEON(const float *meters, uint16_t *depth, size_t nrElements, float unitsPerMeter) {
+        size_t i = 0;
+        for (; i + 8 <= nrElements; i += 8) {
+            vst1q_u16(depth + i, vcombine_u16(roundDepthNEON(vld1q_f32(meters + i), unitsPerMeter),
+                                              roundDepthNEON(vld1q_f32(meters + i + 4), unitsPerMeter)));
+        }
+        toDepthUnitsFloatScalar(meters + i, depth + i, nrElements - i, unitsPerMeter);
+    }
+
+    void rescaleNEON(const uint16_t *depth, uint16_t *rescaled, size_t nrElements, float scale) {
+        size_t i = 0;
+        for (; i + 8 <= nrElements; i += 8) {
+            uint16x8_t values = vld1q_u16(depth + i);
+            uint16x4_t low = roundDepthNEON(vcvtq_f32_u32(vmovl_u16(vget_low_u16(values))), scale);
+            uint16x4_t high = roundDepthNEON(vcvtq_f32_u32(vmovl_u16(vget_high_u16(values))), scale);
+            vst1q_u16(rescaled + i, vcombine_u16(low, high));
+        }
+        rescaleScalar(depth + i, rescaled + i, nrElements - i, scale);
+    }
+
+    const DepthConversionKernels neonKernels = {"neon", toMetersDoubleNEON, toMetersFloatNEON, toDepthUnitsDoubleNEON,
+                                                toDepthUnitsFloatNEON, rescaleNEON};
+
+    #endif
+
+    const DepthConversionKernels *getSupportedKernels(const string &instructionSet) {
+        if (instructionSet == "scalar") {
+            return &scalarKernels;
+        }
+        #ifdef DEPTH_CONVERSION_X86
+        __builtin_cpu_init();
+        if (instructionSet == "avx2" && __builtin_cpu_supports("avx2")) {
+            return &avx2Kernels;
+        }
+        if (instructionSet == "sse4.1" && __builtin_cpu_supports("sse4.1")) {
+            return &sse41Kernels;
+        }
+        #endif
+        #ifdef DEPTH_CONVERSION_NEON
+        if (instructionSet == "neon") {
+            return &neonKernels;
+        }
+        #endif
+        return nullptr;
+    }
+
+    const DepthConversionKernels *&getKernels() {
+        static const DepthConversionKernels *kernels = []() {
+            for (const char *instructionSet: {"avx2", "sse4.1", "neon"}) {
+                const DepthConversionKernels *supportedKernels = getSupportedKernels(instructionSet);
+                if (supportedKernels != nullptr) {
+                    return supportedKernels;
+                }
+            }
+            return &scalarKernels;
+        }();
+        return kernels;
+    }
+}
+
+void DepthConversion::toMeters(const uint16_t *depth, double *meters, size_t nrElements, float depthUnits) {
+    getKernels()->toMetersDouble(depth, meters, nrElements, depthUnits);
+}
+
+void DepthConversion::toMeters(const uint16_t *depth, float *meters, size_t nrElements, float depthUnits) {
+    getKernels()->toMetersFloat(depth, meters, nrElements, depthUnits);
+}
+
+void DepthConversion::toDepthUnits(const double *meters, uint16_t *depth, size_t nrElements, float depthUnits) {
+    getKernels()->toDepthUnitsDouble(meters, depth, nrElements, 1.0 / depthUnits);
+}
+
+void DepthConversion::toDepthUnits(const float *meters, uint16_t *depth, size_t nrElements, float depthUnits) {
+    getKernels()->toDepthUnitsFloat(meters, depth, nrElements, 1.0f / depthUnits);
+}
+
+void DepthConversion::rescale(const uint16_t *depth, uint16_t *rescaled, size_t nrElements, float scale) {
+    getKernels()->rescale(depth, rescaled, nrElements, scale);
+}
+
+string DepthConversion::getInstructionSet() {
+    return getKernels()->instructionSet;
+}
+
+bool DepthConversion::setInstructionSet(const string &instructionSet) {
+    const DepthConversionKernels *supportedKernels = getSupportedKernels(instructionSet);
+    if (supportedKernels == nullptr) {
+        return false;
+    }
+    getKernels() = supportedKernels;
+    return true;
+}
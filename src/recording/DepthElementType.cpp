@@ -0,0 +1,24 @@
+#include <RealsenseRecording/recording/DepthElementType.h>
+#include <stdexcept>
+
+using namespace RealsenseRecording;
+using namespace std;
+
+DepthElementType RealsenseRecording::depthElementTypeFromString(const string &type) {
+    if (type == "double") {
+        return DEPTH_DOUBLE;
+    } else if (type == "float") {
+        return DEPTH_FLOAT;
+    }
+    throw runtime_error("Unknown depth element type: \"" + type + R"(". Accepted are "double" and "float")");
+}
+
+string RealsenseRecording::depthElementTypeToString(DepthElementType type) {
+    switch (type) {
+        case DEPTH_DOUBLE:
+            return "double";
+        case DEPTH_FLOAT:
+            return "float";
+    }
+    throw runtime_error("Unknown depth element type: " + to_string((int) type));
+}
@@ -0,0 +1,242 @@
+#include <RealsenseRecording/recording/DepthRegistration.h>
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <librealsense2/rsutil.h>
+#include <stdexcept>
+#include <string>
+
+using namespace RealsenseRecording;
+using namespace std;
+
+namespace {
+    // The models whose projection the vectorized loop computes: the forward Brown-Conrady polynomial of
+    // rs2_project_point_to_pixel, which is the plain pinhole projection without coefficients
+    bool isVectorizedProjection(const rs2_intrinsics &intrinsics) {
+        if (intrinsics.model == RS2_DISTORTION_NONE || intrinsics.model == RS2_DISTORTION_MODIFIED_BROWN_CONRADY ||
+            intrinsics.model == RS2_DISTORTION_INVERSE_BROWN_CONRADY) {
+            return true;
+        }
+        if (intrinsics.model != RS2_DISTORTION_BROWN_CONRADY) {
+            return false;
+        }
+        for (float coefficient: intrinsics.coeffs) {
+            if (coefficient != 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    struct ColorProjection {
+        float fx, fy, ppx, ppy, k1, k2, p1, p2, k3;
+    };
+
+    // the rounded color pixel (as rs2::align rounds it), limited to [-1, size] so that it fits the rectangles
+    inline int16_t toColorPixel(float pixel, int size) {
+        return (int16_t) min((float) size, max(-1.0f, pixel + 0.5f));
+    }
+
+    inline void projectToColor(const ColorProjection &c, float x, float y, float z, int16_t &pixelX, int16_t &pixelY,
+                               int colorWidth, int colorHeight) {
+        x /= z;
+        y /= z;
+        float r2 = x * x + y * y;
+        float f = 1 + c.k1 * r2 + c.k2 * r2 * r2 + c.k3 * r2 * r2 * r2;
+        x *= f;
+        y *= f;
+        pixelX = toColorPixel((x + 2 * c.p1 * x * y + c.p2 * (r2 + 2 * x * x)) * c.fx + c.ppx, colorWidth);
+        pixelY = toColorPixel((y + 2 * c.p2 * x * y + c.p1 * (r2 + 2 * y * y)) * c.fy + c.ppy, colorHeight);
+    }
+}
+
+DepthRegistration::DepthRegistration(int nrBands) : depthIntrinsics(), colorIntrinsics(), depthToColor(),
+                                                    depthUnits(), vectorizedProjection(false), cornerX(), cornerY(),
+                                                    cornerZ(), pixelRectangles(), rowRanges(), nrBands(1),
+                                                    initialized(false) {
+    this->setNrBands(nrBands);
+}
+
+void DepthRegistration::setParameters(const rs2_intrinsics &_depthIntrinsics, const rs2_intrinsics &_colorIntrinsics,
+                                      const rs2_extrinsics &_depthToColor, float _depthUnits) {
+    if (_depthIntrinsics.width <= 0 || _depthIntrinsics.height <= 0 || _colorIntrinsics.width <= 0 ||
+        _colorIntrinsics.height <= 0) {
+        throw runtime_error("Can not register the depth with empty depth or color frames!");
+    }
+    if (_colorIntrinsics.width >= SHRT_MAX || _colorIntrinsics.height >= SHRT_MAX) {
+        throw runtime_error("Can not register the depth to color frames of " + to_string(_colorIntrinsics.width) +
+                            "x" + to_string(_colorIntrinsics.height) + " pixels!");
+    }
+    this->depthIntrinsics = _depthIntrinsics;
+    this->colorIntrinsics = _colorIntrinsics;
+    this->depthToColor = _depthToColor;
+    this->depthUnits = _depthUnits;
+    this->vectorizedProjection = isVectorizedProjection(_colorIntrinsics);
+
+    int height = _depthIntrinsics.height, width = _depthIntrinsics.width;
+    size_t nrCorners = (size_t) (height + 1) * (width + 1);
+    this->cornerX.resize(nrCorners);
+    this->cornerY.resize(nrCorners);
+    this->cornerZ.resize(nrCorners);
+    const float *rotation = _depthToColor.rotation;
+    for (int v = 0; v <= height; v++) {
+        for (int u = 0; u <= width; u++) {
+            // the top left corner of the pixel (u, v) and the bottom right one of the pixel (u - 1, v - 1)
+            float corner[2] = {(float) u - 0.5f, (float) v - 0.5f}, point[3];
+            rs2_deproject_pixel_to_point(point, &this->depthIntrinsics, corner, _depthUnits);
+            size_t i = (size_t) v * (width + 1) + u;
+            // the rotation of rs2_transform_point_to_point (column major), without the translation
+            this->cornerX[i] = rotation[0] * point[0] + rotation[3] * point[1] + rotation[6] * point[2];
+            this->cornerY[i] = rotation[1] * point[0] + rotation[4] * point[1] + rotation[7] * point[2];
+            this->cornerZ[i] = rotation[2] * point[0] + rotation[5] * point[1] + rotation[8] * point[2];
+        }
+    }
+    this->pixelRectangles.resize((size_t) 4 * height * width);
+    this->rowRanges.resize((size_t) 2 * height);
+    this->initialized = true;
+}
+
+bool DepthRegistration::isInitialized() const {
+    return this->initialized;
+}
+
+void DepthRegistration::setNrBands(int _nrBands) {
+    if (_nrBands < 1) {
+        throw runtime_error("Can not register depth in < 1 bands! Was " + to_string(_nrBands));
+    }
+    this->nrBands = _nrBands;
+}
+
+int DepthRegistration::getNrBands() const {
+    return this->nrBands;
+}
+
+void DepthRegistration::registerDepth(const uint16_t *depth, uint16_t *registered) {
+    if (!this->initialized) {
+        throw runtime_error("The depth registration parameters have not been set!");
+    }
+    int depthHeight = this->depthIntrinsics.height, depthWidth = this->depthIntrinsics.width;
+    int colorHeight = this->colorIntrinsics.height, colorWidth = this->colorIntrinsics.width;
+    memset(registered, 0, (size_t) colorHeight * colorWidth * sizeof(uint16_t));
+
+    int nrDepthBands = min(this->nrBands, depthHeight);
+    #pragma omp parallel for shared(depth, depthHeight, depthWidth, nrDepthBands) default(none)
+    for (int band = 0; band < nrDepthBands; band++) {
+        int lastRow = DepthRegistration::getBandFirstRow(band + 1, nrDepthBands, depthHeight);
+        for (int row = DepthRegistration::getBandFirstRow(band, nrDepthBands, depthHeight); row < lastRow; row++) {
+            this->projectRow(row, depth + (size_t) row * depthWidth);
+        }
+    }
+
+    // the z-buffer: the smallest depth, where 0 is no depth
+    int nrColorBands = min(this->nrBands, colorHeight);
+    #pragma omp parallel for shared(depth, registered, depthHeight, depthWidth, colorHeight, colorWidth, nrColorBands) \
+            default(none)
+    for (int band = 0; band < nrColorBands; band++) {
+        int bandTop = DepthRegistration::getBandFirstRow(band, nrColorBands, colorHeight);
+        int bandBottom = DepthRegistration::getBandFirstRow(band + 1, nrColorBands, colorHeight) - 1;
+        for (int row = 0; row < depthHeight; row++) {
+            if (this->rowRanges[2 * row] > bandBottom || this->rowRanges[2 * row + 1] < bandTop) {
+                continue;
+            }
+            const uint16_t *depthRow = depth + (size_t) row * depthWidth;
+            const int16_t *left = this->pixelRectangles.data() + (size_t) 4 * row * depthWidth;
+            const int16_t *top = left + depthWidth, *right = top + depthWidth, *bottom = right + depthWidth;
+            for (int u = 0; u < depthWidth; u++) {
+                if (left[u] < 0) {
+                    continue;
+                }
+                uint16_t value = depthRow[u];
+                int y0 = max((int) top[u], bandTop), y1 = min((int) bottom[u], bandBottom);
+                for (int y = y0; y <= y1; y++) {
+                    uint16_t *registeredRow = registered + (size_t) y * colorWidth;
+                    for (int x = left[u]; x <= right[u]; x++) {
+                        uint16_t &registeredValue = registeredRow[x];
+                        registeredValue = (registeredValue == 0) ? value : min(registeredValue, value);
+                    }
+                }
+            }
+        }
+    }
+}
+
+int DepthRegistration::getRegisteredHeight() const {
+    return this->colorIntrinsics.height;
+}
+
+int DepthRegistration::getRegisteredWidth() const {
+    return this->colorIntrinsics.width;
+}
+
+int DepthRegistration::getBandFirstRow(int band, int nrBands, int height) {
+    return (int) ((long long) band * height / nrBands);
+}
+
+void DepthRegistration::projectRow(int row, const uint16_t *depthRow) {
+    int width = this->depthIntrinsics.width;
+    int colorHeight = this->colorIntrinsics.height, colorWidth = this->colorIntrinsics.width;
+    int16_t *left = this->pixelRectangles.data() + (size_t) 4 * row * width;
+    int16_t *top = left + width, *right = top + width, *bottom = right + width;
+    // the top left corners of the row's pixels, and their bottom right corners (the top left ones of the next row,
+    // one pixel further)
+    size_t topLeft = (size_t) row * (width + 1), bottomRight = topLeft + width + 2;
+    const float *x0 = this->cornerX.data() + topLeft, *y0 = this->cornerY.data() + topLeft;
+    const float *z0 = this->cornerZ.data() + topLeft;
+    const float *x1 = this->cornerX.data() + bottomRight, *y1 = this->cornerY.data() + bottomRight;
+    const float *z1 = this->cornerZ.data() + bottomRight;
+    const float *translation = this->depthToColor.translation;
+    float tx = translation[0], ty = translation[1], tz = translation[2];
+
+    if (this->vectorizedProjection) {
+        ColorProjection projection{this->colorIntrinsics.fx, this->colorIntrinsics.fy, this->colorIntrinsics.ppx,
+                                   this->colorIntrinsics.ppy, 0, 0, 0, 0, 0};
+        if (this->colorIntrinsics.model != RS2_DISTORTION_NONE) {
+            const float *coefficients = this->colorIntrinsics.coeffs;
+            projection.k1 = coefficients[0];
+            projection.k2 = coefficients[1];
+            projection.p1 = coefficients[2];
+            projection.p2 = coefficients[3];
+            projection.k3 = coefficients[4];
+        }
+        #pragma omp simd
+        for (int u = 0; u < width; u++) {
+            auto value = (float) depthRow[u];
+            int16_t l, t, r, b;
+            projectToColor(projection, value * x0[u] + tx, value * y0[u] + ty, value * z0[u] + tz, l, t, colorWidth,
+                           colorHeight);
+            projectToColor(projection, value * x1[u] + tx, value * y1[u] + ty, value * z1[u] + tz, r, b, colorWidth,
+                           colorHeight);
+            bool inside = depthRow[u] != 0 && l >= 0 && t >= 0 && r < colorWidth && b < colorHeight;
+            left[u] = inside ? l : (int16_t) -1;
+            top[u] = t;
+            right[u] = r;
+            bottom[u] = b;
+        }
+    } else {
+        for (int u = 0; u < width; u++) {
+            auto value = (float) depthRow[u];
+            float topLeftPoint[3] = {value * x0[u] + tx, value * y0[u] + ty, value * z0[u] + tz};
+            float bottomRightPoint[3] = {value * x1[u] + tx, value * y1[u] + ty, value * z1[u] + tz};
+            float topLeftPixel[2], bottomRightPixel[2];
+            rs2_project_point_to_pixel(topLeftPixel, &this->colorIntrinsics, topLeftPoint);
+            rs2_project_point_to_pixel(bottomRightPixel, &this->colorIntrinsics, bottomRightPoint);
+            left[u] = toColorPixel(topLeftPixel[0], colorWidth);
+            top[u] = toColorPixel(topLeftPixel[1], colorHeight);
+            right[u] = toColorPixel(bottomRightPixel[0], colorWidth);
+            bottom[u] = toColorPixel(bottomRightPixel[1], colorHeight);
+            if (depthRow[u] == 0 || left[u] < 0 || top[u] < 0 || right[u] >= colorWidth || bottom[u] >= colorHeight) {
+                left[u] = -1;
+            }
+        }
+    }
+
+    int firstRow = INT_MAX, lastRow = -1;
+    for (int u = 0; u < width; u++) {
+        if (left[u] >= 0) {
+            firstRow = min(firstRow, (int) top[u]);
+            lastRow = max(lastRow, (int) bottom[u]);
+        }
+    }
+    this->rowRanges[2 * row] = firstRow;
+    this->rowRanges[2 * row + 1] = lastRow;
+}
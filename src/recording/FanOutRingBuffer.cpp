@@ -0,0 +1,255 @@
+#include <RealsenseRecording/recording/FanOutRingBuffer.h>
+#include <stdexcept>
+#include <string>
+
+using namespace RealsenseRecording;
+using namespace std;
+
+FanOutRingBuffer::FanOutRingBuffer(int capacity, int nrReaders) :
+        capacity(0), nrSlots(0), nrReaders(0), nrPositions(0), positions(), readers(), head(0), reclaimedPosition(0),
+        freeSlots(), nrFreeSlots(0), producerSlot(-1), producerWaiting(false), closed(false), nrWaitingReaders(0),
+        waitLock(), producerCondition(), readerCondition() {
+    if (capacity > 0) {
+        this->reset(capacity, nrReaders);
+    }
+}
+
+FanOutRingBuffer::~FanOutRingBuffer() {
+    this->close();
+}
+
+void FanOutRingBuffer::reset(int _capacity, int _nrReaders) {
+    if (_capacity < 1) {
+        throw runtime_error("Can not work with a buffer capacity < 1! Was " + to_string(_capacity));
+    }
+    if (_nrReaders < 1) {
+        throw runtime_error("Can not work with less than 1 buffer reader! Was " + to_string(_nrReaders));
+    }
+    this->capacity = _capacity;
+    this->nrReaders = _nrReaders;
+    this->nrSlots = _capacity + 1 + _nrReaders;
+    // the dropped positions hold no slot: room for as many of them as there are slots before the ring is full
+    this->nrPositions = 2 * this->nrSlots;
+    this->positions.reset(new atomic<int>[this->nrPositions]);
+    for (int i = 0; i < this->nrPositions; i++) {
+        this->positions[i].store(FanOutRingBuffer::DROPPED_POSITION, memory_order_relaxed);
+    }
+    this->readers.reset(new ReaderCursor[_nrReaders]);
+    for (int reader = 0; reader < _nrReaders; reader++) {
+        this->readers[reader].position.store(0, memory_order_relaxed);
+        this->readers[reader].slot = -1;
+    }
+    this->head.store(0);
+    this->reclaimedPosition = 0;
+    this->freeSlots.resize(this->nrSlots);
+    for (int i = 0; i < this->nrSlots; i++) {
+        // popped from the back: hand out the slots in ascending order
+        this->freeSlots[i] = this->nrSlots - 1 - i;
+    }
+    this->nrFreeSlots = this->nrSlots;
+    this->producerSlot = -1;
+    this->producerWaiting.store(false);
+    this->nrWaitingReaders.store(0);
+    this->closed.store(false);
+}
+
+int FanOutRingBuffer::acquireWriteSlot(BufferOverflowPolicy policy, bool &droppedOldest) {
+    droppedOldest = false;
+    if (this->producerSlot >= 0) {
+        // acquired before but never published
+        return this->producerSlot;
+    }
+    while (!this->closed.load(memory_order_acquire)) {
+        this->reclaimSlots();
+        bool positionsFull = this->head.load(memory_order_relaxed) - this->reclaimedPosition >=
+                             (unsigned long long) this->nrPositions;
+        if (this->nrFreeSlots > 0 && !positionsFull) {
+            this->producerSlot = this->freeSlots[--this->nrFreeSlots];
+            return this->producerSlot;
+        }
+        switch (policy) {
+            case BLOCK_WHEN_FULL: {
+                unique_lock<mutex> waitGuard(this->waitLock);
+                this->producerWaiting.store(true);
+                // the cursors are only loaded with acquire: order them after the store, see notifyProducer
+                atomic_thread_fence(memory_order_seq_cst);
+                while (this->getSlowestPosition() == this->reclaimedPosition && !this->closed.load()) {
+                    this->producerCondition.wait(waitGuard);
+                }
+                this->producerWaiting.store(false);
+                break;
+            }
+            case DROP_NEWEST: {
+                return -1;
+            }
+            case DROP_OLDEST: {
+                // the newest frame still needs a position of its own
+                int slot = positionsFull ? -1 : this->dropOldestUnreadSlot();
+                if (slot < 0) {
+                    // the readers are busy with all queued slots: dropping one would split up a frame
+                    return -1;
+                }
+                this->producerSlot = slot;
+                droppedOldest = true;
+                return slot;
+            }
+        }
+    }
+    return -1;
+}
+
+void FanOutRingBuffer::publishWriteSlot() {
+    if (this->producerSlot < 0) {
+        throw runtime_error("Can not publish a slot which has not been acquired!");
+    }
+    unsigned long long position = this->head.load(memory_order_relaxed);
+    this->positions[position % this->nrPositions].store(this->producerSlot << 1, memory_order_relaxed);
+    this->head.store(position + 1, memory_order_release);
+    this->producerSlot = -1;
+    this->notifyReaders();
+}
+
+int FanOutRingBuffer::acquireReadSlot(int reader) {
+    this->releaseReadSlot(reader);
+    ReaderCursor &cursor = this->readers[reader];
+    while (true) {
+        unsigned long long position = cursor.position.load(memory_order_relaxed);
+        if (position == this->head.load(memory_order_acquire)) {
+            if (this->closed.load(memory_order_acquire)) {
+                if (position == this->head.load(memory_order_acquire)) {
+                    return -1;
+                }
+                continue;
+            }
+            unique_lock<mutex> waitGuard(this->waitLock);
+            this->nrWaitingReaders++;
+            while (cursor.position.load() == this->head.load() && !this->closed.load()) {
+                this->readerCondition.wait(waitGuard);
+            }
+            this->nrWaitingReaders--;
+            continue;
+        }
+        // mark the position as started, unless the producer dropped it first (or another reader started on it)
+        atomic<int> &entry = this->positions[position % this->nrPositions];
+        int value = entry.load(memory_order_acquire);
+        while (value != FanOutRingBuffer::DROPPED_POSITION && (value & 1) == 0 &&
+               !entry.compare_exchange_weak(value, value | 1, memory_order_acq_rel, memory_order_acquire)) {
+        }
+        if (value == FanOutRingBuffer::DROPPED_POSITION) {
+            cursor.position.store(position + 1, memory_order_release);
+            this->notifyProducer();
+            continue;
+        }
+        cursor.slot = value >> 1;
+        return cursor.slot;
+    }
+}
+
+void FanOutRingBuffer::releaseReadSlot(int reader) {
+    ReaderCursor &cursor = this->readers[reader];
+    if (cursor.slot < 0) {
+        return;
+    }
+    cursor.slot = -1;
+    cursor.position.store(cursor.position.load(memory_order_relaxed) + 1, memory_order_release);
+    this->notifyProducer();
+}
+
+void FanOutRingBuffer::close() {
+    this->closed.store(true, memory_order_release);
+    lock_guard<mutex> waitGuard(this->waitLock);
+    this->producerCondition.notify_all();
+    this->readerCondition.notify_all();
+}
+
+bool FanOutRingBuffer::isClosed() const {
+    return this->closed.load(memory_order_acquire);
+}
+
+int FanOutRingBuffer::getCapacity() const {
+    return this->capacity;
+}
+
+int FanOutRingBuffer::getNrSlots() const {
+    return this->nrSlots;
+}
+
+int FanOutRingBuffer::getNrReaders() const {
+    return this->nrReaders;
+}
+
+int FanOutRingBuffer::size() const {
+    if (this->nrReaders == 0) {
+        return 0;
+    }
+    unsigned long long slowest = this->getSlowestPosition();
+    return (int) (this->head.load(memory_order_acquire) - slowest);
+}
+
+unsigned long long FanOutRingBuffer::getSlowestPosition() const {
+    unsigned long long slowest = this->readers[0].position.load(memory_order_acquire);
+    for (int reader = 1; reader < this->nrReaders; reader++) {
+        unsigned long long position = this->readers[reader].position.load(memory_order_acquire);
+        if (position < slowest) {
+            slowest = position;
+        }
+    }
+    return slowest;
+}
+
+unsigned long long FanOutRingBuffer::getFastestPosition() const {
+    unsigned long long fastest = this->readers[0].position.load(memory_order_acquire);
+    for (int reader = 1; reader < this->nrReaders; reader++) {
+        unsigned long long position = this->readers[reader].position.load(memory_order_acquire);
+        if (position > fastest) {
+            fastest = position;
+        }
+    }
+    return fastest;
+}
+
+void FanOutRingBuffer::reclaimSlots() {
+    unsigned long long slowest = this->getSlowestPosition();
+    for (; this->reclaimedPosition < slowest; this->reclaimedPosition++) {
+        int value = this->positions[this->reclaimedPosition % this->nrPositions].load(memory_order_relaxed);
+        // the slot of a dropped position went straight back to the producer
+        if (value != FanOutRingBuffer::DROPPED_POSITION) {
+            this->freeSlots[this->nrFreeSlots++] = value >> 1;
+        }
+    }
+}
+
+int FanOutRingBuffer::dropOldestUnreadSlot() {
+    // only the positions which no reader has started on can be dropped; the readers race for them with their marks
+    unsigned long long end = this->head.load(memory_order_relaxed);
+    unsigned long long position = this->getFastestPosition();
+    if (position < this->reclaimedPosition) {
+        position = this->reclaimedPosition;
+    }
+    for (; position < end; position++) {
+        atomic<int> &entry = this->positions[position % this->nrPositions];
+        int value = entry.load(memory_order_acquire);
+        if (value != FanOutRingBuffer::DROPPED_POSITION && (value & 1) == 0 &&
+            entry.compare_exchange_strong(value, FanOutRingBuffer::DROPPED_POSITION, memory_order_acq_rel)) {
+            return value >> 1;
+        }
+    }
+    return -1;
+}
+
+void FanOutRingBuffer::notifyProducer() {
+    // pairs with the seq_cst store of producerWaiting: either the producer sees the new position or we see it waiting
+    atomic_thread_fence(memory_order_seq_cst);
+    if (this->producerWaiting.load()) {
+        lock_guard<mutex> waitGuard(this->waitLock);
+        this->producerCondition.notify_one();
+    }
+}
+
+void FanOutRingBuffer::notifyReaders() {
+    atomic_thread_fence(memory_order_seq_cst);
+    if (this->nrWaitingReaders.load() > 0) {
+        lock_guard<mutex> waitGuard(this->waitLock);
+        this->readerCondition.notify_all();
+    }
+}
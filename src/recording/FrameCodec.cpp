@@ -0,0 +1,200 @@
+#include <RealsenseRecording/recording/FrameCodec.h>
+#include <AndreiUtils/utilsImages.h>
+#include <stdexcept>
+#include <string>
+
+#ifdef OPENCV
+#include <AndreiUtils/utilsOpenCV.h>
+#endif
+
+using namespace AndreiUtils;
+using namespace RealsenseRecording;
+using namespace std;
+
+namespace {
+    // the "bin" records of AndreiUtils, which only writes to files
+    inline ofstream *getFileStream(ostream *out) {
+        auto fileOut = dynamic_cast<ofstream *>(out);
+        if (fileOut == nullptr) {
+            throw runtime_error("The \"bin\" frame records can only be written to files!");
+        }
+        return fileOut;
+    }
+
+    // the "bin" records of AndreiUtils: 3 byte images and 16 bit single channel frames
+    inline void writeFrameRecord(ofstream *out, const uint8_t *frame, int height, int width) {
+        writeColorImageBinary(out, (uint8_t *) frame, height, width, AndreiUtils::TYPE_UINT_8);
+    }
+
+    inline void writeFrameRecord(ofstream *out, const uint16_t *frame, int height, int width) {
+        writeDepthImageBinary(out, (uint16_t *) frame, height, width);
+    }
+
+    inline bool readFrameRecord(ifstream *in, uint8_t *frame, int height, int width) {
+        StandardTypes type;
+        if (!readColorImageBinary(in, frame, height, width, type, 3 * height * width)) {
+            return false;
+        }
+        if (type != AndreiUtils::TYPE_UINT_8) {
+            throw runtime_error("The recorded images are not 8 bit images!");
+        }
+        return true;
+    }
+
+    inline bool readFrameRecord(ifstream *in, uint16_t *frame, int height, int width) {
+        return readDepthImageBinary(in, frame, height, width, height * width);
+    }
+
+    template<class Layout>
+    class BinaryFrameCodec : public FrameCodec {
+    public:
+        typedef typename Layout::Element Element;
+
+        static_assert(Layout::CHANNELS == ((sizeof(Element) == 1) ? 3 : 1),
+                      "The \"bin\" records hold 3 channel 8 bit or single channel 16 bit frames");
+
+        BinaryFrameCodec(int height, int width) : FrameCodec(height, width, Layout::getNrBytes(height, width)) {}
+
+        void write(ostream *out, const uint8_t *frame) override {
+            writeFrameRecord(getFileStream(out), (const Element *) frame, this->height, this->width);
+        }
+
+        bool read(ifstream *in, uint8_t *frame) override {
+            return readFrameRecord(in, (Element *) frame, this->height, this->width);
+        }
+
+        #ifdef OPENCV
+
+        void write(ostream *out, cv::Mat &frame) override {
+            matWriteBinary(getFileStream(out), frame);
+        }
+
+        bool read(ifstream *in, cv::Mat &frame) override {
+            cv::Mat *readFrame = &frame;
+            if (!matReadBinary(in, readFrame)) {
+                return false;
+            }
+            if (frame.type() != CV_MAKETYPE(cv::DataType<Element>::depth, Layout::CHANNELS)) {
+                throw runtime_error("The recorded frames do not have the recording's pixel layout!");
+            }
+            return true;
+        }
+
+        #endif
+    };
+
+    // the "bin" frames of containers: only the pixels
+    template<class Layout>
+    class RawFrameCodec : public FrameCodec {
+    public:
+        typedef typename Layout::Element Element;
+
+        RawFrameCodec(int height, int width) : FrameCodec(height, width, Layout::getNrBytes(height, width)) {}
+
+        void write(ostream *out, const uint8_t *frame) override {
+            out->write((const char *) frame, (streamsize) this->nrBytes);
+        }
+
+        bool read(ifstream *in, uint8_t *frame) override {
+            in->read((char *) frame, (streamsize) this->nrBytes);
+            return (bool) *in;
+        }
+
+        #ifdef OPENCV
+
+        void write(ostream *out, cv::Mat &frame) override {
+            if (frame.type() != CV_MAKETYPE(cv::DataType<Element>::depth, Layout::CHANNELS) ||
+                frame.rows != this->height || frame.cols != this->width) {
+                throw runtime_error("The frame does not have the recording's size and pixel layout!");
+            }
+            size_t rowSize = this->nrBytes / this->height;
+            for (int row = 0; row < frame.rows; row++) {
+                out->write((const char *) frame.ptr(row), (streamsize) rowSize);
+            }
+        }
+
+        bool read(ifstream *in, cv::Mat &frame) override {
+            frame.create(this->height, this->width, CV_MAKETYPE(cv::DataType<Element>::depth, Layout::CHANNELS));
+            return this->read(in, frame.data);
+        }
+
+        #endif
+    };
+
+    class RvlFrameCodec : public FrameCodec {
+    public:
+        RvlFrameCodec(int height, int width, DepthCodec &depthCodec) :
+                FrameCodec(height, width, DepthLayout::getNrBytes(height, width)), depthCodec(depthCodec) {}
+
+        void write(ostream *out, const uint8_t *frame) override {
+            this->depthCodec.encode((const uint16_t *) frame, this->height, this->width, out);
+        }
+
+        bool read(ifstream *in, uint8_t *frame) override {
+            return this->depthCodec.decode(in, (uint16_t *) frame, this->height, this->width);
+        }
+
+        #ifdef OPENCV
+
+        void write(ostream *out, cv::Mat &frame) override {
+            cv::Mat encodedFrame = frame.isContinuous() ? frame : frame.clone();
+            this->depthCodec.encode((const uint16_t *) encodedFrame.data, encodedFrame.rows, encodedFrame.cols, out);
+        }
+
+        bool read(ifstream *in, cv::Mat &frame) override {
+            frame.create(this->height, this->width, CV_16UC1);
+            return this->depthCodec.decode(in, (uint16_t *) frame.data, this->height, this->width);
+        }
+
+        #endif
+
+    private:
+        DepthCodec &depthCodec;
+    };
+}
+
+unique_ptr<FrameCodec> FrameCodec::createImageCodec(const RecordingParameters &parameters) {
+    const string &format = parameters.imageFormat;
+    bool container = parameters.parametersFormat == "rsrec";
+    if (format == "avi") {
+        return nullptr;
+    } else if (format == "bin" && container && parameters.imagePixelFormat == IMAGE_YUYV) {
+        return unique_ptr<FrameCodec>(new RawFrameCodec<YuyvLayout>(parameters.height, parameters.width));
+    } else if (format == "bin" && container) {
+        return unique_ptr<FrameCodec>(new RawFrameCodec<Rgb8Layout>(parameters.height, parameters.width));
+    } else if (format == "bin" && parameters.imagePixelFormat == IMAGE_YUYV) {
+        return unique_ptr<FrameCodec>(new BinaryFrameCodec<YuyvLayout>(parameters.height, parameters.width));
+    } else if (format == "bin") {
+        return unique_ptr<FrameCodec>(new BinaryFrameCodec<Rgb8Layout>(parameters.height, parameters.width));
+    }
+    throw runtime_error("Unknown image format: \"" + format + "\"");
+}
+
+unique_ptr<FrameCodec> FrameCodec::createDepthCodec(const RecordingParameters &parameters, DepthCodec &depthCodec) {
+    const string &format = parameters.depthFormat;
+    int height = parameters.getDepthHeight(), width = parameters.getDepthWidth();
+    if (format == "bin" && parameters.parametersFormat == "rsrec") {
+        return unique_ptr<FrameCodec>(new RawFrameCodec<DepthLayout>(height, width));
+    } else if (format == "bin") {
+        return unique_ptr<FrameCodec>(new BinaryFrameCodec<DepthLayout>(height, width));
+    } else if (format == "rvl") {
+        return unique_ptr<FrameCodec>(new RvlFrameCodec(height, width, depthCodec));
+    }
+    throw runtime_error("Unknown depth format: \"" + format + "\"");
+}
+
+FrameCodec::FrameCodec(int height, int width, size_t nrBytes) : height(height), width(width), nrBytes(nrBytes) {}
+
+FrameCodec::~FrameCodec() = default;
+
+int FrameCodec::getHeight() const {
+    return this->height;
+}
+
+int FrameCodec::getWidth() const {
+    return this->width;
+}
+
+size_t FrameCodec::getNrBytes() const {
+    return this->nrBytes;
+}
@@ -0,0 +1,94 @@
+#include <RealsenseRecording/recording/FrameSlabPool.h>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+using namespace RealsenseRecording;
+using namespace std;
+
+FrameSlabPool::FrameSlabPool() : slabs(), nrSlots(0), nrImageBytes(0), nrDepthElements(0), depthOffset(0),
+                                 nrAllocations(0) {}
+
+FrameSlabPool::~FrameSlabPool() {
+    this->releaseSlabs();
+}
+
+void FrameSlabPool::reset(int _nrSlots, size_t _nrImageBytes, size_t _nrDepthElements) {
+    if (_nrSlots < 1) {
+        throw runtime_error("Can not work with a slab pool of < 1 slots! Was " + to_string(_nrSlots));
+    }
+    this->releaseSlabs();
+    this->slabs.reset(new atomic<uint8_t *>[_nrSlots]);
+    for (int i = 0; i < _nrSlots; i++) {
+        this->slabs[i].store(nullptr, memory_order_relaxed);
+    }
+    this->nrSlots = _nrSlots;
+    this->nrImageBytes = _nrImageBytes;
+    this->nrDepthElements = _nrDepthElements;
+    // keep the depth values of a slab on their own cache line
+    this->depthOffset = (_nrImageBytes + SLAB_ALIGNMENT - 1) / SLAB_ALIGNMENT * SLAB_ALIGNMENT;
+}
+
+void FrameSlabPool::preallocate(int nrPreallocatedSlots) {
+    for (int i = 0; i < nrPreallocatedSlots && i < this->nrSlots; i++) {
+        this->getSlab(i);
+    }
+}
+
+uint8_t *FrameSlabPool::getImageSlab(int slot) {
+    return this->getSlab(slot);
+}
+
+uint16_t *FrameSlabPool::getDepthSlab(int slot) {
+    return (uint16_t *) (this->getSlab(slot) + this->depthOffset);
+}
+
+bool FrameSlabPool::isInitialized() const {
+    return this->nrSlots > 0;
+}
+
+int FrameSlabPool::getNrSlots() const {
+    return this->nrSlots;
+}
+
+size_t FrameSlabPool::getNrImageBytes() const {
+    return this->nrImageBytes;
+}
+
+size_t FrameSlabPool::getNrDepthElements() const {
+    return this->nrDepthElements;
+}
+
+unsigned long long FrameSlabPool::getNrAllocations() const {
+    return this->nrAllocations.load(memory_order_relaxed);
+}
+
+uint8_t *FrameSlabPool::getSlab(int slot) {
+    if (slot < 0 || slot >= this->nrSlots) {
+        throw runtime_error("Slab pool slot " + to_string(slot) + " is out of range [0, " +
+                            to_string(this->nrSlots) + ")");
+    }
+    uint8_t *allocation = this->slabs[slot].load(memory_order_acquire);
+    if (allocation == nullptr) {
+        auto *newAllocation = new uint8_t[this->depthOffset + this->nrDepthElements * sizeof(uint16_t) +
+                                          SLAB_ALIGNMENT - 1];
+        // the image and the depth writer of the slot may both allocate it: the first one wins
+        if (this->slabs[slot].compare_exchange_strong(allocation, newAllocation, memory_order_acq_rel,
+                                                      memory_order_acquire)) {
+            allocation = newAllocation;
+            this->nrAllocations.fetch_add(1, memory_order_relaxed);
+        } else {
+            delete[] newAllocation;
+        }
+    }
+    auto address = (uintptr_t) allocation;
+    return allocation + ((SLAB_ALIGNMENT - address % SLAB_ALIGNMENT) % SLAB_ALIGNMENT);
+}
+
+void FrameSlabPool::releaseSlabs() {
+    for (int i = 0; i < this->nrSlots; i++) {
+        delete[] this->slabs[i].load(memory_order_relaxed);
+    }
+    this->slabs.reset();
+    this->nrSlots = 0;
+}
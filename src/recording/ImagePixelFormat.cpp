@@ -0,0 +1,24 @@
+#include <RealsenseRecording/recording/ImagePixelFormat.h>
+#include <stdexcept>
+
+using namespace RealsenseRecording;
+using namespace std;
+
+ImagePixelFormat RealsenseRecording::imagePixelFormatFromString(const string &format) {
+    if (format == "rgb8") {
+        return IMAGE_RGB8;
+    } else if (format == "yuyv") {
+        return IMAGE_YUYV;
+    }
+    throw runtime_error("Unknown image pixel format: \"" + format + R"(". Accepted are "rgb8" and "yuyv")");
+}
+
+string RealsenseRecording::imagePixelFormatToString(ImagePixelFormat format) {
+    switch (format) {
+        case IMAGE_RGB8:
+            return "rgb8";
+        case IMAGE_YUYV:
+            return "yuyv";
+    }
+    throw runtime_error("Unknown image pixel format: " + to_string((int) format));
+}
@@ -0,0 +1,210 @@
+#include <RealsenseRecording/recording/ImageRotation.h>
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__)
+#define IMAGE_ROTATION_SSE2
+
+#include <emmintrin.h>
+
+#endif
+
+using namespace AndreiUtils;
+using namespace RealsenseRecording;
+using namespace std;
+
+namespace {
+    // a tile of the source and of the destination fit the L1 cache together (32x32 pixels of 3 bytes: 2 * 3KB)
+    const int TILE_SIZE = 32;
+
+    // the pixels are copied as a whole, which the compiler turns into one (or, for 3 bytes, two) moves
+    template<class T, int C>
+    struct Pixel {
+        T channels[C];
+    };
+
+    // rotates the [y0, y1) x [x0, x1) tile of the source by 90 degrees (counterclockwise or clockwise); the
+    // destination rows are written sequentially, while the source columns are read from the cached tile
+    template<class T, int C>
+    void rotate90Tile(const T *source, size_t sourceStride, T *destination, int height, int width, int y0, int y1,
+                      int x0, int x1, bool counterClockwise) {
+        typedef Pixel<T, C> P;
+        for (int x = x0; x < x1; x++) {
+            // the rows may be padded by less than a pixel
+            const T *sourcePixel = source + (size_t) y0 * sourceStride + (size_t) x * C;
+            if (counterClockwise) {
+                auto *destinationPixel = (P *) destination + (size_t) (width - 1 - x) * height + y0;
+                for (int y = y0; y < y1; y++, sourcePixel += sourceStride) {
+                    *(destinationPixel++) = *(const P *) sourcePixel;
+                }
+            } else {
+                // bottom up, so that the destination row is written in ascending order as well
+                sourcePixel += (size_t) (y1 - 1 - y0) * sourceStride;
+                auto *destinationPixel = (P *) destination + (size_t) x * height + (height - y1);
+                for (int y = y1 - 1; y >= y0; y--, sourcePixel -= sourceStride) {
+                    *(destinationPixel++) = *(const P *) sourcePixel;
+                }
+            }
+        }
+    }
+
+    template<class T, int C>
+    void rotate180Rows(const T *source, size_t sourceStride, T *destination, int height, int width) {
+        typedef Pixel<T, C> P;
+        for (int y = 0; y < height; y++) {
+            auto *sourcePixel = (const P *) (source + (size_t) y * sourceStride);
+            auto *destinationPixel = (P *) destination + (size_t) (height - y) * width - 1;
+            for (int x = 0; x < width; x++) {
+                *(destinationPixel--) = *(sourcePixel++);
+            }
+        }
+    }
+
+    template<class T, int C>
+    void copyRows(const T *source, size_t sourceStride, T *destination, int height, int width) {
+        size_t rowSize = (size_t) width * C;
+        if (sourceStride == rowSize) {
+            memcpy(destination, source, (size_t) height * rowSize * sizeof(T));
+            return;
+        }
+        for (int y = 0; y < height; y++) {
+            memcpy(destination + (size_t) y * rowSize, source + (size_t) y * sourceStride, rowSize * sizeof(T));
+        }
+    }
+
+    #ifdef IMAGE_ROTATION_SSE2
+
+    void transpose8x8(__m128i rows[8]) {
+        __m128i a0 = _mm_unpacklo_epi16(rows[0], rows[1]), a1 = _mm_unpackhi_epi16(rows[0], rows[1]);
+        __m128i a2 = _mm_unpacklo_epi16(rows[2], rows[3]), a3 = _mm_unpackhi_epi16(rows[2], rows[3]);
+        __m128i a4 = _mm_unpacklo_epi16(rows[4], rows[5]), a5 = _mm_unpackhi_epi16(rows[4], rows[5]);
+        __m128i a6 = _mm_unpacklo_epi16(rows[6], rows[7]), a7 = _mm_unpackhi_epi16(rows[6], rows[7]);
+        __m128i b0 = _mm_unpacklo_epi32(a0, a2), b1 = _mm_unpackhi_epi32(a0, a2);
+        __m128i b2 = _mm_unpacklo_epi32(a1, a3), b3 = _mm_unpackhi_epi32(a1, a3);
+        __m128i b4 = _mm_unpacklo_epi32(a4, a6), b5 = _mm_unpackhi_epi32(a4, a6);
+        __m128i b6 = _mm_unpacklo_epi32(a5, a7), b7 = _mm_unpackhi_epi32(a5, a7);
+        rows[0] = _mm_unpacklo_epi64(b0, b4);
+        rows[1] = _mm_unpackhi_epi64(b0, b4);
+        rows[2] = _mm_unpacklo_epi64(b1, b5);
+        rows[3] = _mm_unpackhi_epi64(b1, b5);
+        rows[4] = _mm_unpacklo_epi64(b2, b6);
+        rows[5] = _mm_unpackhi_epi64(b2, b6);
+        rows[6] = _mm_unpacklo_epi64(b3, b7);
+        rows[7] = _mm_unpackhi_epi64(b3, b7);
+    }
+
+    // rotates the 8x8 depth block at (y, x); clockwise, the source rows are loaded bottom up, so that the transposed
+    // source columns are already in the order of the destination rows
+    inline void rotate90DepthBlock(const uint16_t *source, size_t sourceStride, uint16_t *destination, int height,
+                                   int width, int y, int x, bool counterClockwise) {
+        __m128i rows[8];
+        for (int i = 0; i < 8; i++) {
+            int row = counterClockwise ? y + i : y + 7 - i;
+            rows[i] = _mm_loadu_si128((const __m128i *) (source + (size_t) row * sourceStride + x));
+        }
+        transpose8x8(rows);
+        int destinationColumn = counterClockwise ? y : height - 8 - y;
+        for (int i = 0; i < 8; i++) {
+            int destinationRow = counterClockwise ? width - 1 - x - i : x + i;
+            _mm_storeu_si128((__m128i *) (destination + (size_t) destinationRow * height + destinationColumn), rows[i]);
+        }
+    }
+
+    void rotate90DepthTile(const uint16_t *source, size_t sourceStride, uint16_t *destination, int height, int width,
+                           int y0, int y1, int x0, int x1, bool counterClockwise) {
+        // only the tiles at the right and bottom borders of the frame have incomplete blocks
+        int yBlocksEnd = y0 + (y1 - y0) / 8 * 8, xBlocksEnd = x0 + (x1 - x0) / 8 * 8;
+        for (int y = y0; y < yBlocksEnd; y += 8) {
+            for (int x = x0; x < xBlocksEnd; x += 8) {
+                rotate90DepthBlock(source, sourceStride, destination, height, width, y, x, counterClockwise);
+            }
+        }
+        rotate90Tile<uint16_t, 1>(source, sourceStride, destination, height, width, y0, yBlocksEnd, xBlocksEnd, x1,
+                                  counterClockwise);
+        rotate90Tile<uint16_t, 1>(source, sourceStride, destination, height, width, yBlocksEnd, y1, x0, x1,
+                                  counterClockwise);
+    }
+
+    void rotate180DepthRows(const uint16_t *source, size_t sourceStride, uint16_t *destination, int height,
+                            int width) {
+        int blocksEnd = width / 8 * 8;
+        for (int y = 0; y < height; y++) {
+            const uint16_t *sourceRow = source + (size_t) y * sourceStride;
+            uint16_t *destinationRow = destination + (size_t) (height - 1 - y) * width;
+            for (int x = 0; x < blocksEnd; x += 8) {
+                __m128i block = _mm_loadu_si128((const __m128i *) (sourceRow + x));
+                // reverses the 4 elements of each half, then swaps the halves
+                block = _mm_shufflehi_epi16(_mm_shufflelo_epi16(block, 0x1B), 0x1B);
+                block = _mm_shuffle_epi32(block, 0x4E);
+                _mm_storeu_si128((__m128i *) (destinationRow + width - 8 - x), block);
+            }
+            for (int x = blocksEnd; x < width; x++) {
+                destinationRow[width - 1 - x] = sourceRow[x];
+            }
+        }
+    }
+
+    #endif
+
+    template<class T, int C>
+    void rotate90(const T *source, size_t sourceStride, T *destination, int height, int width,
+                  bool counterClockwise) {
+        for (int y0 = 0; y0 < height; y0 += TILE_SIZE) {
+            int y1 = min(y0 + TILE_SIZE, height);
+            for (int x0 = 0; x0 < width; x0 += TILE_SIZE) {
+                int x1 = min(x0 + TILE_SIZE, width);
+                #ifdef IMAGE_ROTATION_SSE2
+                if (C == 1 && sizeof(T) == sizeof(uint16_t)) {
+                    rotate90DepthTile((const uint16_t *) source, sourceStride, (uint16_t *) destination, height,
+                                      width, y0, y1, x0, x1, counterClockwise);
+                    continue;
+                }
+                #endif
+                rotate90Tile<T, C>(source, sourceStride, destination, height, width, y0, y1, x0, x1,
+                                   counterClockwise);
+            }
+        }
+    }
+
+    template<class T, int C>
+    void rotate(const T *source, int height, int width, size_t sourceStride, T *destination, RotationType rotation) {
+        switch (rotation) {
+            case LEFT_90:
+                rotate90<T, C>(source, sourceStride, destination, height, width, true);
+                return;
+            case LEFT_180:
+                #ifdef IMAGE_ROTATION_SSE2
+                if (C == 1 && sizeof(T) == sizeof(uint16_t)) {
+                    rotate180DepthRows((const uint16_t *) source, sourceStride, (uint16_t *) destination, height,
+                                       width);
+                    return;
+                }
+                #endif
+                rotate180Rows<T, C>(source, sourceStride, destination, height, width);
+                return;
+            case LEFT_270:
+                rotate90<T, C>(source, sourceStride, destination, height, width, false);
+                return;
+            default:
+                copyRows<T, C>(source, sourceStride, destination, height, width);
+                return;
+        }
+    }
+}
+
+void ImageRotation::rotateImage(const uint8_t *source, int height, int width, size_t sourceStride,
+                                uint8_t *destination, RotationType rotation) {
+    rotate<uint8_t, 3>(source, height, width, sourceStride, destination, rotation);
+}
+
+void ImageRotation::rotateDepth(const uint16_t *source, int height, int width, size_t sourceStride,
+                                uint16_t *destination, RotationType rotation) {
+    rotate<uint16_t, 1>(source, height, width, sourceStride, destination, rotation);
+}
+
+void ImageRotation::getRotatedSize(RotationType rotation, int height, int width, int &rotatedHeight,
+                                   int &rotatedWidth) {
+    bool swapped = rotation == LEFT_90 || rotation == LEFT_270;
+    rotatedHeight = swapped ? width : height;
+    rotatedWidth = swapped ? height : width;
+}
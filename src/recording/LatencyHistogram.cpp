@@ -0,0 +1,112 @@
+#include <RealsenseRecording/recording/LatencyHistogram.h>
+
+using namespace nlohmann;
+using namespace RealsenseRecording;
+using namespace std;
+
+const int LatencyHistogram::SUB_BUCKET_BITS;
+const int LatencyHistogram::SUB_BUCKETS;
+const int LatencyHistogram::NR_BUCKETS;
+
+LatencyHistogram::LatencyHistogram() :
+        buckets(new atomic<unsigned long long>[LatencyHistogram::NR_BUCKETS]), count(0), sum(0), max(0) {
+    this->reset();
+}
+
+void LatencyHistogram::record(uint64_t nanoseconds) {
+    this->buckets[LatencyHistogram::getBucket(nanoseconds)].fetch_add(1, memory_order_relaxed);
+    this->count.fetch_add(1, memory_order_relaxed);
+    this->sum.fetch_add(nanoseconds, memory_order_relaxed);
+    uint64_t previousMax = this->max.load(memory_order_relaxed);
+    while (nanoseconds > previousMax &&
+           !this->max.compare_exchange_weak(previousMax, nanoseconds, memory_order_relaxed)) {}
+}
+
+void LatencyHistogram::recordSince(chrono::steady_clock::time_point start) {
+    auto duration = chrono::steady_clock::now() - start;
+    this->record((uint64_t) chrono::duration_cast<chrono::nanoseconds>(duration).count());
+}
+
+void LatencyHistogram::reset() {
+    for (int i = 0; i < LatencyHistogram::NR_BUCKETS; i++) {
+        this->buckets[i].store(0, memory_order_relaxed);
+    }
+    this->count = 0;
+    this->sum = 0;
+    this->max = 0;
+}
+
+unsigned long long LatencyHistogram::getCount() const {
+    return this->count.load(memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::getMax() const {
+    return this->max.load(memory_order_relaxed);
+}
+
+double LatencyHistogram::getMean() const {
+    unsigned long long nrValues = this->getCount();
+    return (nrValues == 0) ? 0 : (double) this->sum.load(memory_order_relaxed) / (double) nrValues;
+}
+
+uint64_t LatencyHistogram::getPercentile(double fraction) const {
+    unsigned long long nrValues = this->getCount();
+    if (nrValues == 0) {
+        return 0;
+    }
+    auto rank = (unsigned long long) (fraction * (double) nrValues + 0.5);
+    if (rank < 1) {
+        rank = 1;
+    }
+    unsigned long long nrSeen = 0;
+    for (int i = 0; i < LatencyHistogram::NR_BUCKETS; i++) {
+        nrSeen += this->buckets[i].load(memory_order_relaxed);
+        if (nrSeen >= rank) {
+            // the bucket bound may be above the largest recorded value
+            return std::min(LatencyHistogram::getBucketUpperBound(i), this->getMax());
+        }
+    }
+    return this->getMax();
+}
+
+void LatencyHistogram::to_json(json &data) const {
+    data["count"] = this->getCount();
+    data["meanMs"] = this->getMean() / 1e6;
+    data["p50Ms"] = (double) this->getPercentile(0.5) / 1e6;
+    data["p99Ms"] = (double) this->getPercentile(0.99) / 1e6;
+    data["maxMs"] = (double) this->getMax() / 1e6;
+}
+
+int LatencyHistogram::getBucket(uint64_t nanoseconds) {
+    if (nanoseconds < (uint64_t) LatencyHistogram::SUB_BUCKETS) {
+        return (int) nanoseconds;
+    }
+    #if defined(__GNUC__) || defined(__clang__)
+    int highestBit = 63 - __builtin_clzll(nanoseconds);
+    #else
+    int highestBit = 0;
+    for (uint64_t remaining = nanoseconds >> 1; remaining > 0; remaining >>= 1) {
+        highestBit++;
+    }
+    #endif
+    int shift = highestBit - LatencyHistogram::SUB_BUCKET_BITS;
+    // the sub-bucket drops the highest bit, which is given by the shift
+    auto subBucket = (int) ((nanoseconds >> shift) - LatencyHistogram::SUB_BUCKETS);
+    return (shift + 1) * LatencyHistogram::SUB_BUCKETS + subBucket;
+}
+
+uint64_t LatencyHistogram::getBucketUpperBound(int bucket) {
+    if (bucket < LatencyHistogram::SUB_BUCKETS) {
+        return (uint64_t) bucket;
+    }
+    int shift = bucket / LatencyHistogram::SUB_BUCKETS - 1;
+    auto subBucket = (uint64_t) (bucket % LatencyHistogram::SUB_BUCKETS + LatencyHistogram::SUB_BUCKETS);
+    return ((subBucket + 1) << shift) - 1;
+}
+
+LatencyHistogram::ScopedTimer::ScopedTimer(LatencyHistogram &histogram) :
+        histogram(histogram), start(chrono::steady_clock::now()) {}
+
+LatencyHistogram::ScopedTimer::~ScopedTimer() {
+    this->histogram.recordSince(this->start);
+}
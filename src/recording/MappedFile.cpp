@@ -0,0 +1,91 @@
+#include <RealsenseRecording/recording/MappedFile.h>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#ifndef _WIN32
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#endif
+
+using namespace RealsenseRecording;
+using namespace std;
+
+MappedFile::MappedFile() : data(nullptr), size(0), fileDescriptor(-1), access(SEQUENTIAL_ACCESS),
+                           accessAdvised(false) {}
+
+MappedFile::~MappedFile() {
+    this->close();
+}
+
+void MappedFile::open(const string &file) {
+    this->close();
+    #ifndef _WIN32
+    this->fileDescriptor = ::open(file.c_str(), O_RDONLY);
+    if (this->fileDescriptor < 0) {
+        throw runtime_error("Can not open " + file + " for mapping: " + strerror(errno));
+    }
+    struct stat fileStatus{};
+    if (fstat(this->fileDescriptor, &fileStatus) != 0) {
+        string error = strerror(errno);
+        this->close();
+        throw runtime_error("Can not determine the size of " + file + ": " + error);
+    }
+    this->size = (size_t) fileStatus.st_size;
+    if (this->size == 0) {
+        // nothing to map; an empty file has no frames
+        return;
+    }
+    void *mapping = mmap(nullptr, this->size, PROT_READ, MAP_PRIVATE, this->fileDescriptor, 0);
+    if (mapping == MAP_FAILED) {
+        string error = strerror(errno);
+        this->close();
+        throw runtime_error("Can not map " + file + ": " + error);
+    }
+    this->data = (const uint8_t *) mapping;
+    #else
+    throw runtime_error("Memory mapped recordings are not supported on Windows");
+    #endif
+}
+
+void MappedFile::close() {
+    #ifndef _WIN32
+    if (this->data != nullptr) {
+        munmap((void *) this->data, this->size);
+    }
+    if (this->fileDescriptor >= 0) {
+        ::close(this->fileDescriptor);
+    }
+    #endif
+    this->data = nullptr;
+    this->size = 0;
+    this->fileDescriptor = -1;
+    this->accessAdvised = false;
+}
+
+void MappedFile::advise(MappedFileAccess _access) {
+    if (this->data == nullptr || (this->accessAdvised && this->access == _access)) {
+        return;
+    }
+    #ifndef _WIN32
+    madvise((void *) this->data, this->size, (_access == SEQUENTIAL_ACCESS) ? MADV_SEQUENTIAL : MADV_RANDOM);
+    #endif
+    this->access = _access;
+    this->accessAdvised = true;
+}
+
+bool MappedFile::isOpen() const {
+    return this->fileDescriptor >= 0;
+}
+
+const uint8_t *MappedFile::getData() const {
+    return this->data;
+}
+
+size_t MappedFile::getSize() const {
+    return this->size;
+}
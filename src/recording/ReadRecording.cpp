@@ -3,8 +3,12 @@
 //
 
 #include <RealsenseRecording/recording/ReadRecording.h>
+#include <AndreiUtils/utilsFiles.h>
 #include <AndreiUtils/utilsImages.h>
+#include <algorithm>
 #include <iostream>
+#include <RealsenseRecording/recording/ColorConversion.h>
+#include <RealsenseRecording/recording/DepthConversion.h>
 
 #ifdef OPENCV
 #include <AndreiUtils/utilsOpenCV.h>
@@ -16,17 +20,34 @@ using namespace RealsenseRecording;
 using namespace std;
 
 ReadRecording::ReadRecording(int fileNumber) : Recording(), imageReaderInitialized(false),
-                                               depthReaderInitialized(false) {
+                                               depthReaderInitialized(false), depthCodec(), imageFrameCodec(),
+                                               depthFrameCodec(), index(), nrSegments(1),
+                                               imageSegment(0), depthSegment(0), segmentStartFrames(),
+                                               mappedImageFile(), mappedDepthFile(), mappedImageRecordSize(0),
+                                               mappedDepthRecordSize(0), nextViewFrame(0), nextFrameIndex(0),
+                                               rawDepthBuffer(), rawDepth(false), rawImage(false), yuyvBuffer(),
+                                               depthElementType(DEPTH_DOUBLE),
+                                               alignedDepth(false), depthRegistration(), registeredDepthBuffer(),
+                                               prefetchSize(0), imagePrefetchBuffer(), depthPrefetchBuffer(),
+                                               imagePrefetchThread(), depthPrefetchThread(), prefetchedImages(),
+                                               prefetchedDepths(), nrPrefetchStalls(0) {
     this->setFiles(true, fileNumber);
+    this->imageFrameCodec = FrameCodec::createImageCodec(this->parameters);
+    this->depthFrameCodec = FrameCodec::createDepthCodec(this->parameters, this->depthCodec);
+    this->loadIndex();
 }
 
 ReadRecording::~ReadRecording() {
+    this->stopPrefetching();
     this->releaseImageReader();
     this->releaseDepthReader();
 }
 
 #ifdef OPENCV
 bool ReadRecording::readData(cv::Mat **image, cv::Mat **depth) {
+    if (this->prefetchSize > 0) {
+        return this->readPrefetchedData(image, depth);
+    }
     if ((image != nullptr && !this->imageReaderInitialized) || (depth != nullptr && !this->depthReaderInitialized)) {
         if (image != nullptr) {
             this->initializeImageReader();
@@ -62,6 +83,7 @@ bool ReadRecording::readData(cv::Mat **image, cv::Mat **depth) {
         }
     }
 
+    this->nextFrameIndex++;
     return true;
 }
 
@@ -75,6 +97,9 @@ bool ReadRecording::readData(cv::Mat &image, cv::Mat &depth) {
 #endif
 
 bool ReadRecording::readData(uint8_t **image, uint16_t **depth) {
+    if (this->prefetchSize > 0) {
+        return this->readPrefetchedData(image, -1, depth, -1);
+    }
     if ((image != nullptr && !this->imageReaderInitialized) || (depth != nullptr && !this->depthReaderInitialized)) {
         if (image != nullptr) {
             this->initializeImageReader();
@@ -110,10 +135,15 @@ bool ReadRecording::readData(uint8_t **image, uint16_t **depth) {
         }
     }
 
+    this->nextFrameIndex++;
     return true;
 }
 
-bool ReadRecording::readData(uint8_t **image, double **depth) {
+template<class T>
+bool ReadRecording::readMetersData(uint8_t **image, T **depth) {
+    if (this->prefetchSize > 0) {
+        return this->readPrefetchedMetersData(image, -1, depth, -1);
+    }
     if ((image != nullptr && !this->imageReaderInitialized) || (depth != nullptr && !this->depthReaderInitialized)) {
         if (image != nullptr) {
             this->initializeImageReader();
@@ -129,16 +159,16 @@ bool ReadRecording::readData(uint8_t **image, double **depth) {
     if (image != nullptr) {
         bool imageReadSuccess = this->readImage(image);
         if (!imageReadSuccess) {
-            if (depth && this->readDepth(depth)) {
+            if (depth && this->readMetersDepth(depth)) {
                 cout << "Something is wrong with the serialization... "
                      << "There are no more video frames left but there still are depth frames!" << endl;
             }
-            // assert(!depth || !this->readDepth(depth));
+            // assert(!depth || !this->readMetersDepth(depth));
             return false;
         }
     }
     if (depth != nullptr) {
-        bool depthReadSuccess = this->readDepth(depth);
+        bool depthReadSuccess = this->readMetersDepth(depth);
         if (image && !depthReadSuccess) {
             cout << "Something is wrong with the serialization... "
                  << "There are no more depth frames left but there still are color frames!" << endl;
@@ -149,9 +179,18 @@ bool ReadRecording::readData(uint8_t **image, double **depth) {
         }
     }
 
+    this->nextFrameIndex++;
     return true;
 }
 
+bool ReadRecording::readData(uint8_t **image, double **depth) {
+    return this->readMetersData(image, depth);
+}
+
+bool ReadRecording::readData(uint8_t **image, float **depth) {
+    return this->readMetersData(image, depth);
+}
+
 bool ReadRecording::readData(uint8_t *image, uint16_t *depth) {
     return this->readData(&image, &depth);
 }
@@ -160,7 +199,14 @@ bool ReadRecording::readData(uint8_t *image, double *depth) {
     return this->readData(&image, &depth);
 }
 
+bool ReadRecording::readData(uint8_t *image, float *depth) {
+    return this->readData(&image, &depth);
+}
+
 bool ReadRecording::readData(uint8_t **image, int imageSize, uint16_t **depth, int depthSize) {
+    if (this->prefetchSize > 0) {
+        return this->readPrefetchedData(image, imageSize, depth, depthSize);
+    }
     if ((image != nullptr && !this->imageReaderInitialized) || (depth != nullptr && !this->depthReaderInitialized)) {
         if (image != nullptr) {
             this->initializeImageReader();
@@ -196,10 +242,15 @@ bool ReadRecording::readData(uint8_t **image, int imageSize, uint16_t **depth, i
         }
     }
 
+    this->nextFrameIndex++;
     return true;
 }
 
-bool ReadRecording::readData(uint8_t **image, int imageSize, double **depth, int depthSize) {
+template<class T>
+bool ReadRecording::readMetersData(uint8_t **image, int imageSize, T **depth, int depthSize) {
+    if (this->prefetchSize > 0) {
+        return this->readPrefetchedMetersData(image, imageSize, depth, depthSize);
+    }
     if ((image != nullptr && !this->imageReaderInitialized) || (depth != nullptr && !this->depthReaderInitialized)) {
         if (image != nullptr) {
             this->initializeImageReader();
@@ -215,7 +266,7 @@ bool ReadRecording::readData(uint8_t **image, int imageSize, double **depth, int
     if (image != nullptr) {
         bool imageReadSuccess = this->readImage(image, imageSize);
         if (!imageReadSuccess) {
-            if (depth && this->readDepth(depth, depthSize)) {
+            if (depth && this->readMetersDepth(depth, depthSize)) {
                 cout << "Something is wrong with the serialization... "
                      << "There are no more video frames left but there still are depth frames!" << endl;
             }
@@ -224,7 +275,7 @@ bool ReadRecording::readData(uint8_t **image, int imageSize, double **depth, int
         }
     }
     if (depth != nullptr) {
-        bool depthReadSuccess = this->readDepth(depth, depthSize);
+        bool depthReadSuccess = this->readMetersDepth(depth, depthSize);
         if (image && !depthReadSuccess) {
             cout << "Something is wrong with the serialization... "
                  << "There are no more depth frames left but there still are color frames!" << endl;
@@ -235,9 +286,18 @@ bool ReadRecording::readData(uint8_t **image, int imageSize, double **depth, int
         }
     }
 
+    this->nextFrameIndex++;
     return true;
 }
 
+bool ReadRecording::readData(uint8_t **image, int imageSize, double **depth, int depthSize) {
+    return this->readMetersData(image, imageSize, depth, depthSize);
+}
+
+bool ReadRecording::readData(uint8_t **image, int imageSize, float **depth, int depthSize) {
+    return this->readMetersData(image, imageSize, depth, depthSize);
+}
+
 bool ReadRecording::readData(uint8_t *image, int imageSize, uint16_t *depth, int depthSize) {
     return this->readData(&image, imageSize, &depth, depthSize);
 }
@@ -246,148 +306,871 @@ bool ReadRecording::readData(uint8_t *image, int imageSize, double *depth, int d
     return this->readData(&image, imageSize, &depth, depthSize);
 }
 
+bool ReadRecording::readData(uint8_t *image, int imageSize, float *depth, int depthSize) {
+    return this->readData(&image, imageSize, &depth, depthSize);
+}
+
 #ifdef OPENCV
 bool ReadRecording::readImage(cv::Mat **image) {
-    if (this->parameters.imageFormat == "avi") {
-        *this->imageReader >> **image;
-        return !(**image).empty();
-    } else if (this->parameters.imageFormat == "bin") {
-        return matReadBinary(this->imageReaderBinary, *image);
+    if (this->parameters.imagePixelFormat == IMAGE_YUYV) {
+        (**image).create(this->parameters.height, this->parameters.width, this->rawImage ? CV_8UC2 : CV_8UC3);
+        return this->readYuyvImage((**image).data, true);
     }
-    throw runtime_error("Unknown image format: \"" + this->parameters.imageFormat + "\"");
+    if (!this->prepareImageRead()) {
+        return false;
+    }
+    if (this->imageFrameCodec != nullptr) {
+        return this->imageFrameCodec->read(this->imageReaderBinary, **image);
+    }
+    *this->imageReader >> **image;
+    return !(**image).empty();
 }
 
 bool ReadRecording::readDepth(cv::Mat **depth) {
-    if (this->parameters.depthFormat == "bin") {
-        bool readSuccess = matReadBinary(this->depthReaderBinary, *depth);
-        if (!readSuccess) {
+    int height = this->getDepthHeight(), width = this->getDepthWidth();
+    if (this->rawDepth) {
+        // keeps the allocation of depth from frame to frame
+        (**depth).create(height, width, CV_16UC1);
+        auto *depthData = (**depth).ptr<uint16_t>();
+        return this->readDepth(&depthData, height * width);
+    }
+    // converted out of the reader's buffers instead of in place, which would change depth's type twice per frame
+    const uint16_t *depthInUnits;
+    if (this->isRegisteringDepth()) {
+        this->registeredDepthBuffer.resize((size_t) height * width);
+        if (!this->readRegisteredDepth(this->registeredDepthBuffer.data())) {
             return false;
         }
-        if ((**depth).type() == CV_16U) {
-            convertDepthToMetersDouble64(*depth);
+        depthInUnits = this->registeredDepthBuffer.data();
+    } else {
+        if (!this->readRawDepth(height * width)) {
+            return false;
         }
-        return true;
+        depthInUnits = this->rawDepthBuffer.data();
     }
-    throw runtime_error("Unknown depth format: \"" + this->parameters.depthFormat + "\"");
+    cv::Mat(height, width, CV_16UC1, (void *) depthInUnits).convertTo(**depth, this->getMetersDepthMatType(),
+                                                                      this->parameters.depthUnits);
+    return true;
 }
 #endif
 
 bool ReadRecording::readImage(uint8_t **image) {
-    if (this->parameters.imageFormat == "avi") {
-        #ifdef OPENCV
-        cv::Mat mat;
-        *this->imageReader >> mat;
-        if (mat.empty()) {
-            return false;
+    if (this->parameters.imagePixelFormat == IMAGE_YUYV) {
+        if (*image == nullptr) {
+            *image = new uint8_t[this->getImageSize()];
         }
-        size_t imageSize = matByteSize(mat);
-        delete[] *image;
+        return this->readYuyvImage(*image, false);
+    }
+    if (!this->prepareImageRead()) {
+        return false;
+    }
+    if (this->imageFrameCodec != nullptr) {
+        if (*image == nullptr) {
+            *image = new uint8_t[this->imageFrameCodec->getNrBytes()];
+        }
+        return this->imageFrameCodec->read(this->imageReaderBinary, *image);
+    }
+    #ifdef OPENCV
+    *this->imageReader >> this->decodedImage;
+    if (this->decodedImage.empty()) {
+        return false;
+    }
+    size_t imageSize = matByteSize(this->decodedImage);
+    if (*image == nullptr) {
         *image = new uint8_t[imageSize];
-        fastMemCopy(*image, mat.data, imageSize);
-        return true;
-        #else
-        throw runtime_error("Can not read image in avi format when opencv is not enabled");
-        #endif
-    } else if (this->parameters.imageFormat == "bin") {
-        StandardTypes imageType;
-        bool readSuccess = readColorImageBinary(this->imageReaderBinary, *image, this->parameters.height,
-                                                this->parameters.width, imageType);
-        assert (imageType == AndreiUtils::StandardTypes::TYPE_UINT_8);
-        return readSuccess;
     }
-    throw runtime_error("Unknown image format: \"" + this->parameters.imageFormat + "\"");
+    fastMemCopy(*image, this->decodedImage.data, imageSize);
+    return true;
+    #else
+    throw runtime_error("Can not read image in avi format when opencv is not enabled");
+    #endif
 }
 
 bool ReadRecording::readDepth(uint16_t **depth) {
-    if (this->parameters.depthFormat == "bin") {
-        bool readSuccess = readDepthImageBinary(this->depthReaderBinary, *depth, this->parameters.height,
-                                                this->parameters.width);
-        if (!readSuccess) {
-            return false;
+    if (this->isRegisteringDepth()) {
+        if (*depth == nullptr) {
+            *depth = new uint16_t[this->parameters.height * this->parameters.width];
         }
-        return true;
+        return this->readRegisteredDepth(*depth);
     }
-    throw runtime_error("Unknown depth format: \"" + this->parameters.depthFormat + "\"");
+    if (!this->prepareDepthRead()) {
+        return false;
+    }
+    if (*depth == nullptr) {
+        *depth = new uint16_t[this->parameters.getDepthHeight() * this->parameters.getDepthWidth()];
+    }
+    return this->depthFrameCodec->read(this->depthReaderBinary, (uint8_t *) *depth);
 }
 
-bool ReadRecording::readDepth(double **depth) {
-    if (this->parameters.depthFormat == "bin") {
-        bool readSuccess = readDepthImageBinary(this->depthReaderBinary, *depth, this->parameters.height,
-                                                this->parameters.width);
-        if (!readSuccess) {
+template<class T>
+bool ReadRecording::readMetersDepth(T **depth) {
+    int depthSize = this->getDepthHeight() * this->getDepthWidth();
+    const uint16_t *depthInUnits;
+    if (this->isRegisteringDepth()) {
+        this->registeredDepthBuffer.resize(depthSize);
+        if (!this->readRegisteredDepth(this->registeredDepthBuffer.data())) {
             return false;
         }
-        return true;
+        depthInUnits = this->registeredDepthBuffer.data();
+    } else {
+        if (!this->readRawDepth(depthSize)) {
+            return false;
+        }
+        depthInUnits = this->rawDepthBuffer.data();
     }
-    throw runtime_error("Unknown depth format: \"" + this->parameters.depthFormat + "\"");
+    if (*depth == nullptr) {
+        *depth = new T[depthSize];
+    }
+    this->convertRawDepthToMeters(depthInUnits, *depth, depthSize);
+    return true;
 }
 
 bool ReadRecording::readImage(uint8_t **image, int imageSize) {
-    if (this->parameters.imageFormat == "avi") {
-        #ifdef OPENCV
-        cv::Mat mat;
-        *this->imageReader >> mat;
-        if (mat.empty()) {
+    if (this->parameters.imagePixelFormat == IMAGE_YUYV) {
+        assert (imageSize == this->getImageSize());
+        return this->readYuyvImage(*image, false);
+    }
+    if (!this->prepareImageRead()) {
+        return false;
+    }
+    if (this->imageFrameCodec != nullptr) {
+        assert ((size_t) imageSize == this->imageFrameCodec->getNrBytes());
+        return this->imageFrameCodec->read(this->imageReaderBinary, *image);
+    }
+    #ifdef OPENCV
+    *this->imageReader >> this->decodedImage;
+    if (this->decodedImage.empty()) {
+        return false;
+    }
+    assert (matByteSize(this->decodedImage) == (size_t) imageSize);
+    fastMemCopy(*image, this->decodedImage.data, imageSize);
+    return true;
+    #else
+    throw runtime_error("Can not read image in avi format when opencv is not enabled");
+    #endif
+}
+
+bool ReadRecording::readRecordedImage(uint8_t *image) {
+    if (this->imageFrameCodec == nullptr) {
+        return this->readImage(&image, this->getRecordedImageSize());
+    }
+    if (!this->prepareImageRead()) {
+        return false;
+    }
+    // YUYV included: the codec has the recorded pixel layout
+    return this->imageFrameCodec->read(this->imageReaderBinary, image);
+}
+
+bool ReadRecording::readYuyvImage(uint8_t *image, bool bgr) {
+    if (this->rawImage) {
+        return this->readRecordedImage(image);
+    }
+    this->yuyvBuffer.resize((size_t) this->parameters.height * this->parameters.width);
+    if (!this->readRecordedImage((uint8_t *) this->yuyvBuffer.data())) {
+        return false;
+    }
+    this->convertYuyvImage((const uint8_t *) this->yuyvBuffer.data(), image, bgr);
+    return true;
+}
+
+bool ReadRecording::isConvertingImage() const {
+    return this->parameters.imagePixelFormat == IMAGE_YUYV && !this->rawImage;
+}
+
+void ReadRecording::convertYuyvImage(const uint8_t *yuyv, uint8_t *image, bool bgr) const {
+    // the recorded rows are not padded and have an even width: the image converts as one row
+    size_t nrPixels = (size_t) this->parameters.height * this->parameters.width;
+    if (bgr) {
+        ColorConversion::yuyvToBgr(yuyv, image, nrPixels);
+    } else {
+        ColorConversion::yuyvToRgb(yuyv, image, nrPixels);
+    }
+}
+
+int ReadRecording::getRecordedImageSize() const {
+    return this->parameters.getImageBytesPerPixel() * this->parameters.height * this->parameters.width;
+}
+
+bool ReadRecording::readDepth(uint16_t **depth, int depthSize) {
+    if (this->isRegisteringDepth()) {
+        assert (depthSize == this->parameters.height * this->parameters.width);
+        return this->readRegisteredDepth(*depth);
+    }
+    if (!this->prepareDepthRead()) {
+        return false;
+    }
+    assert ((size_t) depthSize * sizeof(uint16_t) == this->depthFrameCodec->getNrBytes());
+    return this->depthFrameCodec->read(this->depthReaderBinary, (uint8_t *) *depth);
+}
+
+template<class T>
+bool ReadRecording::readMetersDepth(T **depth, int depthSize) {
+    if (this->isRegisteringDepth()) {
+        assert (depthSize == this->parameters.height * this->parameters.width);
+        this->registeredDepthBuffer.resize(depthSize);
+        if (!this->readRegisteredDepth(this->registeredDepthBuffer.data())) {
             return false;
         }
-        assert (matByteSize(mat) == (size_t) imageSize);
-        fastMemCopy(*image, mat.data, imageSize);
+        this->convertRawDepthToMeters(this->registeredDepthBuffer.data(), *depth, depthSize);
         return true;
+    }
+    if (!this->readRawDepth(depthSize)) {
+        return false;
+    }
+    this->convertRawDepthToMeters(this->rawDepthBuffer.data(), *depth, depthSize);
+    return true;
+}
+
+bool ReadRecording::readRawDepth(int depthSize) {
+    if (!this->prepareDepthRead()) {
+        return false;
+    }
+    if ((int) this->rawDepthBuffer.size() != depthSize) {
+        this->rawDepthBuffer.resize(depthSize);
+    }
+    return this->depthFrameCodec->read(this->depthReaderBinary, (uint8_t *) this->rawDepthBuffer.data());
+}
+
+bool ReadRecording::isRegisteringDepth() const {
+    return this->alignedDepth && this->parameters.hasUnalignedDepth();
+}
+
+bool ReadRecording::readRegisteredDepth(uint16_t *registered) {
+    if (!this->readRawDepth(this->parameters.getDepthHeight() * this->parameters.getDepthWidth())) {
+        return false;
+    }
+    this->depthRegistration.registerDepth(this->rawDepthBuffer.data(), registered);
+    return true;
+}
+
+bool ReadRecording::prepareImageRead() {
+    while (true) {
+        bool lastSegment = this->imageSegment + 1 >= this->nrSegments;
+        if (this->isContainer()) {
+            if (RecordingContainer::enterChunk(this->imageReaderBinary, IMAGE_CHUNK)) {
+                return true;
+            } else if (lastSegment) {
+                return false;
+            }
+        } else if (lastSegment || !this->isImageSegmentEnd()) {
+            return true;
+        }
+        this->openImageSegment(this->imageSegment + 1);
+    }
+}
+
+bool ReadRecording::prepareDepthRead() {
+    while (true) {
+        bool lastSegment = this->depthSegment + 1 >= this->nrSegments;
+        if (this->isContainer()) {
+            if (RecordingContainer::enterChunk(this->depthReaderBinary, DEPTH_CHUNK)) {
+                return true;
+            } else if (lastSegment) {
+                return false;
+            }
+        } else if (lastSegment || this->depthReaderBinary->peek() != ifstream::traits_type::eof()) {
+            return true;
+        }
+        this->openDepthSegment(this->depthSegment + 1);
+    }
+}
+
+bool ReadRecording::isImageSegmentEnd() const {
+    if (this->imageFrameCodec == nullptr) {
+        #ifdef OPENCV
+        return this->imageReader->get(cv::CAP_PROP_POS_FRAMES) >= this->imageReader->get(cv::CAP_PROP_FRAME_COUNT);
         #else
         throw runtime_error("Can not read image in avi format when opencv is not enabled");
         #endif
-    } else if (this->parameters.imageFormat == "bin") {
-        StandardTypes imageType;
-        bool readSuccess = readColorImageBinary(this->imageReaderBinary, *image, this->parameters.height,
-                                                this->parameters.width, imageType, imageSize);
-        assert (imageType == AndreiUtils::StandardTypes::TYPE_UINT_8);
-        return readSuccess;
     }
-    throw runtime_error("Unknown image format: \"" + this->parameters.imageFormat + "\"");
+    return this->imageReaderBinary->peek() == ifstream::traits_type::eof();
 }
 
-bool ReadRecording::readDepth(uint16_t **depth, int depthSize) {
-    if (this->parameters.depthFormat == "bin") {
-        bool readSuccess = readDepthImageBinary(this->depthReaderBinary, *depth, this->parameters.height,
-                                                this->parameters.width, depthSize);
-        if (!readSuccess) {
-            return false;
+void ReadRecording::openImageSegment(int segment) {
+    this->releaseImageReader();
+    this->imageSegment = segment;
+    this->initializeImageReader();
+}
+
+void ReadRecording::openDepthSegment(int segment) {
+    this->releaseDepthReader();
+    this->depthSegment = segment;
+    this->initializeDepthReader();
+}
+
+bool ReadRecording::hasSegment(int segment) const {
+    if (this->isContainer()) {
+        return fileExists(Recording::getSegmentFile(this->parameterFile, segment));
+    }
+    return fileExists(Recording::getSegmentFile(this->imageFile, segment)) &&
+           fileExists(Recording::getSegmentFile(this->depthFile, segment));
+}
+
+void ReadRecording::loadIndex() {
+    this->nrSegments = 1;
+    while (this->hasSegment(this->nrSegments)) {
+        this->nrSegments++;
+    }
+    this->index.clear();
+    this->segmentStartFrames.clear();
+    RecordingIndex segmentIndex;
+    for (int segment = 0; segment < this->nrSegments; segment++) {
+        if (this->isContainer()) {
+            RecordingContainer::loadIndex(Recording::getSegmentFile(this->parameterFile, segment), segmentIndex);
+        } else {
+            string segmentIndexFile = Recording::getSegmentFile(this->indexFile, segment);
+            if (!fileExists(segmentIndexFile)) {
+                // the frames of the following segments can not be numbered
+                this->index.clear();
+                this->segmentStartFrames.clear();
+                return;
+            }
+            segmentIndex.load(segmentIndexFile);
+        }
+        this->segmentStartFrames.push_back(this->index.getNrFrames());
+        for (int i = 0; i < segmentIndex.getNrFrames(); i++) {
+            this->index.addEntry(segmentIndex.getEntry(i));
         }
-        return true;
     }
-    throw runtime_error("Unknown depth format: \"" + this->parameters.depthFormat + "\"");
 }
 
-bool ReadRecording::readDepth(double **depth, int depthSize) {
-    if (this->parameters.depthFormat == "bin") {
-        bool readSuccess = readDepthImageBinary(this->depthReaderBinary, *depth, this->parameters.height,
-                                                this->parameters.width, depthSize);
-        if (!readSuccess) {
+int ReadRecording::getSegmentOfFrame(int frameIndex) const {
+    auto next = upper_bound(this->segmentStartFrames.begin(), this->segmentStartFrames.end(), frameIndex);
+    return (int) (next - this->segmentStartFrames.begin()) - 1;
+}
+
+template<class T>
+void ReadRecording::convertRawDepthToMeters(const uint16_t *rawDepth, T *depth, int depthSize) const {
+    // the conversion to meters is only done here, on demand: the recordings keep the sensor's uint16 depth units
+    DepthConversion::toMeters(rawDepth, depth, depthSize, this->parameters.depthUnits);
+}
+
+void ReadRecording::rebuildIndex(int fileNumber) {
+    ReadRecording recording(fileNumber);
+    if (recording.isContainer()) {
+        for (int segment = 0; segment < recording.nrSegments; segment++) {
+            string containerFile = Recording::getSegmentFile(recording.parameterFile, segment);
+            int nrFrames = RecordingContainer::rebuildFooter(containerFile);
+            cout << "Wrote footer index of " << nrFrames << " frames to " << containerFile << endl;
+        }
+        return;
+    }
+    recording.initializeReaders(true, true);
+    const RecordingParameters &p = recording.parameters;
+    bool binaryImage = recording.imageFrameCodec != nullptr;
+    int imageSize = recording.getRecordedImageSize(), depthSize = p.getDepthHeight() * p.getDepthWidth();
+    vector<uint8_t> imageBuffer(binaryImage ? imageSize : 0);
+
+    RecordingIndex rebuiltIndex;
+    int segment = 0;
+    while (true) {
+        FrameIndexEntry entry = FrameIndexEntry::unknown();
+        // the offsets are the ones in the segment's files: only take them after a switch to the next segment
+        if (binaryImage) {
+            if (!recording.prepareImageRead()) {
+                break;
+            }
+            entry.imageOffset = (int64_t) recording.imageReaderBinary->tellg();
+            if (!recording.readRecordedImage(imageBuffer.data())) {
+                break;
+            }
+        }
+        if (!recording.prepareDepthRead()) {
+            break;
+        }
+        if (recording.depthSegment != segment) {
+            string segmentIndexFile = Recording::getSegmentFile(recording.indexFile, segment);
+            rebuiltIndex.save(segmentIndexFile);
+            cout << "Wrote index of " << rebuiltIndex.getNrFrames() << " frames to " << segmentIndexFile << endl;
+            rebuiltIndex.clear();
+            segment = recording.depthSegment;
+        }
+        entry.depthOffset = (int64_t) recording.depthReaderBinary->tellg();
+        if (!recording.readRawDepth(depthSize)) {
+            break;
+        }
+        rebuiltIndex.addEntry(entry);
+    }
+    string segmentIndexFile = Recording::getSegmentFile(recording.indexFile, segment);
+    rebuiltIndex.save(segmentIndexFile);
+    cout << "Wrote index of " << rebuiltIndex.getNrFrames() << " frames to " << segmentIndexFile << endl;
+}
+
+bool ReadRecording::hasIndex() const {
+    return !this->index.empty();
+}
+
+int ReadRecording::getNrSegments() const {
+    return this->nrSegments;
+}
+
+int ReadRecording::getNrFrames() const {
+    if (!this->hasIndex()) {
+        throw runtime_error("The recording has no index: create it with ReadRecording::rebuildIndex!");
+    }
+    return this->index.getNrFrames();
+}
+
+const FrameIndexEntry &ReadRecording::getFrameIndexEntry(int frameIndex) const {
+    return this->index.getEntry(frameIndex);
+}
+
+int ReadRecording::getCurrentFrameIndex() const {
+    return this->nextFrameIndex - 1;
+}
+
+vector<int> ReadRecording::getFrameNumberGaps() const {
+    return this->index.getFrameNumberGaps();
+}
+
+void ReadRecording::seek(int frameIndex) {
+    const FrameIndexEntry &entry = this->index.getEntry(frameIndex);
+    // the prefetcher is restarted from the new position by the next readData call
+    this->stopPrefetching();
+    this->nextFrameIndex = frameIndex;
+    this->initializeReaders(true, true);
+    int segment = this->getSegmentOfFrame(frameIndex);
+    if (this->imageSegment != segment) {
+        this->openImageSegment(segment);
+    }
+    if (this->depthSegment != segment) {
+        this->openDepthSegment(segment);
+    }
+    // the offsets of containers point to the chunk payloads: go to the chunk header for the next readData
+    int64_t chunkHeaderSize = this->isContainer() ? (int64_t) RecordingContainer::CHUNK_HEADER_SIZE : 0;
+
+    if (this->imageFrameCodec == nullptr) {
+        #ifdef OPENCV
+        this->imageReader->set(cv::CAP_PROP_POS_FRAMES, frameIndex - this->segmentStartFrames[segment]);
+        #else
+        throw runtime_error("Can not seek in an image file in avi format when opencv is not enabled");
+        #endif
+    } else if (entry.imageOffset >= 0) {
+        this->imageReaderBinary->clear();
+        this->imageReaderBinary->seekg(entry.imageOffset - chunkHeaderSize);
+    }
+    if (entry.depthOffset >= 0) {
+        this->depthReaderBinary->clear();
+        this->depthReaderBinary->seekg(entry.depthOffset - chunkHeaderSize);
+    }
+}
+
+#ifdef OPENCV
+bool ReadRecording::readFrame(int frameIndex, cv::Mat &image, cv::Mat &depth) {
+    this->seek(frameIndex);
+    return this->readData(image, depth);
+}
+#endif
+
+bool ReadRecording::readFrame(int frameIndex, uint8_t **image, uint16_t **depth) {
+    this->seek(frameIndex);
+    return this->readData(image, depth);
+}
+
+bool ReadRecording::readFrame(int frameIndex, uint8_t **image, double **depth) {
+    this->seek(frameIndex);
+    return this->readData(image, depth);
+}
+
+bool ReadRecording::readFrame(int frameIndex, uint8_t **image, float **depth) {
+    this->seek(frameIndex);
+    return this->readData(image, depth);
+}
+
+bool ReadRecording::readDataView(ImageView *image, DepthView *depth) {
+    if (this->nextViewFrame >= this->getNrFrames()) {
+        return false;
+    }
+    return this->readFrameView(this->nextViewFrame, image, depth);
+}
+
+bool ReadRecording::readFrameView(int frameIndex, ImageView *image, DepthView *depth) {
+    const FrameIndexEntry &entry = this->index.getEntry(frameIndex);
+    this->initializeMappedFiles(image != nullptr, depth != nullptr);
+    MappedFileAccess access = (frameIndex == this->nextViewFrame) ? SEQUENTIAL_ACCESS : RANDOM_ACCESS;
+    this->nextViewFrame = frameIndex + 1;
+
+    int height = this->parameters.height, width = this->parameters.width;
+    // the recorded depth, which is not registered to the image when it is unaligned
+    int depthHeight = this->parameters.getDepthHeight(), depthWidth = this->parameters.getDepthWidth();
+    if (image != nullptr) {
+        // the recorded pixels: YUYV images are viewed as 2 channels
+        int bytesPerPixel = this->parameters.getImageBytesPerPixel();
+        this->mappedImageFile.advise(access);
+        const uint8_t *data = this->getMappedFrame(this->mappedImageFile, entry.imageOffset,
+                                                   this->mappedImageRecordSize,
+                                                   (size_t) bytesPerPixel * height * width);
+        if (data == nullptr) {
             return false;
         }
-        return true;
+        image->data = data;
+        image->height = height;
+        image->width = width;
+        image->channels = bytesPerPixel;
+        image->stride = (size_t) bytesPerPixel * width;
     }
-    throw runtime_error("Unknown depth format: \"" + this->parameters.depthFormat + "\"");
+    if (depth != nullptr) {
+        this->mappedDepthFile.advise(access);
+        const uint8_t *data = this->getMappedFrame(this->mappedDepthFile, entry.depthOffset,
+                                                   this->mappedDepthRecordSize,
+                                                   (size_t) depthHeight * depthWidth * sizeof(uint16_t));
+        if (data == nullptr) {
+            return false;
+        }
+        depth->data = (const uint16_t *) data;
+        depth->height = depthHeight;
+        depth->width = depthWidth;
+        depth->channels = 1;
+        depth->stride = (size_t) depthWidth;
+    }
+    return true;
+}
+
+void ReadRecording::setPrefetchSize(int nrFrames) {
+    if (nrFrames < 0) {
+        throw runtime_error("Can not prefetch a negative number of frames! Was " + to_string(nrFrames));
+    }
+    if (this->imagePrefetchThread.joinable()) {
+        throw runtime_error("Can not change the prefetch size after the prefetching started!");
+    }
+    this->prefetchSize = nrFrames;
+}
+
+int ReadRecording::getPrefetchSize() const {
+    return this->prefetchSize;
+}
+
+int ReadRecording::getNrPrefetchedFrames() const {
+    if (!this->imagePrefetchThread.joinable()) {
+        return 0;
+    }
+    return min(this->imagePrefetchBuffer.size(), this->depthPrefetchBuffer.size());
+}
+
+unsigned long long ReadRecording::getNrPrefetchStalls() const {
+    return this->nrPrefetchStalls;
+}
+
+void ReadRecording::startPrefetching() {
+    this->initializeReaders(true, true);
+    this->imagePrefetchBuffer.reset(this->prefetchSize);
+    this->depthPrefetchBuffer.reset(this->prefetchSize);
+    int nrSlots = this->imagePrefetchBuffer.getNrSlots();
+    size_t nrDepthPixels = (size_t) this->getDepthHeight() * this->getDepthWidth();
+    if ((int) this->prefetchedImages.size() != nrSlots) {
+        this->prefetchedImages.assign(nrSlots, vector<uint8_t>(this->getRecordedImageSize()));
+        this->prefetchedDepths.assign(nrSlots, vector<uint16_t>(nrDepthPixels));
+    }
+    this->imagePrefetchThread = thread(&ReadRecording::imagePrefetchThreadRead, this);
+    this->depthPrefetchThread = thread(&ReadRecording::depthPrefetchThreadRead, this);
+}
+
+void ReadRecording::stopPrefetching() {
+    if (!this->imagePrefetchThread.joinable()) {
+        return;
+    }
+    this->imagePrefetchBuffer.close();
+    this->depthPrefetchBuffer.close();
+    this->imagePrefetchThread.join();
+    this->depthPrefetchThread.join();
+}
+
+void ReadRecording::imagePrefetchThreadRead() {
+    bool droppedOldest;
+    int slot;
+    while ((slot = this->imagePrefetchBuffer.acquireWriteSlot(BLOCK_WHEN_FULL, droppedOldest)) >= 0) {
+        if (!this->readRecordedImage(this->prefetchedImages[slot].data())) {
+            break;
+        }
+        this->imagePrefetchBuffer.publishWriteSlot();
+    }
+    // lets the consumer drain the decoded frames and then see the end of the recording
+    this->imagePrefetchBuffer.close();
+}
+
+void ReadRecording::depthPrefetchThreadRead() {
+    int depthSize = this->getDepthHeight() * this->getDepthWidth();
+    bool droppedOldest;
+    int slot;
+    // a thread of its own, so that the "rvl" decoder gets the whole OpenMP team for every frame
+    while ((slot = this->depthPrefetchBuffer.acquireWriteSlot(BLOCK_WHEN_FULL, droppedOldest)) >= 0) {
+        uint16_t *depth = this->prefetchedDepths[slot].data();
+        if (!this->readDepth(&depth, depthSize)) {
+            break;
+        }
+        this->depthPrefetchBuffer.publishWriteSlot();
+    }
+    this->depthPrefetchBuffer.close();
+}
+
+bool ReadRecording::acquirePrefetchedFrame(int &imageSlot, int &depthSlot) {
+    if (!this->imagePrefetchThread.joinable()) {
+        this->startPrefetching();
+    }
+    if ((this->imagePrefetchBuffer.size() == 0 && !this->imagePrefetchBuffer.isClosed()) ||
+        (this->depthPrefetchBuffer.size() == 0 && !this->depthPrefetchBuffer.isClosed())) {
+        this->nrPrefetchStalls++;
+    }
+    imageSlot = this->imagePrefetchBuffer.acquireReadSlot();
+    depthSlot = this->depthPrefetchBuffer.acquireReadSlot();
+    bool imageReadSuccess = imageSlot >= 0, depthReadSuccess = depthSlot >= 0;
+    if (!imageReadSuccess || !depthReadSuccess) {
+        if (imageReadSuccess != depthReadSuccess) {
+            cout << "Something is wrong with the serialization... "
+                 << "There are no more " << (imageReadSuccess ? "depth" : "video") << " frames left but there "
+                 << "still are " << (imageReadSuccess ? "color" : "depth") << " frames!" << endl;
+        }
+        return false;
+    }
+    this->nextFrameIndex++;
+    return true;
+}
+
+#ifdef OPENCV
+bool ReadRecording::readPrefetchedData(cv::Mat **image, cv::Mat **depth) {
+    int imageSlot, depthSlot;
+    if (!this->acquirePrefetchedFrame(imageSlot, depthSlot)) {
+        return false;
+    }
+    int height = this->parameters.height, width = this->parameters.width;
+    if (image != nullptr && this->isConvertingImage()) {
+        (**image).create(height, width, CV_8UC3);
+        this->convertYuyvImage(this->prefetchedImages[imageSlot].data(), (**image).data, true);
+    } else if (image != nullptr) {
+        int imageType = (this->parameters.imagePixelFormat == IMAGE_YUYV) ? CV_8UC2 : CV_8UC3;
+        cv::Mat(height, width, imageType, this->prefetchedImages[imageSlot].data()).copyTo(**image);
+    }
+    if (depth != nullptr) {
+        cv::Mat rawDepthMat(this->getDepthHeight(), this->getDepthWidth(), CV_16UC1,
+                            this->prefetchedDepths[depthSlot].data());
+        if (this->rawDepth) {
+            rawDepthMat.copyTo(**depth);
+        } else {
+            rawDepthMat.convertTo(**depth, this->getMetersDepthMatType(), this->parameters.depthUnits);
+        }
+    }
+    return true;
+}
+#endif
+
+bool ReadRecording::readPrefetchedData(uint8_t **image, int imageSize, uint16_t **depth, int depthSize) {
+    int imageSlot, depthSlot;
+    if (!this->acquirePrefetchedFrame(imageSlot, depthSlot)) {
+        return false;
+    }
+    if (image != nullptr) {
+        this->readPrefetchedImage(imageSlot, image, imageSize);
+    }
+    if (depth != nullptr) {
+        const vector<uint16_t> &prefetchedDepth = this->prefetchedDepths[depthSlot];
+        if (depthSize < 0) {
+            depthSize = (int) prefetchedDepth.size();
+            if (*depth == nullptr) {
+                *depth = new uint16_t[depthSize];
+            }
+        }
+        assert ((size_t) depthSize == prefetchedDepth.size());
+        fastMemCopy(*depth, prefetchedDepth.data(), depthSize);
+    }
+    return true;
+}
+
+void ReadRecording::readPrefetchedImage(int slot, uint8_t **image, int imageSize) {
+    if (imageSize < 0) {
+        imageSize = this->getImageSize();
+        if (*image == nullptr) {
+            *image = new uint8_t[imageSize];
+        }
+    }
+    assert (imageSize == this->getImageSize());
+    if (this->isConvertingImage()) {
+        this->convertYuyvImage(this->prefetchedImages[slot].data(), *image, false);
+        return;
+    }
+    fastMemCopy(*image, this->prefetchedImages[slot].data(), imageSize);
+}
+
+template<class T>
+bool ReadRecording::readPrefetchedMetersData(uint8_t **image, int imageSize, T **depth,
+                                             int depthSize) {
+    int imageSlot, depthSlot;
+    if (!this->acquirePrefetchedFrame(imageSlot, depthSlot)) {
+        return false;
+    }
+    if (image != nullptr) {
+        this->readPrefetchedImage(imageSlot, image, imageSize);
+    }
+    if (depth != nullptr) {
+        const vector<uint16_t> &prefetchedDepth = this->prefetchedDepths[depthSlot];
+        if (depthSize < 0) {
+            depthSize = (int) prefetchedDepth.size();
+            if (*depth == nullptr) {
+                *depth = new T[depthSize];
+            }
+        }
+        assert ((size_t) depthSize == prefetchedDepth.size());
+        this->convertRawDepthToMeters(prefetchedDepth.data(), *depth, depthSize);
+    }
+    return true;
+}
+
+void ReadRecording::setRawDepth(bool _rawDepth) {
+    this->rawDepth = _rawDepth;
+}
+
+bool ReadRecording::isRawDepth() const {
+    return this->rawDepth;
+}
+
+void ReadRecording::setRawImage(bool _rawImage) {
+    this->rawImage = _rawImage;
+}
+
+bool ReadRecording::isRawImage() const {
+    return this->rawImage;
+}
+
+int ReadRecording::getImageSize() const {
+    return this->isConvertingImage() ? 3 * this->parameters.height * this->parameters.width :
+           this->getRecordedImageSize();
+}
+
+void ReadRecording::setDepthElementType(DepthElementType type) {
+    this->depthElementType = type;
+}
+
+DepthElementType ReadRecording::getDepthElementType() const {
+    return this->depthElementType;
+}
+
+void ReadRecording::setAlignedDepth(bool _alignedDepth) {
+    if (this->imagePrefetchThread.joinable()) {
+        throw runtime_error("Can not change the depth alignment after the prefetching started!");
+    }
+    this->alignedDepth = _alignedDepth;
+    if (this->isRegisteringDepth() && !this->depthRegistration.isInitialized()) {
+        this->depthRegistration.setParameters(this->parameters.getDepthIntrinsics(), this->parameters.getIntrinsics(),
+                                              this->parameters.getDepthToColorExtrinsics(),
+                                              this->parameters.depthUnits);
+    }
+}
+
+bool ReadRecording::isAlignedDepth() const {
+    return this->alignedDepth;
+}
+
+int ReadRecording::getDepthHeight() const {
+    return this->alignedDepth ? this->parameters.height : this->parameters.getDepthHeight();
+}
+
+int ReadRecording::getDepthWidth() const {
+    return this->alignedDepth ? this->parameters.width : this->parameters.getDepthWidth();
+}
+
+#ifdef OPENCV
+int ReadRecording::getMetersDepthMatType() const {
+    return (this->depthElementType == DEPTH_FLOAT) ? CV_32F : CV_64F;
+}
+#endif
+
+void ReadRecording::initializeReaders(bool withImage, bool withDepth) {
+    if (withImage && !this->imageReaderInitialized) {
+        this->initializeImageReader();
+        this->imageReaderInitialized = true;
+    }
+    if (withDepth && !this->depthReaderInitialized) {
+        this->initializeDepthReader();
+        this->depthReaderInitialized = true;
+    }
+}
+
+void ReadRecording::initializeMappedFiles(bool withImage, bool withDepth) {
+    if (!this->hasIndex()) {
+        throw runtime_error("Can not map a recording without index: create it with ReadRecording::rebuildIndex!");
+    }
+    if (this->nrSegments > 1) {
+        throw runtime_error("Can not map a recording of " + to_string(this->nrSegments) + " segments!");
+    }
+    if (withImage && !this->mappedImageFile.isOpen()) {
+        if (this->parameters.imageFormat != "bin") {
+            throw runtime_error("Can only map images in \"bin\" format, not \"" + this->parameters.imageFormat + "\"");
+        }
+        this->mappedImageFile.open(this->imageFile);
+        this->mappedImageRecordSize = this->getMappedRecordSize(this->mappedImageFile, true);
+    }
+    if (withDepth && !this->mappedDepthFile.isOpen()) {
+        if (this->parameters.depthFormat != "bin") {
+            throw runtime_error("Can only map depth in \"bin\" format, not \"" + this->parameters.depthFormat + "\"");
+        }
+        this->mappedDepthFile.open(this->depthFile);
+        this->mappedDepthRecordSize = this->getMappedRecordSize(this->mappedDepthFile, false);
+    }
+}
+
+size_t ReadRecording::getMappedRecordSize(const MappedFile &file, bool image) const {
+    // the frames of a file all have the same size: the distance between the first two of them
+    int64_t first = -1, second = -1;
+    for (int i = 0; i < this->index.getNrFrames() && second < 0; i++) {
+        const FrameIndexEntry &entry = this->index.getEntry(i);
+        int64_t offset = image ? entry.imageOffset : entry.depthOffset;
+        if (offset < 0) {
+            continue;
+        }
+        if (first < 0) {
+            first = offset;
+        } else {
+            second = offset;
+        }
+    }
+    if (first < 0) {
+        return 0;
+    }
+    if (this->isContainer()) {
+        // the frames of the streams are interleaved: the chunk header has the record size
+        return (file.getData() != nullptr) ? (size_t) RecordingContainer::getPayloadSize(file.getData(), first) : 0;
+    }
+    return (size_t) (((second >= 0) ? second : (int64_t) file.getSize()) - first);
+}
+
+const uint8_t *ReadRecording::getMappedFrame(const MappedFile &file, int64_t offset, size_t recordSize,
+                                             size_t dataSize) const {
+    if (offset < 0 || (size_t) offset + recordSize > file.getSize()) {
+        return nullptr;
+    }
+    if (recordSize < dataSize) {
+        throw runtime_error("Frame records of " + to_string(recordSize) + " bytes can not hold frames of " +
+                            to_string(dataSize) + " bytes!");
+    }
+    // the pixel data is at the end of each frame record, after its header
+    return file.getData() + offset + (recordSize - dataSize);
 }
 
 void ReadRecording::initializeImageReader() {
     if (this->parameters.imageFormat == "avi") {
         #ifdef OPENCV
-        this->imageReader = new cv::VideoCapture(this->imageFile);
+        this->imageReader = new cv::VideoCapture(Recording::getSegmentFile(this->imageFile, this->imageSegment));
         return;
         #else
         throw runtime_error("Can not initialize the image reader in \"avi\" format without opencv enabled");
         #endif
     } else if (this->parameters.imageFormat == "bin") {
-        this->imageReaderBinary = new ifstream(this->imageFile, fstream::binary);
+        string segmentFile = Recording::getSegmentFile(this->imageFile, this->imageSegment);
+        this->imageReaderBinary = new ifstream(segmentFile, fstream::binary);
+        if (this->isContainer()) {
+            RecordingContainer::skipHeader(this->imageReaderBinary, segmentFile);
+        }
         return;
     }
     throw runtime_error("Unknown image format: \"" + this->parameters.imageFormat + "\"");
 }
 
 void ReadRecording::initializeDepthReader() {
-    if (this->parameters.depthFormat == "bin") {
-        this->depthReaderBinary = new ifstream(this->depthFile, fstream::binary);
+    if (this->parameters.depthFormat == "bin" || this->parameters.depthFormat == "rvl") {
+        string segmentFile = Recording::getSegmentFile(this->depthFile, this->depthSegment);
+        this->depthReaderBinary = new ifstream(segmentFile, fstream::binary);
+        if (this->isContainer()) {
+            RecordingContainer::skipHeader(this->depthReaderBinary, segmentFile);
+        }
         return;
     }
     throw runtime_error("Unknown depth format: \"" + this->parameters.depthFormat + "\"");
@@ -398,8 +1181,11 @@ void ReadRecording::releaseImageReader() {
         return;
     } else if (this->parameters.imageFormat == "avi") {
         #ifdef OPENCV
-        this->imageReader->release();
+        if (this->imageReader != nullptr) {
+            this->imageReader->release();
+        }
         delete this->imageReader;
+        this->imageReader = nullptr;
         return;
         #endif
     } else if (this->parameters.imageFormat == "bin") {
@@ -407,6 +1193,7 @@ void ReadRecording::releaseImageReader() {
             this->imageReaderBinary->close();
         }
         delete this->imageReaderBinary;
+        this->imageReaderBinary = nullptr;
         return;
     }
     throw runtime_error("Unknown image format: \"" + this->parameters.imageFormat + "\"");
@@ -415,11 +1202,12 @@ void ReadRecording::releaseImageReader() {
 void ReadRecording::releaseDepthReader() {
     if (this->parameters.depthFormat.empty()) {
         return;
-    } else if (this->parameters.depthFormat == "bin") {
+    } else if (this->parameters.depthFormat == "bin" || this->parameters.depthFormat == "rvl") {
         if (this->depthReaderBinary != nullptr) {
             this->depthReaderBinary->close();
         }
         delete this->depthReaderBinary;
+        this->depthReaderBinary = nullptr;
         return;
     }
     throw runtime_error("Unknown depth format: \"" + this->parameters.depthFormat + "\"");
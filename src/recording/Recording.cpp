@@ -41,10 +41,20 @@ string Recording::format(int number, const char *type, const string &format) {
                                 R"(". Accepted are "bin" and "avi")");
         }
     } else if (strcmp(type, "depth") == 0) {
-        if (format != "bin") {
+        if (format != "bin" && format != "rvl") {
             throw runtime_error("At file " + to_string(number) + ": unknown format for depth: \"" + format +
+                                R"(". Accepted are "bin" and "rvl")");
+        }
+    } else if (strcmp(type, "index") == 0) {
+        if (format != "bin") {
+            throw runtime_error("At file " + to_string(number) + ": unknown format for index: \"" + format +
                                 R"(". Accepted is "bin")");
         }
+    } else if (strcmp(type, "container") == 0) {
+        if (format != "rsrec") {
+            throw runtime_error("At file " + to_string(number) + ": unknown format for container: \"" + format +
+                                R"(". Accepted is "rsrec")");
+        }
     } else if (strcmp(type, "parameters") == 0) {
         if (format != "xml" && format != "json") {
             throw runtime_error("At file " + to_string(number) + ": unknown format for parameters: \"" + format +
@@ -59,6 +69,29 @@ string Recording::format(int number, const char *type, const string &format) {
     return outputFileNameBuffer;
 }
 
+string Recording::getSegmentFile(const string &file, int segment) {
+    if (segment == 0) {
+        return file;
+    }
+    size_t extension = file.rfind('.');
+    size_t directory = file.find_last_of("/\\");
+    if (extension == string::npos || (directory != string::npos && extension < directory)) {
+        extension = file.size();
+    }
+    return file.substr(0, extension) + "_seg" + to_string(segment) + file.substr(extension);
+}
+
+void Recording::deleteSegmentFiles(const string &file) {
+    for (int segment = 1;; segment++) {
+        string segmentFile = Recording::getSegmentFile(file, segment);
+        if (!fileExists(segmentFile)) {
+            break;
+        }
+        cout << "Warning: Deleting: " << segmentFile << endl;
+        deleteFile(segmentFile);
+    }
+}
+
 Recording::Recording(const string &imageFormat, const string &depthFormat, const string &parameterFormat,
                      RotationType rotationType) :
         Recording(imageFormat, depthFormat, parameterFormat, nullptr, RecordingParametersType::NO_PARAMETERS,
@@ -68,18 +101,21 @@ Recording::Recording(const string &imageFormat, const string &depthFormat, const
                      const void *parameters, RecordingParametersType parametersType,
                      AndreiUtils::RotationType rotationType) :
         parameters(imageFormat, depthFormat, parameterFormat, parameters, parametersType, rotationType), imageFile(),
-        depthFile(), parameterFile() {}
+        depthFile(), parameterFile(), indexFile() {}
 
 Recording::Recording(double fps, int width, int height, float fx, float fy, float ppx, float ppy,
                      rs2_distortion model, const float *coefficients, const string &imageFormat,
                      const string &depthFormat, const string &parameterFormat, RotationType rotationType) :
         parameters(fps, width, height, fx, fy, ppx, ppy, model, coefficients, imageFormat, depthFormat, parameterFormat,
-                   rotationType), imageFile(), depthFile(), parameterFile() {}
+                   rotationType), imageFile(), depthFile(), parameterFile(), indexFile() {}
 
 Recording::Recording(double fps, rs2_intrinsics intrinsics, const string &imageFormat, const string &depthFormat,
                      const string &parameterFormat, RotationType rotationType) :
         parameters(fps, intrinsics, imageFormat, depthFormat, parameterFormat, rotationType),
-        imageFile(), depthFile(), parameterFile() {}
+        imageFile(), depthFile(), parameterFile(), indexFile() {}
+
+Recording::Recording(RecordingParameters _parameters) :
+        parameters(move(_parameters)), imageFile(), depthFile(), parameterFile(), indexFile() {}
 
 Recording::~Recording() = default;
 
@@ -104,6 +140,14 @@ void Recording::setFiles(bool read, int fileNumber) {
             }
             checkParameterFile = "";
         }
+        if (checkParameterFile.empty()) {
+            // a container holds the parameters together with the frames
+            parameterFileFormat = "rsrec";
+            checkParameterFile = Recording::getOutputDirectory() + Recording::format(i, "container", "rsrec");
+            if (!fileExists(checkParameterFile)) {
+                checkParameterFile = "";
+            }
+        }
         if (read && checkParameterFile.empty()) {
             if (fileNumber >= 0) {
                 throw runtime_error("Can't find parameter file for fileNumber: " + to_string(fileNumber));
@@ -116,12 +160,29 @@ void Recording::setFiles(bool read, int fileNumber) {
                 p.deserialize(checkParameterFile, parameterFileFormat);
                 cout << "Warning: Deleting: " << checkParameterFile << endl;
                 deleteFile(checkParameterFile);
-                cout << "Warning: Deleting: "
-                     << Recording::getOutputDirectory() + Recording::format(fileNumber, "video", p.imageFormat) << endl;
-                deleteFile(Recording::getOutputDirectory() + Recording::format(fileNumber, "video", p.imageFormat));
-                cout << "Warning: Deleting: "
-                     << Recording::getOutputDirectory() + Recording::format(fileNumber, "depth", p.depthFormat) << endl;
-                deleteFile(Recording::getOutputDirectory() + Recording::format(fileNumber, "depth", p.depthFormat));
+                if (parameterFileFormat == "rsrec") {
+                    Recording::deleteSegmentFiles(checkParameterFile);
+                }
+                // a container has no other files
+                if (parameterFileFormat != "rsrec") {
+                    string oldImageFile = Recording::getOutputDirectory() +
+                                          Recording::format(fileNumber, "video", p.imageFormat);
+                    string oldDepthFile = Recording::getOutputDirectory() +
+                                          Recording::format(fileNumber, "depth", p.depthFormat);
+                    cout << "Warning: Deleting: " << oldImageFile << endl;
+                    deleteFile(oldImageFile);
+                    Recording::deleteSegmentFiles(oldImageFile);
+                    cout << "Warning: Deleting: " << oldDepthFile << endl;
+                    deleteFile(oldDepthFile);
+                    Recording::deleteSegmentFiles(oldDepthFile);
+                    string oldIndexFile = Recording::getOutputDirectory() +
+                                          Recording::format(fileNumber, "index", "bin");
+                    if (fileExists(oldIndexFile)) {
+                        cout << "Warning: Deleting: " << oldIndexFile << endl;
+                        deleteFile(oldIndexFile);
+                    }
+                    Recording::deleteSegmentFiles(oldIndexFile);
+                }
             } else {
                 continue;
             }
@@ -129,10 +190,23 @@ void Recording::setFiles(bool read, int fileNumber) {
 
         if (read) {
             this->parameters.deserialize(checkParameterFile, parameterFileFormat);
+        } else if (this->parameters.parametersFormat == "rsrec") {
+            checkParameterFile = Recording::getOutputDirectory() + Recording::format(i, "container", "rsrec");
         } else {
             checkParameterFile = Recording::getOutputDirectory() +
                                  Recording::format(i, "parameters", this->parameters.parametersFormat);
         }
+        if (this->isContainer()) {
+            this->parameterFile = checkParameterFile;
+            this->imageFile = checkParameterFile;
+            this->depthFile = checkParameterFile;
+            this->indexFile = "";
+            foundFiles = true;
+            if (!read || fileNumber >= 0) {
+                break;
+            }
+            continue;
+        }
         checkImageFile = Recording::getOutputDirectory() +
                          Recording::format(i, "video", this->parameters.imageFormat);
         checkDepthFile = Recording::getOutputDirectory() +
@@ -143,6 +217,7 @@ void Recording::setFiles(bool read, int fileNumber) {
                 this->parameterFile = checkParameterFile;
                 this->imageFile = checkImageFile;
                 this->depthFile = checkDepthFile;
+                this->indexFile = Recording::getOutputDirectory() + Recording::format(i, "index", "bin");
                 foundFiles = true;
                 if (fileNumber >= 0) {
                     break;
@@ -154,6 +229,7 @@ void Recording::setFiles(bool read, int fileNumber) {
             this->parameterFile = checkParameterFile;
             this->imageFile = checkImageFile;
             this->depthFile = checkDepthFile;
+            this->indexFile = Recording::getOutputDirectory() + Recording::format(i, "index", "bin");
             break;
         }
     }
@@ -175,3 +251,7 @@ rs2_intrinsics Recording::getIntrinsics() {
 const RecordingParameters *Recording::getParameters() {
     return &this->parameters;
 }
+
+bool Recording::isContainer() const {
+    return this->parameters.parametersFormat == "rsrec";
+}
@@ -0,0 +1,288 @@
+#include <RealsenseRecording/recording/RecordingContainer.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <nlohmann/json.hpp>
+#include <sstream>
+#include <stdexcept>
+
+#ifndef _WIN32
+
+#include <unistd.h>
+
+#endif
+
+using namespace nlohmann;
+using namespace RealsenseRecording;
+using namespace std;
+
+const uint64_t RecordingContainer::CHUNK_HEADER_SIZE;
+const char RecordingContainer::MAGIC[4] = {'R', 'S', 'R', 'C'};
+const char RecordingContainer::END_MAGIC[4] = {'R', 'S', 'R', 'E'};
+const uint32_t RecordingContainer::VERSION = 1;
+const uint64_t RecordingContainer::TRAILER_SIZE = sizeof(int64_t) + sizeof(RecordingContainer::END_MAGIC);
+
+void RecordingContainer::writeHeader(ofstream *out, const RecordingParameters &parameters) {
+    json data;
+    parameters.to_json(data);
+    string parametersJson = data.dump();
+    auto parametersSize = (uint32_t) parametersJson.size();
+    out->write(RecordingContainer::MAGIC, sizeof(RecordingContainer::MAGIC));
+    out->write((const char *) &RecordingContainer::VERSION, sizeof(RecordingContainer::VERSION));
+    out->write((const char *) &parametersSize, sizeof(parametersSize));
+    out->write(parametersJson.data(), parametersSize);
+}
+
+string RecordingContainer::readParametersJson(const string &containerFile) {
+    ifstream in(containerFile, fstream::binary);
+    if (!in.is_open()) {
+        throw runtime_error("Can not open the recording container " + containerFile);
+    }
+    string parametersJson;
+    RecordingContainer::readHeader(in, containerFile, &parametersJson);
+    return parametersJson;
+}
+
+void RecordingContainer::skipHeader(ifstream *in, const string &containerFile) {
+    RecordingContainer::readHeader(*in, containerFile, nullptr);
+}
+
+bool RecordingContainer::enterChunk(istream *in, ContainerChunkType type) {
+    uint32_t chunkType;
+    uint64_t payloadSize;
+    while (RecordingContainer::readChunkHeader(in, chunkType, payloadSize)) {
+        if (chunkType == (uint32_t) type) {
+            return true;
+        } else if (chunkType == FOOTER_CHUNK) {
+            return false;
+        }
+        in->seekg((streamoff) payloadSize, ios::cur);
+    }
+    return false;
+}
+
+bool RecordingContainer::loadIndex(const string &containerFile, RecordingIndex &index) {
+    ifstream in(containerFile, fstream::binary);
+    if (!in.is_open()) {
+        throw runtime_error("Can not open the recording container " + containerFile);
+    }
+    int64_t firstChunk = RecordingContainer::readHeader(in, containerFile, nullptr);
+    if (RecordingContainer::readFooter(in, index)) {
+        return true;
+    }
+    cout << "Warning: the recording container " << containerFile << " was not closed properly; "
+         << "indexing it by its frame chunks" << endl;
+    RecordingContainer::scanChunks(in, firstChunk, index);
+    return false;
+}
+
+void RecordingContainer::writeFooter(ostream *out, const RecordingIndex &index) {
+    ostringstream footer;
+    index.save(&footer);
+    string payload = footer.str();
+    auto footerOffset = (int64_t) out->tellp();
+    RecordingContainer::writeChunkHeader(out, FOOTER_CHUNK, payload.size());
+    out->write(payload.data(), (streamsize) payload.size());
+    out->write((const char *) &footerOffset, sizeof(footerOffset));
+    out->write(RecordingContainer::END_MAGIC, sizeof(RecordingContainer::END_MAGIC));
+}
+
+int64_t RecordingContainer::indexChunks(const string &containerFile, RecordingIndex &index) {
+    ifstream in(containerFile, fstream::binary);
+    if (!in.is_open()) {
+        throw runtime_error("Can not open the recording container " + containerFile);
+    }
+    int64_t firstChunk = RecordingContainer::readHeader(in, containerFile, nullptr);
+    return RecordingContainer::scanChunks(in, firstChunk, index);
+}
+
+int RecordingContainer::rebuildFooter(const string &containerFile) {
+    RecordingIndex index;
+    int64_t chunksEnd = RecordingContainer::indexChunks(containerFile, index);
+    #ifndef _WIN32
+    if (truncate(containerFile.c_str(), (off_t) chunksEnd) != 0) {
+        throw runtime_error("Can not truncate the recording container " + containerFile + ": " + strerror(errno));
+    }
+    #else
+    throw runtime_error("Rebuilding the footer of a recording container is not supported on Windows");
+    #endif
+    fstream out(containerFile, fstream::in | fstream::out | fstream::binary);
+    out.seekp(chunksEnd);
+    RecordingContainer::writeFooter(&out, index);
+    if (!out) {
+        throw runtime_error("Can not write the footer of the recording container " + containerFile);
+    }
+    return index.getNrFrames();
+}
+
+uint64_t RecordingContainer::getPayloadSize(const uint8_t *containerData, int64_t payloadOffset) {
+    uint64_t payloadSize;
+    memcpy(&payloadSize, containerData + payloadOffset - sizeof(payloadSize), sizeof(payloadSize));
+    return payloadSize;
+}
+
+RecordingContainer::ChunkBuffer::ChunkBuffer() : payload(), payloadStream(&this->payload) {}
+
+RecordingContainer::ChunkBuffer::~ChunkBuffer() = default;
+
+ostream *RecordingContainer::ChunkBuffer::startPayload() {
+    this->payload.clear();
+    this->payloadStream.clear();
+    return &this->payloadStream;
+}
+
+uint64_t RecordingContainer::ChunkBuffer::getPayloadSize() const {
+    return this->payload.size();
+}
+
+int64_t RecordingContainer::ChunkBuffer::append(ofstream *out, mutex &containerLock, ContainerChunkType type) {
+    lock_guard<mutex> containerGuard(containerLock);
+    RecordingContainer::writeChunkHeader(out, type, this->payload.size());
+    auto payloadOffset = (int64_t) out->tellp();
+    out->write(this->payload.getData(), (streamsize) this->payload.size());
+    return payloadOffset;
+}
+
+void RecordingContainer::ChunkBuffer::MemoryStreamBuffer::clear() {
+    this->setp(this->memory.data(), this->memory.data() + this->memory.size());
+}
+
+uint64_t RecordingContainer::ChunkBuffer::MemoryStreamBuffer::size() const {
+    return (uint64_t) (this->pptr() - this->pbase());
+}
+
+const char *RecordingContainer::ChunkBuffer::MemoryStreamBuffer::getData() const {
+    return this->pbase();
+}
+
+streamsize RecordingContainer::ChunkBuffer::MemoryStreamBuffer::xsputn(const char *data, streamsize nrBytes) {
+    this->reserve((size_t) this->size() + (size_t) nrBytes);
+    memcpy(this->pptr(), data, (size_t) nrBytes);
+    this->pbump((int) nrBytes);
+    return nrBytes;
+}
+
+RecordingContainer::ChunkBuffer::MemoryStreamBuffer::int_type
+RecordingContainer::ChunkBuffer::MemoryStreamBuffer::overflow(int_type c) {
+    if (traits_type::eq_int_type(c, traits_type::eof())) {
+        return traits_type::not_eof(c);
+    }
+    this->reserve((size_t) this->size() + 1);
+    *this->pptr() = traits_type::to_char_type(c);
+    this->pbump(1);
+    return c;
+}
+
+void RecordingContainer::ChunkBuffer::MemoryStreamBuffer::reserve(size_t nrBytes) {
+    if (nrBytes <= this->memory.size()) {
+        return;
+    }
+    size_t size = (size_t) this->size();
+    // grows geometrically, and not at all once it holds the largest payload
+    this->memory.resize(max(nrBytes, 2 * this->memory.size()));
+    this->setp(this->memory.data(), this->memory.data() + this->memory.size());
+    this->pbump((int) size);
+}
+
+void RecordingContainer::writeChunkHeader(ostream *out, ContainerChunkType type, uint64_t payloadSize) {
+    auto chunkType = (uint32_t) type;
+    uint32_t reserved = 0;
+    out->write((const char *) &chunkType, sizeof(chunkType));
+    out->write((const char *) &reserved, sizeof(reserved));
+    out->write((const char *) &payloadSize, sizeof(payloadSize));
+}
+
+bool RecordingContainer::readChunkHeader(istream *in, uint32_t &type, uint64_t &payloadSize) {
+    uint32_t reserved;
+    in->read((char *) &type, sizeof(type));
+    in->read((char *) &reserved, sizeof(reserved));
+    in->read((char *) &payloadSize, sizeof(payloadSize));
+    return (bool) *in;
+}
+
+int64_t RecordingContainer::readHeader(ifstream &in, const string &containerFile, string *parametersJson) {
+    char magic[4];
+    uint32_t version, parametersSize;
+    in.read(magic, sizeof(magic));
+    in.read((char *) &version, sizeof(version));
+    in.read((char *) &parametersSize, sizeof(parametersSize));
+    if (!in || memcmp(magic, RecordingContainer::MAGIC, sizeof(magic)) != 0) {
+        throw runtime_error("The file " + containerFile + " is not a recording container!");
+    }
+    if (version != RecordingContainer::VERSION) {
+        throw runtime_error("Unsupported recording container version " + to_string(version) + " in " +
+                            containerFile);
+    }
+    if (parametersJson != nullptr) {
+        parametersJson->resize(parametersSize);
+        in.read(&(*parametersJson)[0], parametersSize);
+    } else {
+        in.seekg(parametersSize, ios::cur);
+    }
+    if (!in) {
+        throw runtime_error("The header of the recording container " + containerFile + " is incomplete!");
+    }
+    return (int64_t) in.tellg();
+}
+
+bool RecordingContainer::readFooter(ifstream &in, RecordingIndex &index) {
+    in.clear();
+    in.seekg(0, ios::end);
+    auto fileSize = (int64_t) in.tellg();
+    if (fileSize < (int64_t) RecordingContainer::TRAILER_SIZE) {
+        return false;
+    }
+    int64_t footerOffset;
+    char endMagic[4];
+    in.seekg(fileSize - (int64_t) RecordingContainer::TRAILER_SIZE);
+    in.read((char *) &footerOffset, sizeof(footerOffset));
+    in.read(endMagic, sizeof(endMagic));
+    if (!in || memcmp(endMagic, RecordingContainer::END_MAGIC, sizeof(endMagic)) != 0 || footerOffset < 0 ||
+        footerOffset >= fileSize) {
+        return false;
+    }
+
+    uint32_t chunkType;
+    uint64_t payloadSize;
+    in.seekg(footerOffset);
+    if (!RecordingContainer::readChunkHeader(&in, chunkType, payloadSize) || chunkType != FOOTER_CHUNK) {
+        return false;
+    }
+    string payload(payloadSize, '\0');
+    in.read(&payload[0], (streamsize) payloadSize);
+    if (!in) {
+        return false;
+    }
+    istringstream footer(payload);
+    index.load(footer, "the footer of a recording container");
+    return true;
+}
+
+int64_t RecordingContainer::scanChunks(ifstream &in, int64_t firstChunk, RecordingIndex &index) {
+    index.clear();
+    in.clear();
+    in.seekg(0, ios::end);
+    auto fileSize = (int64_t) in.tellg();
+    int64_t chunkStart = firstChunk;
+    uint32_t chunkType;
+    uint64_t payloadSize;
+    in.seekg(chunkStart);
+    while (RecordingContainer::readChunkHeader(&in, chunkType, payloadSize) && chunkType != FOOTER_CHUNK) {
+        int64_t chunkEnd = chunkStart + (int64_t) (RecordingContainer::CHUNK_HEADER_SIZE + payloadSize);
+        if (chunkEnd > fileSize) {
+            // cut off while it was written
+            break;
+        }
+        if (chunkType == METADATA_CHUNK) {
+            FrameIndexEntry entry = FrameIndexEntry::unknown();
+            if (!RecordingIndex::readEntry(in, entry)) {
+                break;
+            }
+            index.addEntry(entry);
+        }
+        chunkStart = chunkEnd;
+        in.seekg(chunkStart);
+    }
+    return chunkStart;
+}
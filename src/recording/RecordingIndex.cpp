@@ -0,0 +1,154 @@
+#include <RealsenseRecording/recording/RecordingIndex.h>
+#include <cstring>
+#include <stdexcept>
+
+using namespace RealsenseRecording;
+using namespace std;
+
+const char RecordingIndex::MAGIC[4] = {'R', 'S', 'I', 'X'};
+const uint32_t RecordingIndex::VERSION = 1;
+
+namespace {
+    const size_t STREAM_INFO_SIZE = 2 * sizeof(double) + sizeof(unsigned long long);
+    const size_t ENTRY_SIZE = 2 * sizeof(int64_t) + sizeof(unsigned long long) + 2 * STREAM_INFO_SIZE;
+
+    void writeStreamFrameInfo(ostream *out, const StreamFrameInfo &info) {
+        out->write((const char *) &info.hardwareTimestamp, sizeof(info.hardwareTimestamp));
+        out->write((const char *) &info.systemTimestamp, sizeof(info.systemTimestamp));
+        out->write((const char *) &info.frameNumber, sizeof(info.frameNumber));
+    }
+
+    void readStreamFrameInfo(istream &in, StreamFrameInfo &info) {
+        in.read((char *) &info.hardwareTimestamp, sizeof(info.hardwareTimestamp));
+        in.read((char *) &info.systemTimestamp, sizeof(info.systemTimestamp));
+        in.read((char *) &info.frameNumber, sizeof(info.frameNumber));
+    }
+}
+
+FrameIndexEntry FrameIndexEntry::unknown() {
+    StreamFrameInfo unknownInfo{-1, -1, StreamFrameInfo::UNKNOWN_FRAME_NUMBER};
+    return FrameIndexEntry{-1, -1, (unsigned long long) -1, unknownInfo, unknownInfo};
+}
+
+double FrameIndexEntry::getReplayTimestamp() const {
+    if (this->depth.hardwareTimestamp >= 0) {
+        return this->depth.hardwareTimestamp;
+    } else if (this->image.hardwareTimestamp >= 0) {
+        return this->image.hardwareTimestamp;
+    } else if (this->depth.systemTimestamp >= 0) {
+        return this->depth.systemTimestamp;
+    }
+    return this->image.systemTimestamp;
+}
+
+RecordingIndex::RecordingIndex() : entries() {}
+
+RecordingIndex::~RecordingIndex() = default;
+
+void RecordingIndex::clear() {
+    this->entries.clear();
+}
+
+bool RecordingIndex::load(const string &indexFile) {
+    this->entries.clear();
+    ifstream in(indexFile, fstream::binary);
+    if (!in.is_open()) {
+        return false;
+    }
+    this->load(in, indexFile);
+    return true;
+}
+
+void RecordingIndex::load(istream &in, const string &name) {
+    this->entries.clear();
+    char magic[4];
+    uint32_t version, entrySize;
+    in.read(magic, sizeof(magic));
+    in.read((char *) &version, sizeof(version));
+    in.read((char *) &entrySize, sizeof(entrySize));
+    if (!in || memcmp(magic, RecordingIndex::MAGIC, sizeof(magic)) != 0) {
+        throw runtime_error("The file " + name + " is not a recording index!");
+    }
+    if (version != RecordingIndex::VERSION || entrySize != ENTRY_SIZE) {
+        throw runtime_error("Unsupported recording index version " + to_string(version) + " in " + name);
+    }
+
+    FrameIndexEntry entry = FrameIndexEntry::unknown();
+    while (RecordingIndex::readEntry(in, entry)) {
+        this->entries.push_back(entry);
+    }
+}
+
+void RecordingIndex::save(const string &indexFile) const {
+    ofstream out(indexFile, fstream::binary);
+    if (!out.is_open()) {
+        throw runtime_error("Can not open the recording index " + indexFile + " for writing!");
+    }
+    this->save(&out);
+}
+
+void RecordingIndex::save(ostream *out) const {
+    RecordingIndex::writeHeader(out);
+    for (const auto &entry: this->entries) {
+        RecordingIndex::writeEntry(out, entry);
+    }
+}
+
+void RecordingIndex::addEntry(const FrameIndexEntry &entry) {
+    this->entries.push_back(entry);
+}
+
+const FrameIndexEntry &RecordingIndex::getEntry(int frameIndex) const {
+    if (frameIndex < 0 || frameIndex >= (int) this->entries.size()) {
+        throw runtime_error("Frame " + to_string(frameIndex) + " is out of the recording's range [0, " +
+                            to_string(this->entries.size()) + ")");
+    }
+    return this->entries[frameIndex];
+}
+
+int RecordingIndex::getNrFrames() const {
+    return (int) this->entries.size();
+}
+
+bool RecordingIndex::empty() const {
+    return this->entries.empty();
+}
+
+vector<int> RecordingIndex::getFrameNumberGaps() const {
+    vector<int> gaps;
+    unsigned long long unknown = StreamFrameInfo::UNKNOWN_FRAME_NUMBER, previous = unknown;
+    for (int i = 0; i < (int) this->entries.size(); i++) {
+        const FrameIndexEntry &entry = this->entries[i];
+        unsigned long long frameNumber = (entry.depth.frameNumber != unknown) ? entry.depth.frameNumber :
+                                         entry.image.frameNumber;
+        if (frameNumber != unknown && previous != unknown && frameNumber != previous + 1) {
+            gaps.push_back(i);
+        }
+        previous = frameNumber;
+    }
+    return gaps;
+}
+
+void RecordingIndex::writeHeader(ostream *out) {
+    uint32_t entrySize = ENTRY_SIZE;
+    out->write(RecordingIndex::MAGIC, sizeof(RecordingIndex::MAGIC));
+    out->write((const char *) &RecordingIndex::VERSION, sizeof(RecordingIndex::VERSION));
+    out->write((const char *) &entrySize, sizeof(entrySize));
+}
+
+void RecordingIndex::writeEntry(ostream *out, const FrameIndexEntry &entry) {
+    out->write((const char *) &entry.imageOffset, sizeof(entry.imageOffset));
+    out->write((const char *) &entry.depthOffset, sizeof(entry.depthOffset));
+    out->write((const char *) &entry.counter, sizeof(entry.counter));
+    writeStreamFrameInfo(out, entry.image);
+    writeStreamFrameInfo(out, entry.depth);
+}
+
+bool RecordingIndex::readEntry(istream &in, FrameIndexEntry &entry) {
+    in.read((char *) &entry.imageOffset, sizeof(entry.imageOffset));
+    in.read((char *) &entry.depthOffset, sizeof(entry.depthOffset));
+    in.read((char *) &entry.counter, sizeof(entry.counter));
+    readStreamFrameInfo(in, entry.image);
+    readStreamFrameInfo(in, entry.depth);
+    return (bool) in;
+}
@@ -3,6 +3,7 @@
 //
 
 #include <RealsenseRecording/recording/RecordingParameters.h>
+#include <RealsenseRecording/recording/RecordingContainer.h>
 #include <utility>
 #include <AndreiUtils/utils.hpp>
 #include <AndreiUtils/utilsJson.h>
@@ -30,6 +31,9 @@ const map<string, rs2_distortion> RecordingParameters::DISTORTION_MODELS = {
 
 const vector<string> RecordingParameters::PARAMETER_FORMATS = {"xml", "json",};
 
+// recordings made before the depth units were stored are in millimeters
+const float RecordingParameters::DEFAULT_DEPTH_UNITS = 0.001f;
+
 RecordingParameters::RecordingParameters() : RecordingParameters("", "", "", RotationType::NO_ROTATION) {}
 
 RecordingParameters::RecordingParameters(string imageFormat, string depthFormat, string parametersFormat,
@@ -40,8 +44,11 @@ RecordingParameters::RecordingParameters(string imageFormat, string depthFormat,
 RecordingParameters::RecordingParameters(string imageFormat, string depthFormat, string parametersFormat,
                                          const void *parameters, RecordingParametersType parametersType,
                                          RotationType rotationType) :
-        fps(), rotation(rotationType), model(), coefficients(), imageFormat(move(imageFormat)),
-        depthFormat(move(depthFormat)), parametersFormat(move(parametersFormat)), initialized(false) {
+        fps(), coefficients(), depthUnits(DEFAULT_DEPTH_UNITS), model(), imageFormat(move(imageFormat)),
+        depthFormat(move(depthFormat)), parametersFormat(move(parametersFormat)), rotation(rotationType),
+        imagePixelFormat(IMAGE_RGB8), unalignedDepth(false), depthFps(), depthCoefficients(),
+        depthModel(RS2_DISTORTION_NONE), depthToColorRotation{1, 0, 0, 0, 1, 0, 0, 0, 1}, depthToColorTranslation(),
+        initialized(false) {
     if (parameters != nullptr) {
         switch (parametersType) {
             case RECORDING_PARAMETERS: {
@@ -69,17 +76,21 @@ RecordingParameters::RecordingParameters(string imageFormat, string depthFormat,
 RecordingParameters::RecordingParameters(double fps, int width, int height, float fx, float fy, float ppx, float ppy,
                                          rs2_distortion model, const float *coefficients, string imageFormat,
                                          string depthFormat, string parametersFormat, RotationType rotationType) :
-        fps(), rotation(rotationType), model(), coefficients(), imageFormat(move(imageFormat)),
-        depthFormat(move(depthFormat)), parametersFormat(move(parametersFormat)) {
+        fps(), coefficients(), depthUnits(DEFAULT_DEPTH_UNITS), model(), imageFormat(move(imageFormat)),
+        depthFormat(move(depthFormat)), parametersFormat(move(parametersFormat)), rotation(rotationType),
+        imagePixelFormat(IMAGE_RGB8), unalignedDepth(false), depthFps(), depthCoefficients(),
+        depthModel(RS2_DISTORTION_NONE), depthToColorRotation{1, 0, 0, 0, 1, 0, 0, 0, 1}, depthToColorTranslation() {
     this->setParameters(fps, width, height, fx, fy, ppx, ppy, model, coefficients, rotationType);
     this->initialized = true;
 }
 
 RecordingParameters::RecordingParameters(double fps, rs2_intrinsics intrinsics, string imageFormat, string depthFormat,
                                          string parametersFormat, RotationType rotationType) :
-        fps(fps), rotation(rotationType), width(intrinsics.width), height(intrinsics.height), fx(intrinsics.fx),
-        fy(intrinsics.fy), ppx(intrinsics.ppx), ppy(intrinsics.ppy), model(intrinsics.model), coefficients(),
-        imageFormat(move(imageFormat)), depthFormat(move(depthFormat)), parametersFormat(move(parametersFormat)) {
+        fps(fps), width(intrinsics.width), height(intrinsics.height), ppx(intrinsics.ppx), ppy(intrinsics.ppy),
+        fx(intrinsics.fx), fy(intrinsics.fy), coefficients(), depthUnits(DEFAULT_DEPTH_UNITS), model(intrinsics.model),
+        imageFormat(move(imageFormat)), depthFormat(move(depthFormat)), parametersFormat(move(parametersFormat)),
+        rotation(rotationType), imagePixelFormat(IMAGE_RGB8), unalignedDepth(false), depthFps(), depthCoefficients(),
+        depthModel(RS2_DISTORTION_NONE), depthToColorRotation{1, 0, 0, 0, 1, 0, 0, 0, 1}, depthToColorTranslation() {
     this->setRotationDependentParameters(rotationType, intrinsics.width, intrinsics.height, intrinsics.fx,
                                          intrinsics.fy, intrinsics.ppx, intrinsics.ppy);
     for (int i = 0; i < 5; i++) {
@@ -103,6 +114,9 @@ void RecordingParameters::clear() {
         coefficient = 0;
     }
     this->model = RS2_DISTORTION_NONE;
+    this->depthUnits = DEFAULT_DEPTH_UNITS;
+    this->setAlignedDepth();
+    this->imagePixelFormat = IMAGE_RGB8;
     this->imageFormat = "";
     this->depthFormat = "";
     this->parametersFormat = "";
@@ -143,6 +157,14 @@ void RecordingParameters::setParameters(const RecordingParameters *recordingPara
     for (int i = 0; i < 5; i++) {
         this->coefficients[i] = recordingParameters->coefficients[i];
     }
+    this->depthUnits = recordingParameters->depthUnits;
+    this->imagePixelFormat = recordingParameters->imagePixelFormat;
+    if (recordingParameters->unalignedDepth) {
+        this->setUnalignedDepth(recordingParameters->depthFps, recordingParameters->getDepthIntrinsics(),
+                                recordingParameters->getDepthToColorExtrinsics());
+    } else {
+        this->setAlignedDepth();
+    }
     this->initialized = true;
 }
 
@@ -187,6 +209,8 @@ void RecordingParameters::deserialize(const string &parametersFile, const string
         #endif
     } else if (_parametersFormat == "json") {
         this->from_json(readJsonFile(parametersFile));
+    } else if (_parametersFormat == "rsrec") {
+        this->from_json(json::parse(RecordingContainer::readParametersJson(parametersFile)));
     } else {
         throw runtime_error("Unknown parameter format: " + _parametersFormat + "...");
     }
@@ -214,6 +238,28 @@ void RecordingParameters::writeParameters(cv::FileStorage &fs) const {
     fs << "coefficient_3" << this->coefficients[3];
     fs << "coefficient_4" << this->coefficients[4];
     fs << "distortion_model" << rs2_distortion_to_string(this->model);
+    fs << "depthUnits" << this->depthUnits;
+    fs << "imagePixelFormat" << imagePixelFormatToString(this->imagePixelFormat);
+    fs << "unalignedDepth" << (int) this->unalignedDepth;
+    if (this->unalignedDepth) {
+        fs << "depth_fps" << this->depthFps;
+        fs << "depth_w" << this->depthWidth;
+        fs << "depth_h" << this->depthHeight;
+        fs << "depth_fx" << this->depthFx;
+        fs << "depth_fy" << this->depthFy;
+        fs << "depth_ppx" << this->depthPpx;
+        fs << "depth_ppy" << this->depthPpy;
+        for (int i = 0; i < 5; i++) {
+            fs << "depth_coefficient_" + to_string(i) << this->depthCoefficients[i];
+        }
+        fs << "depth_distortion_model" << rs2_distortion_to_string(this->depthModel);
+        for (int i = 0; i < 9; i++) {
+            fs << "depthToColor_rotation_" + to_string(i) << this->depthToColorRotation[i];
+        }
+        for (int i = 0; i < 3; i++) {
+            fs << "depthToColor_translation_" + to_string(i) << this->depthToColorTranslation[i];
+        }
+    }
     fs << "}";
 }
 
@@ -233,13 +279,34 @@ void RecordingParameters::readParameters(const cv::FileNode &node) {
         this->coefficients[i] = (float) node["coefficient_" + to_string(i)];
     }
 
-    rs2_distortion savedModel;
-    bool found = mapGetIfContains(RecordingParameters::DISTORTION_MODELS, (string) node["distortion_model"],
-                                  savedModel);
-    if (!found) {
-        throw std::runtime_error("Unknown distortion model " + (string) (node["distortion_model"]));
+    this->model = RecordingParameters::distortionModelFromString((string) node["distortion_model"]);
+    this->depthUnits = node["depthUnits"].empty() ? DEFAULT_DEPTH_UNITS : (float) node["depthUnits"];
+    // recordings made before YUYV images were supported have 3 bytes per pixel
+    this->imagePixelFormat = node["imagePixelFormat"].empty() ? IMAGE_RGB8 :
+                             imagePixelFormatFromString((string) node["imagePixelFormat"]);
+    // recordings made before the unaligned depth was supported have aligned depth
+    this->unalignedDepth = !node["unalignedDepth"].empty() && (int) node["unalignedDepth"] != 0;
+    if (!this->unalignedDepth) {
+        this->setAlignedDepth();
+        return;
+    }
+    this->depthFps = (double) node["depth_fps"];
+    this->depthWidth = (int) node["depth_w"];
+    this->depthHeight = (int) node["depth_h"];
+    this->depthFx = (float) node["depth_fx"];
+    this->depthFy = (float) node["depth_fy"];
+    this->depthPpx = (float) node["depth_ppx"];
+    this->depthPpy = (float) node["depth_ppy"];
+    for (int i = 0; i < 5; i++) {
+        this->depthCoefficients[i] = (float) node["depth_coefficient_" + to_string(i)];
+    }
+    this->depthModel = RecordingParameters::distortionModelFromString((string) node["depth_distortion_model"]);
+    for (int i = 0; i < 9; i++) {
+        this->depthToColorRotation[i] = (float) node["depthToColor_rotation_" + to_string(i)];
+    }
+    for (int i = 0; i < 3; i++) {
+        this->depthToColorTranslation[i] = (float) node["depthToColor_translation_" + to_string(i)];
     }
-    this->model = savedModel;
 }
 
 #endif
@@ -263,6 +330,28 @@ void RecordingParameters::to_json(json &j) const {
     j["coefficient_3"] = this->coefficients[3];
     j["coefficient_4"] = this->coefficients[4];
     j["distortion_model"] = rs2_distortion_to_string(this->model);
+    j["depthUnits"] = this->depthUnits;
+    j["imagePixelFormat"] = imagePixelFormatToString(this->imagePixelFormat);
+    j["unalignedDepth"] = this->unalignedDepth;
+    if (this->unalignedDepth) {
+        j["depth_fps"] = this->depthFps;
+        j["depth_w"] = this->depthWidth;
+        j["depth_h"] = this->depthHeight;
+        j["depth_fx"] = this->depthFx;
+        j["depth_fy"] = this->depthFy;
+        j["depth_ppx"] = this->depthPpx;
+        j["depth_ppy"] = this->depthPpy;
+        for (int i = 0; i < 5; i++) {
+            j["depth_coefficient_" + to_string(i)] = this->depthCoefficients[i];
+        }
+        j["depth_distortion_model"] = rs2_distortion_to_string(this->depthModel);
+        for (int i = 0; i < 9; i++) {
+            j["depthToColor_rotation_" + to_string(i)] = this->depthToColorRotation[i];
+        }
+        for (int i = 0; i < 3; i++) {
+            j["depthToColor_translation_" + to_string(i)] = this->depthToColorTranslation[i];
+        }
+    }
 }
 
 void RecordingParameters::from_json(const json &j) {
@@ -281,13 +370,34 @@ void RecordingParameters::from_json(const json &j) {
         this->coefficients[i] = j["coefficient_" + to_string(i)].get<float>();
     }
 
-    rs2_distortion savedModel;
-    bool found = mapGetIfContains(RecordingParameters::DISTORTION_MODELS, j["distortion_model"].get<string>(),
-                                  savedModel);
-    if (!found) {
-        throw std::runtime_error("Unknown distortion model " + j["distortion_model"].get<string>());
+    this->model = RecordingParameters::distortionModelFromString(j["distortion_model"].get<string>());
+    this->depthUnits = j.contains("depthUnits") ? j["depthUnits"].get<float>() : DEFAULT_DEPTH_UNITS;
+    // recordings made before YUYV images were supported have 3 bytes per pixel
+    this->imagePixelFormat = j.contains("imagePixelFormat") ?
+                             imagePixelFormatFromString(j["imagePixelFormat"].get<string>()) : IMAGE_RGB8;
+    // recordings made before the unaligned depth was supported have aligned depth
+    this->unalignedDepth = j.contains("unalignedDepth") && j["unalignedDepth"].get<bool>();
+    if (!this->unalignedDepth) {
+        this->setAlignedDepth();
+        return;
+    }
+    this->depthFps = j["depth_fps"].get<double>();
+    this->depthWidth = j["depth_w"].get<int>();
+    this->depthHeight = j["depth_h"].get<int>();
+    this->depthFx = j["depth_fx"].get<float>();
+    this->depthFy = j["depth_fy"].get<float>();
+    this->depthPpx = j["depth_ppx"].get<float>();
+    this->depthPpy = j["depth_ppy"].get<float>();
+    for (int i = 0; i < 5; i++) {
+        this->depthCoefficients[i] = j["depth_coefficient_" + to_string(i)].get<float>();
+    }
+    this->depthModel = RecordingParameters::distortionModelFromString(j["depth_distortion_model"].get<string>());
+    for (int i = 0; i < 9; i++) {
+        this->depthToColorRotation[i] = j["depthToColor_rotation_" + to_string(i)].get<float>();
+    }
+    for (int i = 0; i < 3; i++) {
+        this->depthToColorTranslation[i] = j["depthToColor_translation_" + to_string(i)].get<float>();
     }
-    this->model = savedModel;
 }
 
 rs2_intrinsics RecordingParameters::getIntrinsics() {
@@ -305,6 +415,105 @@ rs2_intrinsics RecordingParameters::getIntrinsics() {
     return intrinsics;
 }
 
+void RecordingParameters::setUnalignedDepth(double _depthFps, const rs2_intrinsics &_depthIntrinsics,
+                                            const rs2_extrinsics &_depthToColor) {
+    if (this->rotation != RotationType::NO_ROTATION) {
+        throw runtime_error("Can not record unaligned depth together with a rotation!");
+    }
+    this->unalignedDepth = true;
+    this->depthFps = _depthFps;
+    this->depthWidth = _depthIntrinsics.width;
+    this->depthHeight = _depthIntrinsics.height;
+    this->depthFx = _depthIntrinsics.fx;
+    this->depthFy = _depthIntrinsics.fy;
+    this->depthPpx = _depthIntrinsics.ppx;
+    this->depthPpy = _depthIntrinsics.ppy;
+    this->depthModel = _depthIntrinsics.model;
+    for (int i = 0; i < 5; i++) {
+        this->depthCoefficients[i] = _depthIntrinsics.coeffs[i];
+    }
+    for (int i = 0; i < 9; i++) {
+        this->depthToColorRotation[i] = _depthToColor.rotation[i];
+    }
+    for (int i = 0; i < 3; i++) {
+        this->depthToColorTranslation[i] = _depthToColor.translation[i];
+    }
+}
+
+void RecordingParameters::setAlignedDepth() {
+    this->unalignedDepth = false;
+    this->depthFps = 0;
+    this->depthWidth = 0;
+    this->depthHeight = 0;
+    this->depthFx = 0;
+    this->depthFy = 0;
+    this->depthPpx = 0;
+    this->depthPpy = 0;
+    this->depthModel = RS2_DISTORTION_NONE;
+    for (float &coefficient: this->depthCoefficients) {
+        coefficient = 0;
+    }
+    this->setDepthToColorIdentity();
+}
+
+bool RecordingParameters::hasUnalignedDepth() const {
+    return this->unalignedDepth;
+}
+
+int RecordingParameters::getDepthHeight() const {
+    return this->unalignedDepth ? this->depthHeight : this->height;
+}
+
+int RecordingParameters::getDepthWidth() const {
+    return this->unalignedDepth ? this->depthWidth : this->width;
+}
+
+rs2_intrinsics RecordingParameters::getDepthIntrinsics() const {
+    if (!this->unalignedDepth) {
+        return ((RecordingParameters *) this)->getIntrinsics();
+    }
+    rs2_intrinsics intrinsics;
+    intrinsics.width = this->depthWidth;
+    intrinsics.height = this->depthHeight;
+    intrinsics.fx = this->depthFx;
+    intrinsics.fy = this->depthFy;
+    intrinsics.ppx = this->depthPpx;
+    intrinsics.ppy = this->depthPpy;
+    intrinsics.model = this->depthModel;
+    for (int i = 0; i < 5; i++) {
+        intrinsics.coeffs[i] = this->depthCoefficients[i];
+    }
+    return intrinsics;
+}
+
+rs2_extrinsics RecordingParameters::getDepthToColorExtrinsics() const {
+    rs2_extrinsics extrinsics;
+    for (int i = 0; i < 9; i++) {
+        extrinsics.rotation[i] = this->depthToColorRotation[i];
+    }
+    for (int i = 0; i < 3; i++) {
+        extrinsics.translation[i] = this->depthToColorTranslation[i];
+    }
+    return extrinsics;
+}
+
+rs2_distortion RecordingParameters::distortionModelFromString(const string &distortionModel) {
+    rs2_distortion model;
+    if (!mapGetIfContains(RecordingParameters::DISTORTION_MODELS, distortionModel, model)) {
+        throw std::runtime_error("Unknown distortion model " + distortionModel);
+    }
+    return model;
+}
+
+void RecordingParameters::setDepthToColorIdentity() {
+    for (int i = 0; i < 9; i++) {
+        this->depthToColorRotation[i] = (i % 4 == 0) ? 1.0f : 0.0f;
+    }
+    for (float &translation: this->depthToColorTranslation) {
+        translation = 0;
+    }
+}
+
 void RecordingParameters::setRotationDependentParameters(RotationType _rotation, int _width, int _height) {
     this->rotation = _rotation;
     switch (this->rotation) {
@@ -346,6 +555,26 @@ void RecordingParameters::setRotationDependentParameters(RotationType _rotation,
     }
 }
 
+void RecordingParameters::setImagePixelFormat(ImagePixelFormat format) {
+    if (format == IMAGE_YUYV) {
+        if (this->imageFormat != "bin") {
+            throw runtime_error("YUYV images can only be recorded in the \"bin\" image format, not in \"" +
+                                this->imageFormat + "\"!");
+        }
+        if (this->rotation != RotationType::NO_ROTATION) {
+            throw runtime_error("Can not record YUYV images together with a rotation!");
+        }
+        if (this->width % 2 != 0) {
+            throw runtime_error("Can not record YUYV images of odd width " + to_string(this->width) + "!");
+        }
+    }
+    this->imagePixelFormat = format;
+}
+
+int RecordingParameters::getImageBytesPerPixel() const {
+    return (this->imagePixelFormat == IMAGE_YUYV) ? 2 : 3;
+}
+
 bool RecordingParameters::isInitialized() const {
     return this->initialized;
 }
@@ -0,0 +1,186 @@
+#include <RealsenseRecording/recording/SPSCRingBuffer.h>
+#include <stdexcept>
+#include <string>
+
+using namespace RealsenseRecording;
+using namespace std;
+
+SPSCRingBuffer::SPSCRingBuffer(int capacity) :
+        capacity(0), nrSlots(0), readySlots(), freeSlots(), readyHead(0), readyTail(0), freeHead(0), freeTail(0),
+        producerSlot(-1), consumerSlot(-1), producerWaiting(false), consumerWaiting(false), closed(false) {
+    if (capacity > 0) {
+        this->reset(capacity);
+    }
+}
+
+SPSCRingBuffer::~SPSCRingBuffer() {
+    this->close();
+}
+
+void SPSCRingBuffer::reset(int _capacity) {
+    if (_capacity < 1) {
+        throw runtime_error("Can not work with a buffer capacity < 1! Was " + to_string(_capacity));
+    }
+    this->capacity = _capacity;
+    this->nrSlots = _capacity + 2;
+    this->readySlots.reset(new atomic<int>[this->nrSlots]);
+    this->freeSlots.reset(new atomic<int>[this->nrSlots]);
+    for (int i = 0; i < this->nrSlots; i++) {
+        this->readySlots[i].store(-1, memory_order_relaxed);
+        this->freeSlots[i].store(i, memory_order_relaxed);
+    }
+    this->readyHead.store(0);
+    this->readyTail.store(0);
+    this->freeHead.store(this->nrSlots);
+    this->freeTail.store(0);
+    this->producerSlot = -1;
+    this->consumerSlot = -1;
+    this->producerWaiting.store(false);
+    this->consumerWaiting.store(false);
+    this->closed.store(false);
+}
+
+int SPSCRingBuffer::acquireWriteSlot(BufferOverflowPolicy policy, bool &droppedOldest) {
+    droppedOldest = false;
+    if (this->producerSlot >= 0) {
+        // acquired before but never published
+        return this->producerSlot;
+    }
+    while (!this->closed.load(memory_order_acquire)) {
+        if (this->popFreeSlot(this->producerSlot)) {
+            return this->producerSlot;
+        }
+        switch (policy) {
+            case BLOCK_WHEN_FULL: {
+                unique_lock<mutex> waitGuard(this->waitLock);
+                this->producerWaiting.store(true);
+                while (this->freeTail.load() == this->freeHead.load() && !this->closed.load()) {
+                    this->producerCondition.wait(waitGuard);
+                }
+                this->producerWaiting.store(false);
+                break;
+            }
+            case DROP_NEWEST: {
+                return -1;
+            }
+            case DROP_OLDEST: {
+                // take over the oldest published slot, unless the consumer claims it first
+                unsigned long long tail = this->readyTail.load(memory_order_acquire);
+                if (tail != this->readyHead.load(memory_order_relaxed)) {
+                    int slot = this->readySlots[tail % this->nrSlots].load(memory_order_relaxed);
+                    if (this->readyTail.compare_exchange_strong(tail, tail + 1, memory_order_acq_rel)) {
+                        this->producerSlot = slot;
+                        droppedOldest = true;
+                        return slot;
+                    }
+                }
+                // the consumer claimed the oldest slot and released its previous one: retry the free list
+                break;
+            }
+        }
+    }
+    return -1;
+}
+
+void SPSCRingBuffer::publishWriteSlot() {
+    if (this->producerSlot < 0) {
+        throw runtime_error("Can not publish a slot which has not been acquired!");
+    }
+    unsigned long long head = this->readyHead.load(memory_order_relaxed);
+    this->readySlots[head % this->nrSlots].store(this->producerSlot, memory_order_relaxed);
+    this->readyHead.store(head + 1, memory_order_release);
+    this->producerSlot = -1;
+    this->notifyConsumer();
+}
+
+int SPSCRingBuffer::acquireReadSlot() {
+    this->releaseReadSlot();
+    while (true) {
+        unsigned long long tail = this->readyTail.load(memory_order_acquire);
+        if (tail == this->readyHead.load(memory_order_acquire)) {
+            if (this->closed.load(memory_order_acquire)) {
+                if (tail == this->readyHead.load(memory_order_acquire)) {
+                    return -1;
+                }
+                continue;
+            }
+            unique_lock<mutex> waitGuard(this->waitLock);
+            this->consumerWaiting.store(true);
+            while (this->readyTail.load() == this->readyHead.load() && !this->closed.load()) {
+                this->consumerCondition.wait(waitGuard);
+            }
+            this->consumerWaiting.store(false);
+            continue;
+        }
+        int slot = this->readySlots[tail % this->nrSlots].load(memory_order_relaxed);
+        // a producer with the DROP_OLDEST policy might take this slot away concurrently
+        if (this->readyTail.compare_exchange_weak(tail, tail + 1, memory_order_acq_rel, memory_order_relaxed)) {
+            this->consumerSlot = slot;
+            return slot;
+        }
+    }
+}
+
+void SPSCRingBuffer::releaseReadSlot() {
+    if (this->consumerSlot >= 0) {
+        this->pushFreeSlot(this->consumerSlot);
+        this->consumerSlot = -1;
+    }
+}
+
+void SPSCRingBuffer::close() {
+    this->closed.store(true, memory_order_release);
+    lock_guard<mutex> waitGuard(this->waitLock);
+    this->producerCondition.notify_all();
+    this->consumerCondition.notify_all();
+}
+
+bool SPSCRingBuffer::isClosed() const {
+    return this->closed.load(memory_order_acquire);
+}
+
+int SPSCRingBuffer::getCapacity() const {
+    return this->capacity;
+}
+
+int SPSCRingBuffer::getNrSlots() const {
+    return this->nrSlots;
+}
+
+int SPSCRingBuffer::size() const {
+    return (int) (this->readyHead.load(memory_order_acquire) - this->readyTail.load(memory_order_acquire));
+}
+
+bool SPSCRingBuffer::popFreeSlot(int &slot) {
+    unsigned long long tail = this->freeTail.load(memory_order_relaxed);
+    if (tail == this->freeHead.load(memory_order_acquire)) {
+        return false;
+    }
+    slot = this->freeSlots[tail % this->nrSlots].load(memory_order_relaxed);
+    this->freeTail.store(tail + 1, memory_order_release);
+    return true;
+}
+
+void SPSCRingBuffer::pushFreeSlot(int slot) {
+    unsigned long long head = this->freeHead.load(memory_order_relaxed);
+    this->freeSlots[head % this->nrSlots].store(slot, memory_order_relaxed);
+    this->freeHead.store(head + 1, memory_order_release);
+    this->notifyProducer();
+}
+
+void SPSCRingBuffer::notifyProducer() {
+    // pairs with the seq_cst store of producerWaiting: either the producer sees the new free slot or we see it waiting
+    atomic_thread_fence(memory_order_seq_cst);
+    if (this->producerWaiting.load()) {
+        lock_guard<mutex> waitGuard(this->waitLock);
+        this->producerCondition.notify_one();
+    }
+}
+
+void SPSCRingBuffer::notifyConsumer() {
+    atomic_thread_fence(memory_order_seq_cst);
+    if (this->consumerWaiting.load()) {
+        lock_guard<mutex> waitGuard(this->waitLock);
+        this->consumerCondition.notify_one();
+    }
+}
@@ -7,8 +7,12 @@
 #include <AndreiUtils/utilsJson.h>
 #include <AndreiUtils/utilsOpenMP.hpp>
 #include <AndreiUtils/utilsRealsense.h>
+#include <chrono>
+#include <cmath>
 #include <configDirectoryLocation.h>
 #include <iostream>
+#include <RealsenseRecording/recording/DepthConversion.h>
+#include <RealsenseRecording/recording/ImageRotation.h>
 
 #ifdef OPENCV
 
@@ -22,7 +26,15 @@ using namespace RealsenseRecording;
 using namespace rs2;
 using namespace std;
 
+bool WriteRecording::configRead = false;
 int WriteRecording::dataBufferSize = 0;
+BufferOverflowPolicy WriteRecording::defaultOverflowPolicy = BLOCK_WHEN_FULL;
+int WriteRecording::nrPreallocatedFrames = 8;
+int WriteRecording::nrDepthCodecChunks = DepthCodec::DEFAULT_NR_CHUNKS;
+int WriteRecording::defaultMaxHeldFrames = 0;
+unsigned long long WriteRecording::defaultSegmentMaxFrames = 0;
+unsigned long long WriteRecording::defaultSegmentMaxBytes = 0;
+double WriteRecording::defaultSegmentMaxSeconds = 0;
 
 WriteRecording *WriteRecording::createEmptyPtr(const string &imageWriteFormat, const string &depthWriteFormat,
                                                const string &parametersWriteFormat, bool withOpenCV,
@@ -31,14 +43,27 @@ WriteRecording *WriteRecording::createEmptyPtr(const string &imageWriteFormat, c
                               rotationType);
 }
 
+WriteRecording::WriteRecording(RecordingParameters _parameters, bool _parametersSet, bool withOpenCV,
+                               AndreiUtils::RotationType rotationType) :
+        Recording(move(_parameters)),
+        imageWriterInitialized(false), depthWriterInitialized(false), imageFrameCodec(), depthFrameCodec(), buffer(),
+        overflowPolicy(BLOCK_WHEN_FULL), nrDroppedFrames(0), writeRotation(rotationType), slabPool(), frameHeight(0),
+        frameWidth(0), depthFrameHeight(0), depthFrameWidth(0), depthRotationScratch(), imageBytesBuffer(),
+        depthBytesBuffer(), imageFrameBuffer(), depthFrameBuffer(), nrHeldFrames(0), maxHeldFrames(0),
+        indexEntryBuffer(), indexLock(), nrPendingStreamsBuffer(), nrWrittenStreamsBuffer(), segmentMaxFrames(0),
+        segmentMaxBytes(0), segmentMaxSeconds(0), segmentBuffer(), producerSegment(0), nrSegmentFrames(0),
+        nrSegmentBytes(0), segmentStart(), nrWrittenBytes(0), enqueueLatency(), imageQueueLatency(),
+        depthQueueLatency(), imageWriteLatency(), depthWriteLatency(), publishTimeBuffer(), nrWrittenImages(0),
+        nrWrittenDepths(0), maxQueueDepth(0), statsStart(chrono::steady_clock::now()), statsStartBytes(0),
+        statsStartDroppedFrames(0), imageWriterSegment(0), depthWriterSegment(0), indexWriterSegment(0),
+        parametersSet(_parametersSet), writeWithOpenCV(withOpenCV) {}
+
 WriteRecording::WriteRecording(const std::string &imageFormat, const std::string &depthFormat,
                                const std::string &parameterFormat, const void *parameters,
                                RecordingParametersType parametersType, bool withOpenCV,
                                AndreiUtils::RotationType rotationType) :
-        Recording(imageFormat, depthFormat, parameterFormat, parameters, parametersType, rotationType),
-        imageBytesBuffer(), depthBytesBuffer(), countBuffer(), writeFlag(true), bufferStartIndex(0), bufferEndIndex(0),
-        bufferSize(0), writeRotation(rotationType), imageWriterInitialized(false), depthWriterInitialized(false),
-        parametersSet(true) {
+        WriteRecording(RecordingParameters(imageFormat, depthFormat, parameterFormat, parameters, parametersType,
+                                           rotationType), true, withOpenCV, rotationType) {
     this->initializeThreadAndBuffers(withOpenCV);
 }
 
@@ -46,38 +71,42 @@ WriteRecording::WriteRecording(double fps, int width, int height, float fx, floa
                                rs2_distortion model, const float *coefficients, const string &imageWriteFormat,
                                const string &depthWriteFormat, const string &parametersWriteFormat, bool withOpenCV,
                                RotationType rotationType) :
-        Recording(fps, width, height, fx, fy, ppx, ppy, model, coefficients, imageWriteFormat, depthWriteFormat,
-                  parametersWriteFormat, rotationType), imageBytesBuffer(), depthBytesBuffer(), countBuffer(),
-        writeFlag(true), bufferStartIndex(0), bufferEndIndex(0), bufferSize(0), writeRotation(rotationType),
-        imageWriterInitialized(false), depthWriterInitialized(false), parametersSet(true) {
+        WriteRecording(RecordingParameters(fps, width, height, fx, fy, ppx, ppy, model, coefficients,
+                                           imageWriteFormat, depthWriteFormat, parametersWriteFormat, rotationType),
+                       true, withOpenCV, rotationType) {
     this->initializeThreadAndBuffers(withOpenCV);
 }
 
 WriteRecording::WriteRecording(double fps, rs2_intrinsics intrinsics, const string &imageWriteFormat,
                                const string &depthWriteFormat, const string &parametersWriteFormat,
                                bool withOpenCV, RotationType rotationType) :
-        Recording(fps, intrinsics, imageWriteFormat, depthWriteFormat, parametersWriteFormat, rotationType),
-        imageBytesBuffer(), depthBytesBuffer(), countBuffer(), writeFlag(true), bufferStartIndex(0), bufferEndIndex(0),
-        bufferSize(0), writeRotation(rotationType), imageWriterInitialized(false), depthWriterInitialized(false),
-        parametersSet(true) {
+        WriteRecording(RecordingParameters(fps, intrinsics, imageWriteFormat, depthWriteFormat,
+                                           parametersWriteFormat, rotationType), true, withOpenCV, rotationType) {
     this->initializeThreadAndBuffers(withOpenCV);
 }
 
 WriteRecording::~WriteRecording() {
     cout << "Entering WriteRecording destructor!" << endl;
-    this->writeFlag = false;
+    this->buffer.close();
     cout << "Wait until all remaining frames have been written!" << endl;
-    this->writerThread.join();
+    this->imageWriterThread.join();
+    this->depthWriterThread.join();
     cout << "Finished writing!" << endl;
+    if (this->parameters.depthFormat == "rvl" && this->depthCodec.getNrEncodedBytes() > 0) {
+        cout << "Compressed the depth data by a factor of " << this->depthCodec.getCompressionRatio() << endl;
+    }
     this->parametersSet = false;
 
     this->releaseImageWriter();
     this->releaseDepthWriter();
+    this->releaseIndexWriter();
+    this->releaseContainerWriters();
 }
 
 void WriteRecording::setParameters(const rs2::video_stream_profile *_videoStreamProfile) {
     this->parameters.setParameters(_videoStreamProfile, this->writeRotation);
     this->parametersSet = true;
+    this->initializeSlabPool();
 }
 
 #ifdef OPENCV
@@ -85,6 +114,7 @@ void WriteRecording::setParameters(const rs2::video_stream_profile *_videoStream
 void WriteRecording::setParameters(const cv::VideoCapture *_videoCapture) {
     this->parameters.setParameters(_videoCapture, this->writeRotation);
     this->parametersSet = true;
+    this->initializeSlabPool();
 }
 
 #endif
@@ -92,17 +122,58 @@ void WriteRecording::setParameters(const cv::VideoCapture *_videoCapture) {
 void WriteRecording::setParameters(const RecordingParameters *_recordingParameters) {
     this->parameters.setParameters(_recordingParameters, this->writeRotation);
     this->parametersSet = true;
+    this->initializeSlabPool();
+}
+
+void WriteRecording::setDepthUnits(float depthUnits) {
+    if (depthUnits <= 0) {
+        throw runtime_error("Depth units have to be positive! Was " + to_string(depthUnits));
+    }
+    if (this->imageWriterInitialized || this->depthWriterInitialized) {
+        throw runtime_error("Can not change the depth units after the recording parameters have been written!");
+    }
+    this->parameters.depthUnits = depthUnits;
+}
+
+float WriteRecording::getDepthUnits() const {
+    return this->parameters.depthUnits;
+}
+
+void WriteRecording::setUnalignedDepth(double depthFps, const rs2_intrinsics &depthIntrinsics,
+                                       const rs2_extrinsics &depthToColor) {
+    if (this->imageWriterInitialized || this->depthWriterInitialized) {
+        throw runtime_error("Can not record unaligned depth after the recording parameters have been written!");
+    }
+    this->parameters.setUnalignedDepth(depthFps, depthIntrinsics, depthToColor);
+    this->initializeSlabPool();
+}
+
+void WriteRecording::setAlignedDepth() {
+    if (this->imageWriterInitialized || this->depthWriterInitialized) {
+        throw runtime_error("Can not align the depth after the recording parameters have been written!");
+    }
+    this->parameters.setAlignedDepth();
+    this->initializeSlabPool();
+}
+
+void WriteRecording::setImagePixelFormat(ImagePixelFormat format) {
+    if (this->imageWriterInitialized || this->depthWriterInitialized) {
+        throw runtime_error("Can not change the image pixel format after the recording parameters have been written!");
+    }
+    this->parameters.setImagePixelFormat(format);
+    this->initializeSlabPool();
 }
 
 void WriteRecording::setParameters(double fps, int width, int height, float fx, float fy, float ppx, float ppy,
                                    rs2_distortion model, const float *coefficients) {
     this->parameters.setParameters(fps, width, height, fx, fy, ppx, ppy, model, coefficients, this->writeRotation);
     this->parametersSet = true;
+    this->initializeSlabPool();
 }
 
 #ifdef OPENCV
 
-bool WriteRecording::writeData(cv::Mat *image, rs2::depth_frame *depth, unsigned long long counter) {
+WriteStatus WriteRecording::writeData(cv::Mat *image, rs2::depth_frame *depth, unsigned long long counter) {
     if (depth == nullptr) {
         return this->writeData(image, (cv::Mat *) nullptr, counter);
     }
@@ -110,348 +181,933 @@ bool WriteRecording::writeData(cv::Mat *image, rs2::depth_frame *depth, unsigned
     return this->writeData(image, &depthMat, counter);
 }
 
-bool WriteRecording::writeData(cv::Mat *image, cv::Mat *depth, unsigned long long counter) {
-    if ((image != nullptr && !this->imageWriterInitialized) || (depth != nullptr && !this->depthWriterInitialized)) {
-        if (!this->imageWriterInitialized && !this->depthWriterInitialized) {
-            if (!this->parametersSet) {
-                throw runtime_error("Parameters have not been set but tried to write data!");
-            }
-            // Write parameter data
-            this->parameters.serialize(this->parameterFile);
-            cout << "Wrote outputRecording data to file!" << endl;
+WriteStatus WriteRecording::writeData(cv::Mat *image, cv::Mat *depth, unsigned long long counter) {
+    LatencyHistogram::ScopedTimer enqueueTimer(this->enqueueLatency);
+    if (!this->initializeWriters(image != nullptr, depth != nullptr)) {
+        return WRITE_FAILED;
+    }
+
+    WriteStatus status;
+    int slot = this->acquireBufferSlot(status);
+    if (slot < 0) {
+        return status;
+    }
+
+    StreamFrameInfo hostInfo{-1, WriteRecording::getSystemTimestamp(), StreamFrameInfo::UNKNOWN_FRAME_NUMBER};
+    this->setSlotFrameInfo(slot, counter, hostInfo, hostInfo);
+
+    this->imageBytesBuffer[slot] = nullptr;
+    if (image != nullptr) {
+        int imageType = (this->parameters.imagePixelFormat == IMAGE_YUYV) ? CV_8UC2 : CV_8UC3;
+        if (image->rows != this->frameHeight || image->cols != this->frameWidth || image->type() != imageType) {
+            throw runtime_error("Image of size " + to_string(image->rows) + "x" + to_string(image->cols) +
+                                " and type " + to_string(image->type()) + " does not fit the write buffer slabs!");
         }
+        this->imageBytesBuffer[slot] = this->copyImageToSlab(slot, image->data, matByteSize(*image), image->step);
+    }
 
-        if (image != nullptr) {
-            if (!this->initializeImageWriter()) {
-                cout << "Can not initialize image writer..." << endl;
-                return false;
-            }
-            this->imageWriterInitialized = true;
+    this->depthBytesBuffer[slot] = nullptr;
+    if (depth != nullptr) {
+        if (depth->rows != this->depthFrameHeight || depth->cols != this->depthFrameWidth || depth->channels() != 1) {
+            throw runtime_error("Depth of size " + to_string(depth->rows) + "x" + to_string(depth->cols) +
+                                " does not fit the write buffer slabs!");
+        }
+        uint16_t *slab;
+        if (depth->type() == CV_16U) {
+            slab = this->copyDepthToSlab(slot, depth->ptr<uint16_t>(), depth->total(), depth->step1());
+        } else if (this->writeRotation == NO_ROTATION) {
+            // depth in meters is stored in the recording's depth units
+            slab = this->getDepthSlab(slot, depth->total());
+            cv::Mat slabDepth(this->depthFrameHeight, this->depthFrameWidth, CV_16UC1, slab);
+            depth->convertTo(slabDepth, CV_16U, 1.0 / this->parameters.depthUnits);
+        } else {
+            cv::Mat convertedDepth(this->depthFrameHeight, this->depthFrameWidth, CV_16UC1,
+                                   this->getDepthRotationScratch(depth->total()));
+            depth->convertTo(convertedDepth, CV_16U, 1.0 / this->parameters.depthUnits);
+            slab = this->copyDepthToSlab(slot, convertedDepth.ptr<uint16_t>(), depth->total(),
+                                         this->depthFrameWidth);
         }
+        this->depthBytesBuffer[slot] = slab;
+    }
 
+    this->publishBufferSlot(slot);
+
+    return status;
+}
+
+WriteStatus WriteRecording::writeData(cv::Mat &image, cv::Mat &depth, unsigned long long counter) {
+    return this->writeData(&image, &depth, counter);
+}
+
+#endif
+
+WriteStatus WriteRecording::writeData(rs2::video_frame *image, rs2::depth_frame *depth, unsigned long long counter) {
+    LatencyHistogram::ScopedTimer enqueueTimer(this->enqueueLatency);
+    rs2_format imageFrameFormat = (image != nullptr) ? image->get_profile().format() : RS2_FORMAT_ANY;
+    bool yuyvRecording = this->parameters.imagePixelFormat == IMAGE_YUYV;
+    if (image != nullptr && (imageFrameFormat == RS2_FORMAT_YUYV) != yuyvRecording) {
+        throw runtime_error("The image frames of format " + string(rs2_format_to_string(imageFrameFormat)) +
+                            " do not have the recording's pixel format " +
+                            imagePixelFormatToString(this->parameters.imagePixelFormat) + "!");
+    }
+    if (!this->initializeWriters(image != nullptr, depth != nullptr)) {
+        return WRITE_FAILED;
+    }
+
+    // only hold on to the frames while librealsense has enough of them left in its frame pool
+    bool holdFrames = this->nrHeldFrames.load() < this->maxHeldFrames;
+
+    WriteStatus status;
+    int slot = this->acquireBufferSlot(status);
+    if (slot < 0) {
+        return status;
+    }
+
+    FrameIndexEntry frameInfo = FrameIndexEntry::unknown();
+    if (image != nullptr) {
+        frameInfo.image = WriteRecording::getStreamFrameInfo(*image);
+    }
+    if (depth != nullptr) {
+        frameInfo.depth = WriteRecording::getStreamFrameInfo(*depth);
+    }
+    this->setSlotFrameInfo(slot, counter, frameInfo.image, frameInfo.depth);
+    this->imageBytesBuffer[slot] = nullptr;
+    this->depthBytesBuffer[slot] = nullptr;
+    if (holdFrames) {
+        if (image != nullptr) {
+            this->imageFrameBuffer[slot] = *image;
+        }
         if (depth != nullptr) {
-            if (!this->initializeDepthWriter()) {
-                cout << "Can not initialize depth writer..." << endl;
-                return false;
-            }
-            this->depthWriterInitialized = true;
+            this->depthFrameBuffer[slot] = *depth;
+        }
+        if (image != nullptr || depth != nullptr) {
+            this->nrHeldFrames++;
+        }
+    } else {
+        if (image != nullptr) {
+            this->imageBytesBuffer[slot] = this->prepareImageFrame(*image, slot, true);
+        }
+        if (depth != nullptr) {
+            this->depthBytesBuffer[slot] = this->prepareDepthFrame(*depth, slot, true);
         }
     }
 
-    while (this->bufferSize == WriteRecording::dataBufferSize) {
-        // this_thread::yield();  // ???
-    }
+    this->publishBufferSlot(slot);
 
-    this->countBuffer[this->bufferEndIndex] = counter;
+    return status;
+}
 
-    if (this->imageBuffer[this->bufferEndIndex] != nullptr) {
-        delete this->imageBuffer[this->bufferEndIndex];
-        this->imageBuffer[this->bufferEndIndex] = nullptr;
+WriteStatus WriteRecording::writeData(uint8_t *image, int nrImageElements, uint16_t *depth, int nrDepthElements,
+                                      unsigned long long counter) {
+    LatencyHistogram::ScopedTimer enqueueTimer(this->enqueueLatency);
+    if (!this->initializeWriters(image != nullptr, depth != nullptr)) {
+        return WRITE_FAILED;
     }
+
+    WriteStatus status;
+    int slot = this->acquireBufferSlot(status);
+    if (slot < 0) {
+        return status;
+    }
+
+    StreamFrameInfo hostInfo{-1, WriteRecording::getSystemTimestamp(), StreamFrameInfo::UNKNOWN_FRAME_NUMBER};
+    this->setSlotFrameInfo(slot, counter, hostInfo, hostInfo);
+
+    this->imageBytesBuffer[slot] = nullptr;
     if (image != nullptr) {
-        this->imageBuffer[this->bufferEndIndex] = new cv::Mat(*image);
+        this->imageBytesBuffer[slot] = this->copyImageToSlab(slot, image, nrImageElements,
+                                                             this->parameters.getImageBytesPerPixel() *
+                                                             (size_t) this->frameWidth);
+    }
+
+    this->depthBytesBuffer[slot] = nullptr;
+    if (depth != nullptr) {
+        this->depthBytesBuffer[slot] = this->copyDepthToSlab(slot, depth, nrDepthElements, this->depthFrameWidth);
     }
 
-    if (this->depthBuffer[this->bufferEndIndex] != nullptr) {
-        delete this->depthBuffer[this->bufferEndIndex];
-        this->depthBuffer[this->bufferEndIndex] = nullptr;
+    this->publishBufferSlot(slot);
+
+    return status;
+}
+
+template<class T>
+WriteStatus WriteRecording::writeMetersData(uint8_t *image, int nrImageElements, const T *depth,
+                                            int nrDepthElements, unsigned long long counter) {
+    LatencyHistogram::ScopedTimer enqueueTimer(this->enqueueLatency);
+    if (!this->initializeWriters(image != nullptr, depth != nullptr)) {
+        return WRITE_FAILED;
+    }
+
+    WriteStatus status;
+    int slot = this->acquireBufferSlot(status);
+    if (slot < 0) {
+        return status;
     }
+
+    StreamFrameInfo hostInfo{-1, WriteRecording::getSystemTimestamp(), StreamFrameInfo::UNKNOWN_FRAME_NUMBER};
+    this->setSlotFrameInfo(slot, counter, hostInfo, hostInfo);
+
+    this->imageBytesBuffer[slot] = nullptr;
+    if (image != nullptr) {
+        this->imageBytesBuffer[slot] = this->copyImageToSlab(slot, image, nrImageElements,
+                                                             this->parameters.getImageBytesPerPixel() *
+                                                             (size_t) this->frameWidth);
+    }
+
+    this->depthBytesBuffer[slot] = nullptr;
     if (depth != nullptr) {
-        this->depthBuffer[this->bufferEndIndex] = new cv::Mat(*depth);
+        uint16_t *slab;
+        if (this->writeRotation == NO_ROTATION) {
+            slab = this->getDepthSlab(slot, nrDepthElements);
+            DepthConversion::toDepthUnits(depth, slab, nrDepthElements, this->parameters.depthUnits);
+        } else {
+            uint16_t *convertedDepth = this->getDepthRotationScratch(nrDepthElements);
+            DepthConversion::toDepthUnits(depth, convertedDepth, nrDepthElements, this->parameters.depthUnits);
+            slab = this->copyDepthToSlab(slot, convertedDepth, nrDepthElements, this->depthFrameWidth);
+        }
+        this->depthBytesBuffer[slot] = slab;
     }
 
-    this->bufferEndIndex = (this->bufferEndIndex + 1) % WriteRecording::dataBufferSize;
+    this->publishBufferSlot(slot);
 
-    this->lock.lock();
-    this->bufferSize++;
-    this->lock.unlock();
+    return status;
+}
 
-    return true;
+WriteStatus WriteRecording::writeData(uint8_t *image, int nrImageElements, const double *depth, int nrDepthElements,
+                                      unsigned long long counter) {
+    return this->writeMetersData(image, nrImageElements, depth, nrDepthElements, counter);
 }
 
-bool WriteRecording::writeData(cv::Mat &image, cv::Mat &depth, unsigned long long counter) {
-    return this->writeData(&image, &depth, counter);
+WriteStatus WriteRecording::writeData(uint8_t *image, int nrImageElements, const float *depth, int nrDepthElements,
+                                      unsigned long long counter) {
+    return this->writeMetersData(image, nrImageElements, depth, nrDepthElements, counter);
 }
 
-#endif
+void WriteRecording::setMaxHeldFrames(int _maxHeldFrames) {
+    this->maxHeldFrames = _maxHeldFrames;
+}
 
-bool WriteRecording::writeData(rs2::video_frame *image, rs2::depth_frame *depth, unsigned long long counter) {
-    int imageDataType;
-    int nrImageElements = image->get_height() * image->get_width() * image->get_bytes_per_pixel();
-    auto *imageData = new uint8_t[nrImageElements];
-    frameToBytes(*image, imageData, imageDataType, nrImageElements);
-    assert (imageDataType == StandardTypes::TYPE_UINT_8);
-    int nrDepthElements = depth->get_height() * depth->get_width();
-    auto *depthData = new double[nrDepthElements];
-    depthFrameToMeters(*depth, depthData, nrDepthElements);
-    return this->writeData(imageData, nrImageElements, depthData, nrDepthElements, counter);
-}
-
-bool WriteRecording::writeData(uint8_t *image, int nrImageElements, uint16_t *depth, int nrDepthElements,
-                               unsigned long long counter) {
-    if ((image != nullptr && !this->imageWriterInitialized) || (depth != nullptr && !this->depthWriterInitialized)) {
-        if (!this->imageWriterInitialized && !this->depthWriterInitialized) {
-            if (!this->parametersSet) {
-                throw runtime_error("Parameters have not been set but tried to write data!");
-            }
-            // Write parameter data
-            this->parameters.serialize(this->parameterFile);
-            cout << "Wrote outputRecording data to file!" << endl;
-        }
+int WriteRecording::getMaxHeldFrames() const {
+    return this->maxHeldFrames;
+}
 
-        if (image != nullptr) {
-            if (!this->initializeImageWriter()) {
-                return false;
+int WriteRecording::getNrHeldFrames() const {
+    return this->nrHeldFrames.load();
+}
+
+void WriteRecording::setOverflowPolicy(BufferOverflowPolicy policy) {
+    this->overflowPolicy = policy;
+}
+
+BufferOverflowPolicy WriteRecording::getOverflowPolicy() const {
+    return this->overflowPolicy;
+}
+
+unsigned long long WriteRecording::getNrDroppedFrames() const {
+    return this->nrDroppedFrames.load();
+}
+
+int WriteRecording::getNrBufferedFrames() const {
+    return this->buffer.size();
+}
+
+unsigned long long WriteRecording::getNrSlabAllocations() const {
+    return this->slabPool.getNrAllocations();
+}
+
+void WriteRecording::setSegmentLimits(unsigned long long maxFrames, unsigned long long maxBytes, double maxSeconds) {
+    if (maxSeconds < 0) {
+        throw runtime_error("The segment duration can not be negative! Was " + to_string(maxSeconds));
+    }
+    this->segmentMaxFrames = maxFrames;
+    this->segmentMaxBytes = maxBytes;
+    this->segmentMaxSeconds = maxSeconds;
+}
+
+int WriteRecording::getNrSegments() const {
+    return this->producerSegment + 1;
+}
+
+void WriteRecording::getStats(nlohmann::json &stats) const {
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - this->statsStart).count();
+    unsigned long long nrBytes = this->nrWrittenBytes.load() - this->statsStartBytes;
+    unsigned long long nrFrames = std::max(this->nrWrittenImages.load(), this->nrWrittenDepths.load());
+    stats["elapsedSeconds"] = seconds;
+    this->enqueueLatency.to_json(stats["stages"]["writeData"]);
+    this->imageQueueLatency.to_json(stats["stages"]["imageQueue"]);
+    this->depthQueueLatency.to_json(stats["stages"]["depthQueue"]);
+    this->imageWriteLatency.to_json(stats["stages"]["writeImage"]);
+    this->depthWriteLatency.to_json(stats["stages"]["writeDepth"]);
+    stats["nrDroppedFrames"] = this->nrDroppedFrames.load() - this->statsStartDroppedFrames;
+    stats["nrWrittenImages"] = this->nrWrittenImages.load();
+    stats["nrWrittenDepths"] = this->nrWrittenDepths.load();
+    stats["nrWrittenBytes"] = nrBytes;
+    stats["framesPerSecond"] = (seconds > 0) ? (double) nrFrames / seconds : 0;
+    stats["megabytesPerSecond"] = (seconds > 0) ? (double) nrBytes / (1024.0 * 1024.0) / seconds : 0;
+    stats["queueDepth"] = this->buffer.size();
+    stats["maxQueueDepth"] = this->maxQueueDepth.load();
+}
+
+void WriteRecording::resetStats() {
+    this->enqueueLatency.reset();
+    this->imageQueueLatency.reset();
+    this->depthQueueLatency.reset();
+    this->imageWriteLatency.reset();
+    this->depthWriteLatency.reset();
+    this->nrWrittenImages = 0;
+    this->nrWrittenDepths = 0;
+    this->maxQueueDepth = 0;
+    this->statsStartBytes = this->nrWrittenBytes.load();
+    this->statsStartDroppedFrames = this->nrDroppedFrames.load();
+    this->statsStart = chrono::steady_clock::now();
+}
+
+WriteRecording::WriteRecording(bool iWillSetParametersLater, const std::string &imageWriteFormat,
+                               const std::string &depthWriteFormat, const std::string &parametersWriteFormat,
+                               bool withOpenCV, AndreiUtils::RotationType rotationType) :
+        WriteRecording(RecordingParameters(imageWriteFormat, depthWriteFormat, parametersWriteFormat, rotationType),
+                       false, withOpenCV, rotationType) {
+    if (!iWillSetParametersLater) {
+        throw runtime_error("When creating an empty WriteRecording, you must agree to set the parameters later!");
+    }
+    this->initializeThreadAndBuffers(withOpenCV);
+}
+
+void WriteRecording::imageThreadWrite(bool useOpenCV) {
+    int slot;
+    while ((slot = this->buffer.acquireReadSlot(WriteRecording::IMAGE_WRITER)) >= 0) {
+        this->imageQueueLatency.recordSince(this->publishTimeBuffer[slot]);
+        uint8_t *imageData = this->imageBytesBuffer[slot];
+        if (this->imageFrameBuffer[slot]) {
+            imageData = this->prepareImageFrame(this->imageFrameBuffer[slot].as<rs2::video_frame>(), slot, false);
+        }
+        int64_t offset = -1;
+        if (imageData != nullptr) {
+            int segment = this->segmentBuffer[slot];
+            if (segment != this->imageWriterSegment) {
+                this->startImageSegment(segment);
             }
-            this->imageWriterInitialized = true;
+            ofstream *containerWriter = this->getContainerWriter(segment);
+            if (containerWriter != nullptr) {
+                this->imageChunk.startPayload();
+            }
+            offset = this->getImageWriterOffset();
+            auto writeStart = chrono::steady_clock::now();
+            this->writeImageData(imageData, useOpenCV);
+            if (containerWriter != nullptr) {
+                this->nrWrittenBytes += this->imageChunk.getPayloadSize();
+                offset = this->imageChunk.append(containerWriter, this->containerLock, IMAGE_CHUNK);
+            } else if (offset >= 0) {
+                this->nrWrittenBytes += (unsigned long long) (this->getImageWriterOffset() - offset);
+            }
+            this->imageWriteLatency.recordSince(writeStart);
+            this->nrWrittenImages++;
         }
+        this->imageBytesBuffer[slot] = nullptr;
+        this->finishSlotStream(slot, WriteRecording::IMAGE_WRITER, offset, imageData != nullptr);
+    }
+}
 
-        if (depth != nullptr) {
-            if (!this->initializeDepthWriter()) {
-                return false;
+void WriteRecording::depthThreadWrite(bool useOpenCV) {
+    int slot;
+    while ((slot = this->buffer.acquireReadSlot(WriteRecording::DEPTH_WRITER)) >= 0) {
+        this->depthQueueLatency.recordSince(this->publishTimeBuffer[slot]);
+        uint16_t *depthData = this->depthBytesBuffer[slot];
+        if (this->depthFrameBuffer[slot]) {
+            depthData = this->prepareDepthFrame(this->depthFrameBuffer[slot].as<rs2::depth_frame>(), slot, false);
+        }
+        int64_t offset = -1;
+        if (depthData != nullptr) {
+            int segment = this->segmentBuffer[slot];
+            if (segment != this->depthWriterSegment) {
+                this->startDepthSegment(segment);
             }
-            this->depthWriterInitialized = true;
+            ofstream *containerWriter = this->getContainerWriter(segment);
+            if (containerWriter != nullptr) {
+                // encoded (e.g. "rvl") without holding the container's lock
+                this->depthChunk.startPayload();
+            }
+            offset = this->getDepthWriterOffset();
+            auto writeStart = chrono::steady_clock::now();
+            this->writeDepthData(depthData, useOpenCV);
+            if (containerWriter != nullptr) {
+                this->nrWrittenBytes += this->depthChunk.getPayloadSize();
+                offset = this->depthChunk.append(containerWriter, this->containerLock, DEPTH_CHUNK);
+            } else if (offset >= 0) {
+                this->nrWrittenBytes += (unsigned long long) (this->getDepthWriterOffset() - offset);
+            }
+            this->depthWriteLatency.recordSince(writeStart);
+            this->nrWrittenDepths++;
         }
+        this->depthBytesBuffer[slot] = nullptr;
+        this->finishSlotStream(slot, WriteRecording::DEPTH_WRITER, offset, depthData != nullptr);
     }
+}
 
-    while (this->bufferSize == WriteRecording::dataBufferSize) {
-        // this_thread::yield();  // ???
+void WriteRecording::finishSlotStream(int slot, int writer, int64_t offset, bool written) {
+    lock_guard<mutex> indexGuard(this->indexLock);
+    FrameIndexEntry &indexEntry = this->indexEntryBuffer[slot];
+    if (writer == WriteRecording::IMAGE_WRITER) {
+        indexEntry.imageOffset = offset;
+    } else {
+        indexEntry.depthOffset = offset;
+    }
+    if (written) {
+        this->nrWrittenStreamsBuffer[slot]++;
+    }
+    if (--this->nrPendingStreamsBuffer[slot] > 0) {
+        return;
+    }
+    // both writers handle the slots in the same order, so the entries of the last one are in frame order as well
+    if (this->nrWrittenStreamsBuffer[slot] > 0) {
+        this->writeIndexEntry(indexEntry, this->segmentBuffer[slot]);
     }
+    this->releaseHeldFrames(slot);
+}
 
-    this->countBuffer[this->bufferEndIndex] = counter;
+void WriteRecording::writeImageData(uint8_t *imageData, bool useOpenCV) {
+    // YUYV is written as it is, OpenCV does not write 2 channel images
+    if (useOpenCV && this->parameters.imagePixelFormat != IMAGE_YUYV) {
+        #ifdef OPENCV
+        cv::Mat image(this->parameters.height, this->parameters.width, CV_8UC3, imageData);
+        this->writeImage(&image);
+        #else
+        cout << "Can use opencv when writing images when opencv is not enabled!" << endl;
+        #endif
+        return;
+    }
+    this->writeImage(imageData);
+}
 
-    if (this->imageBytesBuffer[this->bufferEndIndex] != nullptr) {
-        delete[] this->imageBytesBuffer[this->bufferEndIndex];
-        this->imageBytesBuffer[this->bufferEndIndex] = nullptr;
+void WriteRecording::writeDepthData(uint16_t *depthData, bool useOpenCV) {
+    if (useOpenCV) {
+        #ifdef OPENCV
+        cv::Mat depth(this->parameters.getDepthHeight(), this->parameters.getDepthWidth(), CV_16UC1, depthData);
+        this->writeDepth(&depth);
+        #else
+        cout << "Can use opencv when writing images when opencv is not enabled!" << endl;
+        #endif
+        return;
     }
-    if (image != nullptr) {
-        this->imageBytesBuffer[this->bufferEndIndex] = new uint8_t[nrImageElements];
-        fastMemCopy(this->imageBytesBuffer[this->bufferEndIndex], image, nrImageElements);
+    this->writeDepth(depthData);
+}
+
+uint8_t *WriteRecording::prepareImageFrame(const rs2::video_frame &frame, int slot, bool forceCopy) {
+    int height = frame.get_height(), width = frame.get_width(), stride = frame.get_stride_in_bytes();
+    size_t rowSize = (size_t) width * frame.get_bytes_per_pixel();
+    auto *frameData = (uint8_t *) frame.get_data();
+    // the OpenCV writers expect BGR data
+    bool swapChannels = this->writeWithOpenCV && frame.get_profile().format() == RS2_FORMAT_RGB8;
+    if (!forceCopy && !swapChannels && (size_t) stride == rowSize && this->writeRotation == NO_ROTATION) {
+        // not rotated data is not modified by the writers: serialize straight from the librealsense buffer
+        return frameData;
     }
 
-    if (this->depthBytesBuffer[this->bufferEndIndex] != nullptr) {
-        delete[] this->depthBytesBuffer[this->bufferEndIndex];
-        this->depthBytesBuffer[this->bufferEndIndex] = nullptr;
+    if (swapChannels) {
+        #ifdef OPENCV
+        uint8_t *slab;
+        if (this->writeRotation == NO_ROTATION) {
+            slab = this->getImageSlab(slot, height * rowSize);
+            cv::Mat slabImage(height, width, CV_8UC3, slab);
+            cv::cvtColor(cv::Mat(height, width, CV_8UC3, frameData, stride), slabImage, cv::COLOR_RGB2BGR);
+        } else {
+            // the channels of the rotated copy are swapped in place
+            slab = this->copyImageToSlab(slot, frameData, height * rowSize, stride);
+            cv::Mat slabImage(this->parameters.height, this->parameters.width, CV_8UC3, slab);
+            cv::cvtColor(slabImage, slabImage, cv::COLOR_RGB2BGR);
+        }
+        return slab;
+        #endif
     }
-    if (depth != nullptr) {
-        this->depthBytesBuffer[this->bufferEndIndex] = new uint16_t[nrDepthElements];
-        fastMemCopy(this->depthBytesBuffer[this->bufferEndIndex], depth, nrDepthElements);
+    return this->copyImageToSlab(slot, frameData, height * rowSize, stride);
+}
+
+uint16_t *WriteRecording::prepareDepthFrame(const rs2::depth_frame &frame, int slot, bool forceCopy) {
+    int height = frame.get_height(), width = frame.get_width();
+    int stride = frame.get_stride_in_bytes() / (int) sizeof(uint16_t);
+    auto *frameData = (uint16_t *) frame.get_data();
+    // the Z16 values are only rescaled if the sensor's depth units differ from the recording's
+    float scale = frame.get_units() / this->parameters.depthUnits;
+    bool convert = fabs(scale - 1) > 1e-4;
+    if (!forceCopy && !convert && stride == width && this->writeRotation == NO_ROTATION) {
+        return frameData;
     }
 
-    this->bufferEndIndex = (this->bufferEndIndex + 1) % WriteRecording::dataBufferSize;
+    if (convert && this->writeRotation == NO_ROTATION) {
+        uint16_t *slab = this->getDepthSlab(slot, (size_t) height * width);
+        for (int row = 0; row < height; row++) {
+            DepthConversion::rescale(frameData + (size_t) row * stride, slab + (size_t) row * width, width, scale);
+        }
+        return slab;
+    }
+    uint16_t *slab = this->copyDepthToSlab(slot, frameData, (size_t) height * width, stride);
+    if (convert) {
+        // the rotated copy is rescaled in place
+        DepthConversion::rescale(slab, slab, (size_t) height * width, scale);
+    }
+    return slab;
+}
 
-    this->lock.lock();
-    this->bufferSize++;
-    this->lock.unlock();
+void WriteRecording::releaseHeldFrames(int slot) {
+    if (this->imageFrameBuffer[slot] || this->depthFrameBuffer[slot]) {
+        this->imageFrameBuffer[slot] = rs2::frame();
+        this->depthFrameBuffer[slot] = rs2::frame();
+        this->nrHeldFrames--;
+    }
+}
 
-    return true;
+double WriteRecording::getSystemTimestamp() {
+    return chrono::duration<double, milli>(chrono::system_clock::now().time_since_epoch()).count();
+}
+
+StreamFrameInfo WriteRecording::getStreamFrameInfo(const rs2::frame &frame) {
+    StreamFrameInfo info{-1, -1, frame.get_frame_number()};
+    if (frame.supports_frame_metadata(RS2_FRAME_METADATA_FRAME_TIMESTAMP)) {
+        // in microseconds
+        info.hardwareTimestamp = (double) frame.get_frame_metadata(RS2_FRAME_METADATA_FRAME_TIMESTAMP) / 1000.0;
+    } else if (frame.get_frame_timestamp_domain() == RS2_TIMESTAMP_DOMAIN_HARDWARE_CLOCK) {
+        info.hardwareTimestamp = frame.get_timestamp();
+    }
+    if (frame.supports_frame_metadata(RS2_FRAME_METADATA_TIME_OF_ARRIVAL)) {
+        info.systemTimestamp = (double) frame.get_frame_metadata(RS2_FRAME_METADATA_TIME_OF_ARRIVAL);
+    } else if (frame.get_frame_timestamp_domain() == RS2_TIMESTAMP_DOMAIN_SYSTEM_TIME) {
+        info.systemTimestamp = frame.get_timestamp();
+    } else {
+        info.systemTimestamp = WriteRecording::getSystemTimestamp();
+    }
+    return info;
+}
+
+void WriteRecording::setSlotFrameInfo(int slot, unsigned long long counter, const StreamFrameInfo &imageInfo,
+                                      const StreamFrameInfo &depthInfo) {
+    FrameIndexEntry &entry = this->indexEntryBuffer[slot];
+    entry.imageOffset = -1;
+    entry.depthOffset = -1;
+    entry.counter = counter;
+    entry.image = imageInfo;
+    entry.depth = depthInfo;
+}
+
+int64_t WriteRecording::getImageWriterOffset() const {
+    // avi frames (without a codec) are found by their frame number instead; the chunks of containers get their
+    // offset when they are appended
+    if (this->imageFrameCodec != nullptr && this->imageWriterBinary != nullptr && !this->isContainer()) {
+        return (int64_t) this->imageWriterBinary->tellp();
+    }
+    return -1;
+}
+
+int64_t WriteRecording::getDepthWriterOffset() const {
+    if (this->depthFrameCodec != nullptr && this->depthWriterBinary != nullptr && !this->isContainer()) {
+        return (int64_t) this->depthWriterBinary->tellp();
+    }
+    return -1;
+}
+
+void WriteRecording::writeIndexEntry(const FrameIndexEntry &entry, int segment) {
+    if (segment != this->indexWriterSegment) {
+        this->startIndexSegment(segment);
+    }
+    if (this->isContainer()) {
+        RecordingIndex::writeEntry(this->indexChunk.startPayload(), entry);
+        this->indexChunk.append(this->getContainerWriter(segment), this->containerLock, METADATA_CHUNK);
+        return;
+    }
+    if (this->indexWriterBinary == nullptr) {
+        return;
+    }
+    RecordingIndex::writeEntry(this->indexWriterBinary, entry);
 }
 
-bool WriteRecording::writeData(uint8_t *image, int nrImageElements, const double *depth, int nrDepthElements,
-                               unsigned long long counter) {
-    if ((image != nullptr && !this->imageWriterInitialized) || (depth != nullptr && !this->depthWriterInitialized)) {
+bool WriteRecording::initializeWriters(bool withImage, bool withDepth) {
+    if ((withImage && !this->imageWriterInitialized) || (withDepth && !this->depthWriterInitialized)) {
         if (!this->imageWriterInitialized && !this->depthWriterInitialized) {
             if (!this->parametersSet) {
                 throw runtime_error("Parameters have not been set but tried to write data!");
             }
-            // Write parameter data
-            this->parameters.serialize(this->parameterFile);
-            cout << "Wrote outputRecording data to file!" << endl;
+            // the parameters are final from here on
+            this->imageFrameCodec = FrameCodec::createImageCodec(this->parameters);
+            this->depthFrameCodec = FrameCodec::createDepthCodec(this->parameters, this->depthCodec);
+            if (this->isContainer()) {
+                this->getContainerWriter(0);
+                cout << "Wrote outputRecording data to the container!" << endl;
+            } else {
+                // Write parameter data
+                this->parameters.serialize(this->parameterFile);
+                cout << "Wrote outputRecording data to file!" << endl;
+
+                this->indexWriterBinary = new ofstream(this->indexFile, fstream::binary);
+                RecordingIndex::writeHeader(this->indexWriterBinary);
+            }
         }
 
-        if (image != nullptr) {
+        if (withImage && !this->imageWriterInitialized) {
             if (!this->initializeImageWriter()) {
+                cout << "Can not initialize image writer..." << endl;
                 return false;
             }
             this->imageWriterInitialized = true;
         }
 
-        if (depth != nullptr) {
+        if (withDepth && !this->depthWriterInitialized) {
             if (!this->initializeDepthWriter()) {
+                cout << "Can not initialize depth writer..." << endl;
                 return false;
             }
             this->depthWriterInitialized = true;
         }
     }
+    return true;
+}
 
-    while (this->bufferSize == WriteRecording::dataBufferSize) {
-        // this_thread::yield();  // ???
+int WriteRecording::acquireBufferSlot(WriteStatus &status) {
+    bool droppedOldest;
+    int slot = this->buffer.acquireWriteSlot(this->overflowPolicy, droppedOldest);
+    if (slot < 0) {
+        if (this->buffer.isClosed()) {
+            status = WRITE_FAILED;
+        } else {
+            status = WRITE_DROPPED_NEWEST;
+            this->nrDroppedFrames++;
+        }
+        return slot;
     }
+    if (droppedOldest) {
+        status = WRITE_DROPPED_OLDEST;
+        this->nrDroppedFrames++;
+        this->releaseHeldFrames(slot);
+    } else {
+        status = WRITE_ENQUEUED;
+    }
+    return slot;
+}
 
-    this->countBuffer[this->bufferEndIndex] = counter;
+void WriteRecording::publishBufferSlot(int slot) {
+    this->segmentBuffer[slot] = this->selectSegment(slot);
+    {
+        lock_guard<mutex> indexGuard(this->indexLock);
+        this->nrPendingStreamsBuffer[slot] = WriteRecording::NR_STREAM_WRITERS;
+        this->nrWrittenStreamsBuffer[slot] = 0;
+    }
+    this->publishTimeBuffer[slot] = chrono::steady_clock::now();
+    this->buffer.publishWriteSlot();
+    int queueDepth = this->buffer.size();
+    // resetStats may zero the maximum concurrently
+    int previousMax = this->maxQueueDepth.load(memory_order_relaxed);
+    while (queueDepth > previousMax &&
+           !this->maxQueueDepth.compare_exchange_weak(previousMax, queueDepth, memory_order_relaxed)) {}
+}
 
-    if (this->imageBytesBuffer[this->bufferEndIndex] != nullptr) {
-        delete[] this->imageBytesBuffer[this->bufferEndIndex];
-        this->imageBytesBuffer[this->bufferEndIndex] = nullptr;
+int WriteRecording::selectSegment(int slot) {
+    auto now = chrono::steady_clock::now();
+    unsigned long long nrFrameBytes = this->getSlotFrameBytes(slot);
+    if (this->nrSegmentFrames > 0) {
+        double seconds = chrono::duration<double>(now - this->segmentStart).count();
+        // the frame starts the next segment if it does not fit into the current one anymore
+        if ((this->segmentMaxFrames > 0 && this->nrSegmentFrames >= this->segmentMaxFrames) ||
+            (this->segmentMaxBytes > 0 && this->nrSegmentBytes + nrFrameBytes > this->segmentMaxBytes) ||
+            (this->segmentMaxSeconds > 0 && seconds >= this->segmentMaxSeconds)) {
+            this->producerSegment++;
+            this->nrSegmentFrames = 0;
+        }
     }
-    if (image != nullptr) {
-        this->imageBytesBuffer[this->bufferEndIndex] = new uint8_t[nrImageElements];
-        fastMemCopy(this->imageBytesBuffer[this->bufferEndIndex], image, nrImageElements);
+    if (this->nrSegmentFrames == 0) {
+        this->segmentStart = now;
+        this->nrSegmentBytes = 0;
     }
+    this->nrSegmentFrames++;
+    this->nrSegmentBytes += nrFrameBytes;
+    return this->producerSegment;
+}
 
-    if (this->depthBytesBuffer[this->bufferEndIndex] != nullptr) {
-        delete[] this->depthBytesBuffer[this->bufferEndIndex];
-        this->depthBytesBuffer[this->bufferEndIndex] = nullptr;
+unsigned long long WriteRecording::getSlotFrameBytes(int slot) const {
+    // the codecs are resolved before the first frame is buffered
+    unsigned long long nrBytes = 0;
+    bool hasImage = this->imageBytesBuffer[slot] != nullptr || this->imageFrameBuffer[slot];
+    if (hasImage && this->imageFrameCodec != nullptr) {
+        nrBytes += this->imageFrameCodec->getNrBytes();
     }
-    if (depth != nullptr) {
-        this->depthBytesBuffer[this->bufferEndIndex] = new uint16_t[nrDepthElements];
-        #pragma omp parallel for shared(depth, nrDepthElements) default(none)
-        for (size_t i = 0; i < nrDepthElements; i++) {
-            this->depthBytesBuffer[this->bufferEndIndex][i] = (uint16_t) (depth[i] * 1000);
-        }
+    bool hasDepth = this->depthBytesBuffer[slot] != nullptr || this->depthFrameBuffer[slot];
+    if (hasDepth && this->depthFrameCodec != nullptr) {
+        nrBytes += this->depthFrameCodec->getNrBytes();
     }
+    return nrBytes;
+}
 
-    this->bufferEndIndex = (this->bufferEndIndex + 1) % WriteRecording::dataBufferSize;
+void WriteRecording::startImageSegment(int segment) {
+    this->releaseImageWriter();
+    this->imageWriterSegment = segment;
+    if (!this->initializeImageWriter()) {
+        throw runtime_error("Can not initialize the image writer of segment " + to_string(segment));
+    }
+}
 
-    this->lock.lock();
-    this->bufferSize++;
-    this->lock.unlock();
+void WriteRecording::startDepthSegment(int segment) {
+    this->releaseDepthWriter();
+    this->depthWriterSegment = segment;
+    if (!this->initializeDepthWriter()) {
+        throw runtime_error("Can not initialize the depth writer of segment " + to_string(segment));
+    }
+}
 
-    return true;
+void WriteRecording::startIndexSegment(int segment) {
+    // the entries come in frame order: all frames of the previous segment are written
+    if (this->isContainer()) {
+        this->releaseContainerWriter(this->indexWriterSegment);
+    } else if (this->indexWriterBinary != nullptr) {
+        this->releaseIndexWriter();
+        this->indexWriterBinary = new ofstream(Recording::getSegmentFile(this->indexFile, segment), fstream::binary);
+        RecordingIndex::writeHeader(this->indexWriterBinary);
+    }
+    this->indexWriterSegment = segment;
 }
 
-WriteRecording::WriteRecording(bool iWillSetParametersLater, const std::string &imageWriteFormat,
-                               const std::string &depthWriteFormat, const std::string &parametersWriteFormat,
-                               bool withOpenCV, AndreiUtils::RotationType rotationType) :
-        Recording(imageWriteFormat, depthWriteFormat, parametersWriteFormat, rotationType), imageBytesBuffer(),
-        depthBytesBuffer(), countBuffer(), writeFlag(true), bufferStartIndex(0), bufferEndIndex(0), bufferSize(0),
-        writeRotation(rotationType), imageWriterInitialized(false), depthWriterInitialized(false),
-        parametersSet(false) {
-    if (!iWillSetParametersLater) {
-        throw runtime_error("When creating an empty WriteRecording, you must agree to set the parameters later!");
+ofstream *WriteRecording::getContainerWriter(int segment) {
+    if (!this->isContainer()) {
+        return nullptr;
     }
-    this->initializeThreadAndBuffers(withOpenCV);
+    lock_guard<mutex> containerGuard(this->containerLock);
+    ofstream *&containerWriter = this->containerWriters[segment];
+    if (containerWriter == nullptr) {
+        containerWriter = new ofstream(Recording::getSegmentFile(this->parameterFile, segment), fstream::binary);
+        RecordingContainer::writeHeader(containerWriter, this->parameters);
+    }
+    return containerWriter;
 }
 
-void WriteRecording::bufferThreadWrite(bool useOpenCV) {
-    while (this->writeFlag || this->bufferSize > 0) {
-        while (this->writeFlag && this->bufferSize == 0) {
-            this_thread::yield();
-        }
-        if (this->bufferSize == 0) {
-            break;
-        }
+void WriteRecording::initializeSlabPool() {
+    if (!this->parameters.isInitialized()) {
+        return;
+    }
+    // the parameters are the ones of the rotated frames
+    ImageRotation::getRotatedSize(this->writeRotation, this->parameters.height, this->parameters.width,
+                                  this->frameHeight, this->frameWidth);
+    ImageRotation::getRotatedSize(this->writeRotation, this->parameters.getDepthHeight(),
+                                  this->parameters.getDepthWidth(), this->depthFrameHeight, this->depthFrameWidth);
+    size_t nrPixels = (size_t) this->frameHeight * this->frameWidth;
+    size_t nrDepthPixels = (size_t) this->depthFrameHeight * this->depthFrameWidth;
+    int nrSlots = this->buffer.getNrSlots();
+    this->slabPool.reset(nrSlots, this->parameters.getImageBytesPerPixel() * nrPixels, nrDepthPixels);
+    this->slabPool.preallocate(WriteRecording::nrPreallocatedFrames);
+}
 
-        if (useOpenCV) {
-            #ifdef OPENCV
-            cv::Mat *data;
-            if (this->imageBuffer[this->bufferStartIndex] != nullptr) {
-                data = this->imageBuffer[this->bufferStartIndex];
-                this->writeImage(data);
-                delete data;
-                this->imageBuffer[this->bufferStartIndex] = nullptr;
-            }
-            if (this->depthBuffer[this->bufferStartIndex] != nullptr) {
-                data = this->depthBuffer[this->bufferStartIndex];
-                this->writeDepth(data);
-                delete data;
-                this->depthBuffer[this->bufferStartIndex] = nullptr;
-            }
-            #else
-            cout << "Can use opencv when writing images when opencv is not enabled!" << endl;
-            #endif
-        } else {
-            if (this->imageBytesBuffer[this->bufferStartIndex] != nullptr) {
-                this->writeImage(this->imageBytesBuffer[this->bufferStartIndex]);
-                delete[] this->imageBytesBuffer[this->bufferStartIndex];
-                this->imageBytesBuffer[this->bufferStartIndex] = nullptr;
-            }
-            if (this->depthBytesBuffer[this->bufferStartIndex] != nullptr) {
-                this->writeDepth(this->depthBytesBuffer[this->bufferStartIndex]);
-                delete[] this->depthBytesBuffer[this->bufferStartIndex];
-                this->depthBytesBuffer[this->bufferStartIndex] = nullptr;
-            }
+uint8_t *WriteRecording::getImageSlab(int slot, size_t nrImageBytes) {
+    if (!this->slabPool.isInitialized()) {
+        throw runtime_error("The write buffer slabs are not initialized: parameters have not been set!");
+    }
+    if (nrImageBytes > this->slabPool.getNrImageBytes()) {
+        throw runtime_error("Image of " + to_string(nrImageBytes) + " bytes does not fit the write buffer slabs of " +
+                            to_string(this->slabPool.getNrImageBytes()) + " bytes!");
+    }
+    return this->slabPool.getImageSlab(slot);
+}
+
+uint16_t *WriteRecording::getDepthSlab(int slot, size_t nrDepthElements) {
+    if (!this->slabPool.isInitialized()) {
+        throw runtime_error("The write buffer slabs are not initialized: parameters have not been set!");
+    }
+    if (nrDepthElements > this->slabPool.getNrDepthElements()) {
+        throw runtime_error("Depth of " + to_string(nrDepthElements) + " elements does not fit the write buffer " +
+                            "slabs of " + to_string(this->slabPool.getNrDepthElements()) + " elements!");
+    }
+    return this->slabPool.getDepthSlab(slot);
+}
+
+uint8_t *WriteRecording::copyImageToSlab(int slot, uint8_t *image, size_t nrImageBytes, size_t stride) {
+    uint8_t *slab = this->getImageSlab(slot, nrImageBytes);
+    size_t rowSize = this->parameters.getImageBytesPerPixel() * (size_t) this->frameWidth;
+    if (this->writeRotation == NO_ROTATION && stride == rowSize) {
+        fastMemCopy(slab, image, nrImageBytes);
+        return slab;
+    }
+    if (nrImageBytes != rowSize * this->frameHeight) {
+        throw runtime_error("Image of " + to_string(nrImageBytes) + " bytes does not have the written frame size " +
+                            to_string(this->frameHeight) + "x" + to_string(this->frameWidth) + "!");
+    }
+    if (this->parameters.imagePixelFormat == IMAGE_YUYV) {
+        // YUYV images are not rotated: only the padding of the rows is dropped
+        for (int row = 0; row < this->frameHeight; row++) {
+            fastMemCopy(slab + row * rowSize, image + row * stride, rowSize);
         }
+        return slab;
+    }
+    ImageRotation::rotateImage(image, this->frameHeight, this->frameWidth, stride, slab, this->writeRotation);
+    return slab;
+}
 
-        this->bufferStartIndex = (this->bufferStartIndex + 1) % WriteRecording::dataBufferSize;
+uint16_t *WriteRecording::copyDepthToSlab(int slot, uint16_t *depth, size_t nrDepthElements, size_t stride) {
+    uint16_t *slab = this->getDepthSlab(slot, nrDepthElements);
+    if (this->writeRotation == NO_ROTATION && stride == (size_t) this->depthFrameWidth) {
+        fastMemCopy(slab, depth, nrDepthElements);
+        return slab;
+    }
+    if (nrDepthElements != (size_t) this->depthFrameHeight * this->depthFrameWidth) {
+        throw runtime_error("Depth of " + to_string(nrDepthElements) + " elements does not have the written frame " +
+                            "size " + to_string(this->depthFrameHeight) + "x" + to_string(this->depthFrameWidth) +
+                            "!");
+    }
+    ImageRotation::rotateDepth(depth, this->depthFrameHeight, this->depthFrameWidth, stride, slab,
+                               this->writeRotation);
+    return slab;
+}
 
-        this->lock.lock();
-        this->bufferSize--;
-        this->lock.unlock();
+uint16_t *WriteRecording::getDepthRotationScratch(size_t nrDepthElements) {
+    if (this->depthRotationScratch.size() < nrDepthElements) {
+        this->depthRotationScratch.resize(nrDepthElements);
     }
+    return this->depthRotationScratch.data();
 }
 
-void WriteRecording::initializeThreadAndBuffers(bool withOpenCV) {
-    this->writerThread = thread(&WriteRecording::bufferThreadWrite, this, withOpenCV);
-    if (WriteRecording::dataBufferSize == 0) {
+void WriteRecording::setBufferSize(int bufferSize) {
+    WriteRecording::readConfig();
+    if (bufferSize < 1) {
+        throw runtime_error("Can not work with a buffer size < 1! Was " + to_string(bufferSize));
+    }
+    WriteRecording::dataBufferSize = bufferSize;
+}
+
+void WriteRecording::setNrPreallocatedFrames(int nrFrames) {
+    WriteRecording::readConfig();
+    if (nrFrames < 0) {
+        throw runtime_error("Can not preallocate a negative number of frames! Was " + to_string(nrFrames));
+    }
+    WriteRecording::nrPreallocatedFrames = nrFrames;
+}
+
+void WriteRecording::readConfig() {
+    if (!WriteRecording::configRead) {
         if (RealsenseRecording::configDirectoryLocation.empty()) {
             throw runtime_error("RealsenseRecording: configDirectoryLocation is not set...");
         }
         auto config = readJsonFile(RealsenseRecording::configDirectoryLocation + "recordingOutputDirectory.cfg");
         WriteRecording::dataBufferSize = config["writeBufferSize"].get<int>();
-        if (WriteRecording::dataBufferSize< 1) {
+        if (WriteRecording::dataBufferSize < 1) {
             throw runtime_error(
                     "Can not work with a buffer size < 1! Was " + to_string(WriteRecording::dataBufferSize));
         }
+        if (config.contains("writeBufferOverflowPolicy")) {
+            WriteRecording::defaultOverflowPolicy = bufferOverflowPolicyFromString(
+                    config["writeBufferOverflowPolicy"].get<string>());
+        }
+        if (config.contains("writePreallocatedFrames")) {
+            WriteRecording::nrPreallocatedFrames = config["writePreallocatedFrames"].get<int>();
+        }
+        if (config.contains("writeMaxHeldFrames")) {
+            WriteRecording::defaultMaxHeldFrames = config["writeMaxHeldFrames"].get<int>();
+        }
+        if (config.contains("depthCompressionChunks")) {
+            WriteRecording::nrDepthCodecChunks = config["depthCompressionChunks"].get<int>();
+        }
+        if (config.contains("segmentMaxFrames")) {
+            WriteRecording::defaultSegmentMaxFrames = config["segmentMaxFrames"].get<unsigned long long>();
+        }
+        if (config.contains("segmentMaxBytes")) {
+            WriteRecording::defaultSegmentMaxBytes = config["segmentMaxBytes"].get<unsigned long long>();
+        }
+        if (config.contains("segmentMaxSeconds")) {
+            WriteRecording::defaultSegmentMaxSeconds = config["segmentMaxSeconds"].get<double>();
+        }
+        WriteRecording::configRead = true;
     }
+}
 
-    #ifdef OPENCV
-    this->imageBuffer.resize(WriteRecording::dataBufferSize);
-    this->depthBuffer.resize(WriteRecording::dataBufferSize);
-    #endif
-    this->imageBytesBuffer.resize(WriteRecording::dataBufferSize);
-    this->depthBytesBuffer.resize(WriteRecording::dataBufferSize);
-    this->countBuffer.resize(WriteRecording::dataBufferSize);
+void WriteRecording::initializeThreadAndBuffers(bool withOpenCV) {
+    WriteRecording::readConfig();
+    this->overflowPolicy = WriteRecording::defaultOverflowPolicy;
+    this->maxHeldFrames = WriteRecording::defaultMaxHeldFrames;
+    this->setSegmentLimits(WriteRecording::defaultSegmentMaxFrames, WriteRecording::defaultSegmentMaxBytes,
+                           WriteRecording::defaultSegmentMaxSeconds);
+    this->writeWithOpenCV = withOpenCV;
+    this->buffer.reset(WriteRecording::dataBufferSize, WriteRecording::NR_STREAM_WRITERS);
+
+    int nrSlots = this->buffer.getNrSlots();
+    this->imageBytesBuffer.assign(nrSlots, nullptr);
+    this->depthBytesBuffer.assign(nrSlots, nullptr);
+    this->imageFrameBuffer.assign(nrSlots, rs2::frame());
+    this->depthFrameBuffer.assign(nrSlots, rs2::frame());
+    this->indexEntryBuffer.assign(nrSlots, FrameIndexEntry::unknown());
+    this->nrPendingStreamsBuffer.assign(nrSlots, 0);
+    this->nrWrittenStreamsBuffer.assign(nrSlots, 0);
+    this->segmentBuffer.assign(nrSlots, 0);
+    this->publishTimeBuffer.assign(nrSlots, chrono::steady_clock::time_point());
+    this->initializeSlabPool();
+
+    // only start consuming once the buffers are in place; the streams are encoded and written independently, so the
+    // throughput is bounded by the slower stream instead of by the sum of both
+    this->imageWriterThread = thread(&WriteRecording::imageThreadWrite, this, withOpenCV);
+    this->depthWriterThread = thread(&WriteRecording::depthThreadWrite, this, withOpenCV);
 }
 
 #ifdef OPENCV
 
 void WriteRecording::writeImage(cv::Mat *image) {
-    imageRotation(image, this->writeRotation);
-    if (this->parameters.imageFormat == "avi") {
-        if (this->imageWriter == nullptr) {
-            throw runtime_error("Image writer is nullptr although it shouldn't be at this moment...");
-        }
-        this->imageWriter->write(*image);
-        return;
-    } else if (this->parameters.imageFormat == "bin") {
-        matWriteBinary(this->imageWriterBinary, *image);
+    if (this->imageFrameCodec != nullptr) {
+        this->imageFrameCodec->write(this->imageWriterBinary, *image);
         return;
     }
-    throw runtime_error("Unknown image format: \"" + this->parameters.imageFormat + "\"");
+    if (this->imageWriter == nullptr) {
+        throw runtime_error("Image writer is nullptr although it shouldn't be at this moment...");
+    }
+    this->imageWriter->write(*image);
 }
 
 void WriteRecording::writeDepth(cv::Mat *depth) {
-    imageRotation(depth, this->writeRotation);
-    if (this->parameters.depthFormat == "bin") {
-        cv::Mat convertedData;
-        convertDepthToMillimetersUInt16(depth, convertedData);
-        matWriteBinary(this->depthWriterBinary, convertedData);
+    if (depth->type() == CV_16U) {
+        this->depthFrameCodec->write(this->depthWriterBinary, *depth);
         return;
     }
-    throw runtime_error("Unknown depth format: \"" + this->parameters.depthFormat + "\"");
+    cv::Mat convertedData;
+    this->convertDepthToUnits(depth, convertedData);
+    this->depthFrameCodec->write(this->depthWriterBinary, convertedData);
+}
+
+void WriteRecording::convertDepthToUnits(cv::Mat *depth, cv::Mat &converted) const {
+    if (depth->type() != CV_64FC1 && depth->type() != CV_32FC1) {
+        convertDepthToMillimetersUInt16(depth, converted);
+        return;
+    }
+    converted.create(depth->rows, depth->cols, CV_16UC1);
+    for (int row = 0; row < depth->rows; row++) {
+        if (depth->type() == CV_64FC1) {
+            DepthConversion::toDepthUnits(depth->ptr<double>(row), converted.ptr<uint16_t>(row), depth->cols,
+                                          this->parameters.depthUnits);
+        } else {
+            DepthConversion::toDepthUnits(depth->ptr<float>(row), converted.ptr<uint16_t>(row), depth->cols,
+                                          this->parameters.depthUnits);
+        }
+    }
 }
 
 #endif
 
 void WriteRecording::writeImage(uint8_t *imageData) {
-    imageDataRotation(imageData, this->writeRotation, AndreiUtils::TYPE_UINT_8, this->parameters.height,
-                      this->parameters.width, 3);
-    if (this->parameters.imageFormat == "bin") {
-        writeColorImageBinary(this->imageWriterBinary, imageData, this->parameters.height, this->parameters.width,
-                              AndreiUtils::TYPE_UINT_8);
-        return;
+    if (this->imageFrameCodec == nullptr) {
+        throw runtime_error("Can not write images in \"" + this->parameters.imageFormat + "\" format without opencv");
     }
-    throw runtime_error("Unknown image format: \"" + this->parameters.imageFormat + "\"");
+    this->imageFrameCodec->write(this->imageWriterBinary, imageData);
 }
 
 void WriteRecording::writeDepth(uint16_t *depthData) {
-    imageDataRotation((uint8_t *) depthData, this->writeRotation, AndreiUtils::TYPE_UINT_16, this->parameters.height,
-                      this->parameters.width, 1);
-    if (this->parameters.depthFormat == "bin") {
-        writeDepthImageBinary(this->depthWriterBinary, depthData, this->parameters.height, this->parameters.width);
-        return;
-    }
-    throw runtime_error("Unknown depth format: \"" + this->parameters.depthFormat + "\"");
+    this->depthFrameCodec->write(this->depthWriterBinary, (const uint8_t *) depthData);
 }
 
 bool WriteRecording::initializeImageWriter() {
-    if (this->parameters.imageFormat == "avi") {
+    if (this->isContainer()) {
+        if (this->parameters.imageFormat != "bin") {
+            throw runtime_error("A recording container can only hold images in \"bin\" format, not \"" +
+                                this->parameters.imageFormat + "\"");
+        }
+        // the chunks are appended to the container of their segment by imageThreadWrite
+        this->getContainerWriter(this->imageWriterSegment);
+        this->imageWriterBinary = this->imageChunk.startPayload();
+        return true;
+    } else if (this->parameters.imageFormat == "avi") {
         #ifdef OPENCV
         auto fourcc = cv::VideoWriter::fourcc('M', 'J', 'P', 'G');
         auto size = cv::Size(this->parameters.width, this->parameters.height);
 
-        this->imageWriter = new cv::VideoWriter(this->imageFile, fourcc, this->parameters.fps, size, true);
+        string segmentFile = Recording::getSegmentFile(this->imageFile, this->imageWriterSegment);
+        this->imageWriter = new cv::VideoWriter(segmentFile, fourcc, this->parameters.fps, size, true);
         if (!this->imageWriter->isOpened()) {
             delete this->imageWriter;
             this->imageWriter = nullptr;
@@ -463,15 +1119,23 @@ bool WriteRecording::initializeImageWriter() {
         throw runtime_error("Can not initialize image writer in avi format when opencv is not enabled");
         #endif
     } else if (this->parameters.imageFormat == "bin") {
-        this->imageWriterBinary = new ofstream(this->imageFile, fstream::binary);
+        this->imageWriterBinary = new ofstream(Recording::getSegmentFile(this->imageFile, this->imageWriterSegment),
+                                               fstream::binary);
         return true;
     }
     throw runtime_error("Unknown image format: \"" + this->parameters.imageFormat + "\"");
 }
 
 bool WriteRecording::initializeDepthWriter() {
-    if (this->parameters.depthFormat == "bin") {
-        this->depthWriterBinary = new ofstream(this->depthFile, fstream::binary);
+    if (this->parameters.depthFormat == "bin" || this->parameters.depthFormat == "rvl") {
+        this->depthCodec.setNrChunks(WriteRecording::nrDepthCodecChunks);
+        if (this->isContainer()) {
+            this->getContainerWriter(this->depthWriterSegment);
+            this->depthWriterBinary = this->depthChunk.startPayload();
+        } else {
+            this->depthWriterBinary = new ofstream(Recording::getSegmentFile(this->depthFile, this->depthWriterSegment),
+                                                   fstream::binary);
+        }
         return true;
     }
     throw runtime_error("Unknown depth format: \"" + this->parameters.depthFormat + "\"");
@@ -480,21 +1144,25 @@ bool WriteRecording::initializeDepthWriter() {
 void WriteRecording::releaseImageWriter() {
     if (this->parameters.imageFormat.empty()) {
         return;
+    } else if (this->isContainer()) {
+        // released together with the container
+        this->imageWriterBinary = nullptr;
+        return;
     } else if (this->parameters.imageFormat == "avi") {
         #ifdef OPENCV
         if (this->imageWriter != nullptr) {
             this->imageWriter->release();
         }
         delete this->imageWriter;
+        this->imageWriter = nullptr;
         #else
         cout << "Warning: releasing image writer in imageFormat avi when OPENCV is not enabled" << endl;
         #endif
         return;
     } else if (this->parameters.imageFormat == "bin") {
-        if (this->imageWriterBinary != nullptr) {
-            this->imageWriterBinary->close();
-        }
+        // closes the file
         delete this->imageWriterBinary;
+        this->imageWriterBinary = nullptr;
         return;
     }
     throw runtime_error("Unknown image format: \"" + this->parameters.imageFormat + "\"");
@@ -503,12 +1171,45 @@ void WriteRecording::releaseImageWriter() {
 void WriteRecording::releaseDepthWriter() {
     if (this->parameters.depthFormat.empty()) {
         return;
-    } else if (this->parameters.depthFormat == "bin") {
-        if (this->depthWriterBinary != nullptr) {
-            this->depthWriterBinary->close();
-        }
+    } else if (this->isContainer()) {
+        this->depthWriterBinary = nullptr;
+        return;
+    } else if (this->parameters.depthFormat == "bin" || this->parameters.depthFormat == "rvl") {
         delete this->depthWriterBinary;
+        this->depthWriterBinary = nullptr;
         return;
     }
     throw runtime_error("Unknown depth format: \"" + this->parameters.depthFormat + "\"");
 }
+
+void WriteRecording::releaseIndexWriter() {
+    if (this->indexWriterBinary != nullptr) {
+        this->indexWriterBinary->close();
+    }
+    delete this->indexWriterBinary;
+    this->indexWriterBinary = nullptr;
+}
+
+void WriteRecording::releaseContainerWriter(int segment) {
+    lock_guard<mutex> containerGuard(this->containerLock);
+    auto containerWriter = this->containerWriters.find(segment);
+    if (containerWriter == this->containerWriters.end()) {
+        return;
+    }
+    // the footer is collected from the metadata chunks, so that indexing a frame does not grow an index in memory
+    containerWriter->second->flush();
+    RecordingIndex footerIndex;
+    RecordingContainer::indexChunks(Recording::getSegmentFile(this->parameterFile, segment), footerIndex);
+    RecordingContainer::writeFooter(containerWriter->second, footerIndex);
+    containerWriter->second->close();
+    delete containerWriter->second;
+    this->containerWriters.erase(containerWriter);
+}
+
+void WriteRecording::releaseContainerWriters() {
+    this->releaseContainerWriter(this->indexWriterSegment);
+    // containers of segments without any indexed frame
+    while (!this->containerWriters.empty()) {
+        this->releaseContainerWriter(this->containerWriters.begin()->first);
+    }
+}
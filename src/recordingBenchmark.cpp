@@ -0,0 +1,334 @@
+#include <algorithm>
+#include <AndreiUtils/utilsFiles.h>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <ctime>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <new>
+#include <RealsenseRecording/RealsenseCapture.h>
+#include <RealsenseRecording/recording/ReadRecording.h>
+#include <RealsenseRecording/recording/WriteRecording.h>
+#include <RealsenseRecording/utils.h>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace AndreiUtils;
+using namespace RealsenseRecording;
+using namespace std;
+
+struct BenchmarkOptions {
+    int width, height, nrFrames, bufferSize, fileNumber;
+    // 0: write the frames as fast as possible
+    double fps;
+};
+
+struct BenchmarkCase {
+    string imageFormat, depthFormat, parametersFormat;
+    bool withOpenCV;
+    RotationType rotation;
+};
+
+// the synthetic frames are cycled through, so that generating them does not count
+const int NR_DISTINCT_FRAMES = 16;
+// the frames written before the allocations are counted: the writers open their files and size their buffers on them
+const int NR_WARM_UP_FRAMES = NR_DISTINCT_FRAMES;
+
+// the heap allocations of the process, to check that writing, reading and replaying frame after frame into the same
+// buffers does not allocate
+atomic<unsigned long long> nrAllocations(0);
+
+void *operator new(size_t size) {
+    nrAllocations++;
+    void *memory = malloc((size > 0) ? size : 1);
+    if (memory == nullptr) {
+        throw bad_alloc();
+    }
+    return memory;
+}
+
+void operator delete(void *memory) noexcept {
+    free(memory);
+}
+
+// the sized deallocation of C++14 would otherwise free the counted allocations through the default operator delete
+void operator delete(void *memory, size_t) noexcept {
+    operator delete(memory);
+}
+
+string rotationToString(RotationType rotation) {
+    switch (rotation) {
+        case NO_ROTATION:
+            return "none";
+        case LEFT_90:
+            return "left90";
+        case LEFT_180:
+            return "left180";
+        case LEFT_270:
+            return "left270";
+    }
+    return "unknown";
+}
+
+vector<BenchmarkCase> getBenchmarkCases() {
+    vector<BenchmarkCase> cases;
+    vector<pair<string, bool>> imageWriters = {{"bin", false}};
+    #ifdef OPENCV
+    // the avi image writer always works on cv::Mat
+    imageWriters.emplace_back("bin", true);
+    imageWriters.emplace_back("avi", true);
+    #endif
+    for (const auto &imageWriter: imageWriters) {
+        for (const string depthFormat: {"bin", "rvl"}) {
+            for (RotationType rotation: {NO_ROTATION, LEFT_90, LEFT_180, LEFT_270}) {
+                cases.push_back(BenchmarkCase{imageWriter.first, depthFormat, "json", imageWriter.second, rotation});
+            }
+        }
+    }
+    // the containers stage the chunks of both streams in memory before appending them
+    for (const string depthFormat: {"bin", "rvl"}) {
+        cases.push_back(BenchmarkCase{"bin", depthFormat, "rsrec", false, NO_ROTATION});
+    }
+    return cases;
+}
+
+void generateFrames(int height, int width, vector<vector<uint8_t>> &images, vector<vector<uint16_t>> &depths) {
+    images.assign(NR_DISTINCT_FRAMES, vector<uint8_t>((size_t) 3 * height * width));
+    depths.assign(NR_DISTINCT_FRAMES, vector<uint16_t>((size_t) height * width));
+    for (int f = 0; f < NR_DISTINCT_FRAMES; f++) {
+        uint8_t *image = images[f].data();
+        uint16_t *depth = depths[f].data();
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                size_t i = (size_t) y * width + x;
+                image[3 * i] = (uint8_t) (x + 4 * f);
+                image[3 * i + 1] = (uint8_t) (y + 2 * f);
+                image[3 * i + 2] = (uint8_t) ((x + y) / 2);
+                // a slanted plane with sensor-like noise and invalid pixels
+                bool hole = (x * 7 + y * 13 + f) % 37 == 0;
+                depth[i] = hole ? 0 : (uint16_t) (800 + 2 * y + x / 4 + (x * 31 + y * 17 + f) % 5);
+            }
+        }
+    }
+}
+
+double getCpuSeconds() {
+    // of all threads of the process
+    return (double) clock() / CLOCKS_PER_SEC;
+}
+
+void deleteRecording(int fileNumber, const BenchmarkCase &benchmarkCase) {
+    string directory = Recording::getOutputDirectory();
+    for (const string &file: {Recording::format(fileNumber, "parameters", "json"),
+                              Recording::format(fileNumber, "video", benchmarkCase.imageFormat),
+                              Recording::format(fileNumber, "depth", benchmarkCase.depthFormat),
+                              Recording::format(fileNumber, "index", "bin"),
+                              Recording::format(fileNumber, "container", "rsrec")}) {
+        if (fileExists(directory + file)) {
+            deleteFile(directory + file);
+        }
+    }
+}
+
+WriteRecording *createWriter(const BenchmarkCase &benchmarkCase, const BenchmarkOptions &options, int fileNumber) {
+    int height = options.height, width = options.width;
+    float coefficients[5] = {0, 0, 0, 0, 0};
+    auto *writer = new WriteRecording((options.fps > 0) ? options.fps : 30, width, height, (float) width,
+                                      (float) width, (float) width / 2, (float) height / 2, RS2_DISTORTION_NONE,
+                                      coefficients, benchmarkCase.imageFormat, benchmarkCase.depthFormat,
+                                      benchmarkCase.parametersFormat, benchmarkCase.withOpenCV, benchmarkCase.rotation);
+    writer->setFiles(false, fileNumber);
+    return writer;
+}
+
+// Writes the frames [firstFrame, lastFrame), paced from start on; returns how many of them were not enqueued
+unsigned long long writeFrames(WriteRecording *writer, const BenchmarkCase &benchmarkCase,
+                               const BenchmarkOptions &options, int firstFrame, int lastFrame,
+                               chrono::steady_clock::time_point start, vector<vector<uint8_t>> &images,
+                               vector<vector<uint16_t>> &depths) {
+    int height = options.height, width = options.width, nrPixels = height * width;
+    unsigned long long nrNotEnqueued = 0;
+    for (int f = firstFrame; f < lastFrame; f++) {
+        if (options.fps > 0) {
+            this_thread::sleep_until(start + chrono::duration_cast<chrono::steady_clock::duration>(
+                    chrono::duration<double>(f / options.fps)));
+        }
+        uint8_t *image = images[f % NR_DISTINCT_FRAMES].data();
+        uint16_t *depth = depths[f % NR_DISTINCT_FRAMES].data();
+        WriteStatus status;
+        if (benchmarkCase.withOpenCV) {
+            #ifdef OPENCV
+            cv::Mat imageMat(height, width, CV_8UC3, image), depthMat(height, width, CV_16UC1, depth);
+            status = writer->writeData(&imageMat, &depthMat, f);
+            #else
+            throw runtime_error("Can not benchmark the opencv writers when opencv is not enabled");
+            #endif
+        } else {
+            status = writer->writeData(image, 3 * nrPixels, depth, nrPixels, f);
+        }
+        if (!writeStatusEnqueued(status)) {
+            nrNotEnqueued++;
+        }
+    }
+    return nrNotEnqueued;
+}
+
+void waitForBufferedFrames(const WriteRecording *writer) {
+    // a frame leaves the buffer once both writer threads are done with it
+    while (writer->getNrBufferedFrames() > 0) {
+        this_thread::sleep_for(chrono::milliseconds(1));
+    }
+}
+
+// The allocations of replaying the recording like RealsenseRecord does, without loading the recording (e.g. its
+// index) in the constructor
+unsigned long long countReplayAllocations(int fileNumber, int replayPrefetchSize) {
+    RealsenseCapture capture(30, false, fileNumber, "", 0, 0, 0, 0, "bin", "bin", "json", false, true, false, false,
+                             replayPrefetchSize);
+    capture.setHeadless(true);
+    unsigned long long allocationsStart = nrAllocations.load();
+    capture.run();
+    return nrAllocations.load() - allocationsStart;
+}
+
+// Replays a recording of nrFrames and one of twice as many frames: the longer replay allocates more only if frames
+// after the first ones allocate. The conversions of live frames (RealsenseCapture::convertImage and convertDepth)
+// need a camera and are not covered.
+bool checkReplayAllocations(const BenchmarkCase &benchmarkCase, const BenchmarkOptions &options,
+                            vector<vector<uint8_t>> &images, vector<vector<uint16_t>> &depths) {
+    BenchmarkOptions replayOptions = options;
+    // the replay follows the recorded timestamps, so it is as fast as the writing
+    replayOptions.fps = 0;
+    bool allocationFree = true;
+    for (int replayPrefetchSize: {0, 2}) {
+        unsigned long long nrReplayAllocations[2];
+        for (int i = 0; i < 2; i++) {
+            WriteRecording *writer = createWriter(benchmarkCase, replayOptions, options.fileNumber);
+            writeFrames(writer, benchmarkCase, replayOptions, 0, (i + 1) * options.nrFrames,
+                        chrono::steady_clock::now(), images, depths);
+            delete writer;
+            nrReplayAllocations[i] = countReplayAllocations(options.fileNumber, replayPrefetchSize);
+            deleteRecording(options.fileNumber, benchmarkCase);
+        }
+        unsigned long long nrSteadyAllocations = (nrReplayAllocations[1] > nrReplayAllocations[0]) ?
+                                                 nrReplayAllocations[1] - nrReplayAllocations[0] : 0;
+        cout << "\treplay with prefetch " << replayPrefetchSize << ": " << nrSteadyAllocations
+             << " allocs after the first " << options.nrFrames << " frames" << endl;
+        allocationFree = allocationFree && nrSteadyAllocations == 0;
+    }
+    return allocationFree;
+}
+
+// Returns false if writing, reading or replaying allocated after the warm-up
+bool runBenchmarkCase(const BenchmarkCase &benchmarkCase, const BenchmarkOptions &options,
+                      vector<vector<uint8_t>> &images, vector<vector<uint16_t>> &depths) {
+    double frameMB = (double) options.height * options.width * (3 + sizeof(uint16_t)) / (1024.0 * 1024.0);
+
+    WriteRecording *writer = createWriter(benchmarkCase, options, options.fileNumber);
+    int nrWarmUpFrames = min(NR_WARM_UP_FRAMES, options.nrFrames);
+    double cpuStart = getCpuSeconds();
+    auto start = chrono::steady_clock::now();
+    unsigned long long nrNotEnqueued = writeFrames(writer, benchmarkCase, options, 0, nrWarmUpFrames, start, images,
+                                                   depths);
+    // counted until the writer threads are done with the frames after the warm-up
+    waitForBufferedFrames(writer);
+    unsigned long long allocationsStart = nrAllocations.load();
+    nrNotEnqueued += writeFrames(writer, benchmarkCase, options, nrWarmUpFrames, options.nrFrames, start, images,
+                                 depths);
+    waitForBufferedFrames(writer);
+    unsigned long long nrWriteAllocations = nrAllocations.load() - allocationsStart;
+    nlohmann::json stats;
+    writer->getStats(stats);
+    // closes the files
+    delete writer;
+    double writeSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    double writeCpuSeconds = getCpuSeconds() - cpuStart;
+    unsigned long long nrWrittenFrames = options.nrFrames - nrNotEnqueued;
+
+    ReadRecording reader(options.fileNumber);
+    uint8_t *image = nullptr;
+    uint16_t *depth = nullptr;
+    int nrReadFrames = 0;
+    // counted from the second frame on: the first one allocates the buffers
+    allocationsStart = 0;
+    cpuStart = getCpuSeconds();
+    start = chrono::steady_clock::now();
+    while (reader.readData(&image, &depth)) {
+        if (++nrReadFrames == 1) {
+            allocationsStart = nrAllocations.load();
+        }
+    }
+    double readSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    double readCpuSeconds = getCpuSeconds() - cpuStart;
+    unsigned long long nrReadAllocations = (nrReadFrames > 1) ? nrAllocations.load() - allocationsStart : 0;
+    delete[] image;
+    delete[] depth;
+    deleteRecording(options.fileNumber, benchmarkCase);
+
+    cout << setw(4) << benchmarkCase.imageFormat << setw(5) << benchmarkCase.depthFormat << setw(6)
+         << benchmarkCase.parametersFormat << setw(7) << (benchmarkCase.withOpenCV ? "opencv" : "raw") << setw(9)
+         << rotationToString(benchmarkCase.rotation) << fixed << setprecision(1)
+         << " | write " << setw(7) << nrWrittenFrames / writeSeconds << " fps " << setw(7)
+         << nrWrittenFrames * frameMB / writeSeconds << " MB/s " << setw(6) << writeCpuSeconds << " s cpu, queue "
+         << stats["maxQueueDepth"].get<int>() << ", dropped " << nrNotEnqueued
+         << " | read " << setw(7) << nrReadFrames / readSeconds << " fps " << setw(7)
+         << nrReadFrames * frameMB / readSeconds << " MB/s " << setw(6) << readCpuSeconds << " s cpu"
+         << " | allocs after warm-up: write " << nrWriteAllocations << ", read " << nrReadAllocations << endl;
+    if ((unsigned long long) nrReadFrames != nrWrittenFrames) {
+        cout << "\tRead back " << nrReadFrames << " frames but wrote " << nrWrittenFrames << "!" << endl;
+    }
+    // the avi encoder of OpenCV allocates on its own
+    bool allocationFree = nrReadAllocations == 0 && (nrWriteAllocations == 0 || benchmarkCase.imageFormat == "avi");
+    if (benchmarkCase.imageFormat == "bin" && !benchmarkCase.withOpenCV && benchmarkCase.rotation == NO_ROTATION) {
+        allocationFree = checkReplayAllocations(benchmarkCase, options, images, depths) && allocationFree;
+    }
+    return allocationFree;
+}
+
+int main(int argc, char **argv) {
+    BenchmarkOptions options{640, 480, 300, 32, 9999, 0};
+    if (argc > 7 || (argc > 1 && (string(argv[1]) == "-h" || string(argv[1]) == "--help"))) {
+        cout << "Usage: " << argv[0] << " [width] [height] [fps (0: unpaced)] [nrFrames] [bufferSize] [fileNumber]"
+             << endl;
+        return 1;
+    }
+    setConfigDirectoryLocation("../config/");
+
+    try {
+        options.width = (argc > 1) ? stoi(argv[1]) : options.width;
+        options.height = (argc > 2) ? stoi(argv[2]) : options.height;
+        options.fps = (argc > 3) ? stod(argv[3]) : options.fps;
+        options.nrFrames = (argc > 4) ? stoi(argv[4]) : options.nrFrames;
+        options.bufferSize = (argc > 5) ? stoi(argv[5]) : options.bufferSize;
+        options.fileNumber = (argc > 6) ? stoi(argv[6]) : options.fileNumber;
+        WriteRecording::setBufferSize(options.bufferSize);
+        // all slots of the buffer, so that no slab is allocated when the queue first gets deeper after the warm-up
+        WriteRecording::setNrPreallocatedFrames(numeric_limits<int>::max());
+
+        cout << options.nrFrames << " frames of " << options.width << "x" << options.height << " at "
+             << ((options.fps > 0) ? to_string(options.fps) + " fps" : string("full speed")) << ", buffer of "
+             << options.bufferSize << " frames" << endl;
+        vector<vector<uint8_t>> images;
+        vector<vector<uint16_t>> depths;
+        generateFrames(options.height, options.width, images, depths);
+        int nrAllocatingCases = 0;
+        for (const auto &benchmarkCase: getBenchmarkCases()) {
+            if (!runBenchmarkCase(benchmarkCase, options, images, depths)) {
+                nrAllocatingCases++;
+            }
+        }
+        if (nrAllocatingCases > 0) {
+            cout << nrAllocatingCases << " of the cases allocated after the warm-up!" << endl;
+            return 1;
+        }
+    } catch (exception &ex) {
+        cout << "Caught exception while benchmarking the recordings: " << ex.what() << endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,236 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <librealsense2/hpp/rs_internal.hpp>
+#include <librealsense2/rs.hpp>
+#include <RealsenseRecording/recording/DepthRegistration.h>
+#include <RealsenseRecording/recording/ReadRecording.h>
+#include <RealsenseRecording/utils.h>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace RealsenseRecording;
+using namespace std;
+
+const float DEPTH_UNITS = 0.001f;
+
+// the registration may differ from rs2::align on at most this fraction of the pixels aligned by rs2::align: the
+// rounding of the corners may differ at pixel borders, moving a depth by one color pixel
+const double MAX_DIFFERENT_PIXELS = 0.01;
+
+// A software device with the calibration of a depth and a color camera, whose frames are aligned by the real
+// rs2::align
+class SoftwareCamera {
+public:
+    SoftwareCamera(const rs2_intrinsics &_depthIntrinsics, const rs2_intrinsics &_colorIntrinsics,
+                   const rs2_extrinsics &depthToColor, float _depthUnits) :
+            device(), depthSensor(this->device.add_sensor("Depth")), colorSensor(this->device.add_sensor("Color")),
+            depthProfile(), colorProfile(), frameSyncer(),
+            colorImage((size_t) _colorIntrinsics.height * _colorIntrinsics.width * 3),
+            depthIntrinsics(_depthIntrinsics), colorIntrinsics(_colorIntrinsics), depthUnits(_depthUnits), nrFrames(0) {
+        this->depthProfile = this->depthSensor.add_video_stream(
+                {RS2_STREAM_DEPTH, 0, 0, _depthIntrinsics.width, _depthIntrinsics.height, 30, 2, RS2_FORMAT_Z16,
+                 _depthIntrinsics});
+        this->colorProfile = this->colorSensor.add_video_stream(
+                {RS2_STREAM_COLOR, 0, 1, _colorIntrinsics.width, _colorIntrinsics.height, 30, 3, RS2_FORMAT_RGB8,
+                 _colorIntrinsics});
+        this->depthSensor.add_read_only_option(RS2_OPTION_DEPTH_UNITS, _depthUnits);
+        this->depthProfile.register_extrinsics_to(this->colorProfile, depthToColor);
+        this->device.create_matcher(RS2_MATCHER_DLR_C);
+        this->depthSensor.open(this->depthProfile);
+        this->colorSensor.open(this->colorProfile);
+        this->depthSensor.start(this->frameSyncer);
+        this->colorSensor.start(this->frameSyncer);
+    }
+
+    ~SoftwareCamera() {
+        this->depthSensor.stop();
+        this->colorSensor.stop();
+        this->depthSensor.close();
+        this->colorSensor.close();
+    }
+
+    // The depth frame (which has to outlive the frameset) with a black color frame
+    rs2::frameset capture(const uint16_t *depth) {
+        this->nrFrames++;
+        double timestamp = this->nrFrames * 1000.0 / 30;
+        this->depthSensor.on_video_frame({(void *) depth, [](void *) {}, this->depthIntrinsics.width * 2, 2, timestamp,
+                                          RS2_TIMESTAMP_DOMAIN_HARDWARE_CLOCK, this->nrFrames,
+                                          this->depthProfile.get(), this->depthUnits});
+        this->colorSensor.on_video_frame({this->colorImage.data(), [](void *) {}, this->colorIntrinsics.width * 3, 3,
+                                          timestamp, RS2_TIMESTAMP_DOMAIN_HARDWARE_CLOCK, this->nrFrames,
+                                          this->colorProfile.get(), 0});
+        rs2::frameset frames;
+        do {
+            frames = this->frameSyncer.wait_for_frames(5000);
+        } while (!frames.get_depth_frame() || !frames.get_color_frame());
+        return frames;
+    }
+
+private:
+    rs2::software_device device;
+    rs2::software_sensor depthSensor, colorSensor;
+    rs2::stream_profile depthProfile, colorProfile;
+    rs2::syncer frameSyncer;
+    vector<uint8_t> colorImage;
+    rs2_intrinsics depthIntrinsics, colorIntrinsics;
+    float depthUnits;
+    int nrFrames;
+};
+
+rs2_intrinsics createIntrinsics(int width, int height, float focalLength, rs2_distortion model, float k1) {
+    rs2_intrinsics intrinsics{};
+    intrinsics.width = width;
+    intrinsics.height = height;
+    intrinsics.fx = focalLength;
+    intrinsics.fy = focalLength;
+    intrinsics.ppx = (float) width / 2 - 0.3f;
+    intrinsics.ppy = (float) height / 2 + 0.2f;
+    intrinsics.model = model;
+    intrinsics.coeffs[0] = k1;
+    return intrinsics;
+}
+
+// a slanted wall with a box in front of it (whose edges occlude the wall in the color camera) and invalid pixels
+void generateDepth(int height, int width, vector<uint16_t> &depth) {
+    depth.resize((size_t) height * width);
+    for (int v = 0; v < height; v++) {
+        for (int u = 0; u < width; u++) {
+            bool box = abs(u - width / 2) < width / 6 && abs(v - height / 2) < height / 5;
+            bool invalid = (u * 7 + v * 13) % 53 == 0 || u < width / 20;
+            depth[(size_t) v * width + u] = invalid ? 0 : (uint16_t) (box ? 900 : 2000 + u + v / 2);
+        }
+    }
+}
+
+// in milliseconds per frame
+double measureMilliseconds(const function<void()> &registerFrame, int nrIterations) {
+    registerFrame();
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < nrIterations; i++) {
+        registerFrame();
+    }
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() / nrIterations;
+}
+
+void compareRegistrations(const string &configuration, const vector<uint16_t> &depth,
+                          const rs2_intrinsics &depthIntrinsics, const rs2_intrinsics &colorIntrinsics,
+                          const rs2_extrinsics &depthToColor, float depthUnits, int nrIterations) {
+    size_t nrColorPixels = (size_t) colorIntrinsics.height * colorIntrinsics.width;
+    vector<uint16_t> aligned(nrColorPixels), registered(nrColorPixels);
+
+    SoftwareCamera camera(depthIntrinsics, colorIntrinsics, depthToColor, depthUnits);
+    rs2::frameset frames = camera.capture(depth.data());
+    rs2::align align(RS2_STREAM_COLOR);
+    rs2::depth_frame alignedFrame = align.process(frames).get_depth_frame();
+    double alignMs = measureMilliseconds([&]() {
+        alignedFrame = align.process(frames).get_depth_frame();
+    }, nrIterations);
+    if (alignedFrame.get_width() != colorIntrinsics.width || alignedFrame.get_height() != colorIntrinsics.height) {
+        throw runtime_error("rs2::align did not align the depth of the " + configuration + " configuration to the "
+                            "color camera");
+    }
+    for (int v = 0; v < colorIntrinsics.height; v++) {
+        memcpy(aligned.data() + (size_t) v * colorIntrinsics.width,
+               (const uint8_t *) alignedFrame.get_data() + (size_t) v * alignedFrame.get_stride_in_bytes(),
+               (size_t) colorIntrinsics.width * sizeof(uint16_t));
+    }
+
+    auto start = chrono::steady_clock::now();
+    DepthRegistration registration;
+    registration.setParameters(depthIntrinsics, colorIntrinsics, depthToColor, depthUnits);
+    double setupMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+    cout << configuration << ": " << depthIntrinsics.width << "x" << depthIntrinsics.height << " depth to "
+         << colorIntrinsics.width << "x" << colorIntrinsics.height << " color; rs2::align " << fixed
+         << setprecision(3) << alignMs << " ms, lookup table setup " << setupMs << " ms" << endl;
+    for (int nrBands: {1, DepthRegistration::DEFAULT_NR_BANDS}) {
+        registration.setNrBands(nrBands);
+        double registrationMs = measureMilliseconds([&]() {
+            registration.registerDepth(depth.data(), registered.data());
+        }, nrIterations);
+
+        size_t nrDifferent = 0, nrAligned = 0;
+        int maxDifference = 0;
+        for (size_t i = 0; i < nrColorPixels; i++) {
+            nrAligned += aligned[i] != 0;
+            if (aligned[i] != registered[i]) {
+                nrDifferent++;
+                maxDifference = max(maxDifference, abs((int) aligned[i] - (int) registered[i]));
+            }
+        }
+        cout << "    " << setw(2) << nrBands << " bands " << setprecision(3) << setw(8) << registrationMs << " ms | x"
+             << setprecision(2) << alignMs / registrationMs << " | " << nrDifferent << " of " << nrAligned
+             << " aligned pixels differ (" << setprecision(4) << 100.0 * nrDifferent / max(nrAligned, (size_t) 1)
+             << "%), by at most " << maxDifference << " depth units" << endl;
+        if ((double) nrDifferent > MAX_DIFFERENT_PIXELS * (double) nrAligned) {
+            throw runtime_error("The registration of the " + configuration + " configuration differs from "
+                                "rs2::align in more than " + to_string(100 * MAX_DIFFERENT_PIXELS) +
+                                "% of the aligned pixels");
+        }
+    }
+}
+
+void compareRecordedRegistration(int fileNumber, int nrIterations) {
+    ReadRecording recording(fileNumber);
+    RecordingParameters parameters = *recording.getParameters();
+    if (!parameters.hasUnalignedDepth()) {
+        throw runtime_error("The depth of recording " + to_string(fileNumber) + " is already aligned to the image");
+    }
+    uint8_t *image = nullptr;
+    uint16_t *recordedDepth = nullptr;
+    bool readSuccess = recording.readData(&image, &recordedDepth);
+    vector<uint16_t> depth;
+    if (readSuccess) {
+        depth.assign(recordedDepth, recordedDepth + (size_t) parameters.getDepthHeight() * parameters.getDepthWidth());
+    }
+    delete[] image;
+    delete[] recordedDepth;
+    if (!readSuccess) {
+        throw runtime_error("Recording " + to_string(fileNumber) + " has no frames");
+    }
+    compareRegistrations("recording " + to_string(fileNumber), depth, parameters.getDepthIntrinsics(),
+                         parameters.getIntrinsics(), parameters.getDepthToColorExtrinsics(), parameters.depthUnits,
+                         nrIterations);
+}
+
+int main(int argc, char **argv) {
+    if (argc > 3 || (argc > 1 && (string(argv[1]) == "-h" || string(argv[1]) == "--help"))) {
+        cout << "Usage: " << argv[0] << " [nrIterations [recordedFileNumber]]" << endl;
+        return 1;
+    }
+    setConfigDirectoryLocation("../config/");
+
+    try {
+        int nrIterations = (argc > 1) ? stoi(argv[1]) : 20;
+        // similar to a D435: the depth camera 15mm to the left of the slightly rotated color camera
+        rs2_extrinsics depthToColor{{0.99998f, 0.0052f, -0.0031f, -0.0052f, 0.99998f, 0.0012f, 0.0031f, -0.0012f,
+                                     0.99999f}, {0.0148f, 0.0002f, 0.0003f}};
+        rs2_intrinsics depthIntrinsics = createIntrinsics(848, 480, 425, RS2_DISTORTION_BROWN_CONRADY, 0);
+        vector<uint16_t> depth;
+        generateDepth(depthIntrinsics.height, depthIntrinsics.width, depth);
+
+        cout << nrIterations << " registrations of depth frames, with rs2::align or the lookup table; at most "
+             << 100 * MAX_DIFFERENT_PIXELS << "% of the aligned pixels may differ" << endl;
+        compareRegistrations("pinhole color", depth, depthIntrinsics,
+                             createIntrinsics(1280, 720, 910, RS2_DISTORTION_INVERSE_BROWN_CONRADY, 0), depthToColor,
+                             DEPTH_UNITS, nrIterations);
+        compareRegistrations("distorted color", depth, depthIntrinsics,
+                             createIntrinsics(1280, 720, 910, RS2_DISTORTION_INVERSE_BROWN_CONRADY, 0.05f),
+                             depthToColor, DEPTH_UNITS, nrIterations);
+        if (argc > 2) {
+            compareRecordedRegistration(stoi(argv[2]), nrIterations);
+        }
+    } catch (exception &ex) {
+        cout << "Caught exception while benchmarking the depth registration: " << ex.what() << endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,105 @@
+#include <AndreiUtils/utilsImages.h>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <RealsenseRecording/recording/ImageRotation.h>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace AndreiUtils;
+using namespace RealsenseRecording;
+using namespace std;
+
+string rotationToString(RotationType rotation) {
+    switch (rotation) {
+        case NO_ROTATION:
+            return "none";
+        case LEFT_90:
+            return "left90";
+        case LEFT_180:
+            return "left180";
+        case LEFT_270:
+            return "left270";
+    }
+    return "unknown";
+}
+
+// in milliseconds per frame
+double measureMilliseconds(const function<void()> &rotate, int nrIterations) {
+    rotate();
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < nrIterations; i++) {
+        rotate();
+    }
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() / nrIterations;
+}
+
+void printRotation(const string &stream, RotationType rotation, double previousMs, double tiledMs, size_t nrBytes) {
+    cout << setw(6) << stream << setw(9) << rotationToString(rotation) << fixed << setprecision(3)
+         << " | copy + imageDataRotation " << setw(7) << previousMs << " ms " << setprecision(2) << setw(6)
+         << (double) nrBytes / previousMs / 1e6 << " GB/s | tiled " << setprecision(3) << setw(7) << tiledMs << " ms "
+         << setprecision(2) << setw(6) << (double) nrBytes / tiledMs / 1e6 << " GB/s | x" << previousMs / tiledMs
+         << endl;
+}
+
+int main(int argc, char **argv) {
+    if (argc > 4 || (argc > 1 && (string(argv[1]) == "-h" || string(argv[1]) == "--help"))) {
+        cout << "Usage: " << argv[0] << " [width] [height] [nrIterations]" << endl;
+        return 1;
+    }
+    try {
+        int width = (argc > 1) ? stoi(argv[1]) : 1280;
+        int height = (argc > 2) ? stoi(argv[2]) : 720;
+        int nrIterations = (argc > 3) ? stoi(argv[3]) : 100;
+        size_t nrPixels = (size_t) width * height;
+
+        vector<uint8_t> image(3 * nrPixels), rotatedImage(3 * nrPixels), previousImage(3 * nrPixels);
+        vector<uint16_t> depth(nrPixels), rotatedDepth(nrPixels), previousDepth(nrPixels);
+        for (size_t i = 0; i < nrPixels; i++) {
+            image[3 * i] = (uint8_t) i;
+            image[3 * i + 1] = (uint8_t) (i >> 8);
+            image[3 * i + 2] = (uint8_t) (i >> 16);
+            depth[i] = (uint16_t) (i * 7);
+        }
+
+        cout << nrIterations << " rotations of " << width << "x" << height << " frames, from the buffered copy "
+             << "(the writers' previous path) or in one pass (tiled)" << endl;
+        for (RotationType rotation: {LEFT_90, LEFT_180, LEFT_270}) {
+            int rotatedHeight, rotatedWidth;
+            ImageRotation::getRotatedSize(rotation, height, width, rotatedHeight, rotatedWidth);
+            // the writers rotated the buffered copies in place, with the size after the rotation
+            double previousImageMs = measureMilliseconds([&]() {
+                memcpy(previousImage.data(), image.data(), image.size());
+                imageDataRotation(previousImage.data(), rotation, TYPE_UINT_8, rotatedHeight, rotatedWidth, 3);
+            }, nrIterations);
+            double tiledImageMs = measureMilliseconds([&]() {
+                ImageRotation::rotateImage(image.data(), height, width, 3 * (size_t) width, rotatedImage.data(),
+                                           rotation);
+            }, nrIterations);
+            printRotation("image", rotation, previousImageMs, tiledImageMs, 2 * image.size());
+
+            double previousDepthMs = measureMilliseconds([&]() {
+                memcpy(previousDepth.data(), depth.data(), depth.size() * sizeof(uint16_t));
+                imageDataRotation((uint8_t *) previousDepth.data(), rotation, TYPE_UINT_16, rotatedHeight,
+                                  rotatedWidth, 1);
+            }, nrIterations);
+            double tiledDepthMs = measureMilliseconds([&]() {
+                ImageRotation::rotateDepth(depth.data(), height, width, width, rotatedDepth.data(), rotation);
+            }, nrIterations);
+            printRotation("depth", rotation, previousDepthMs, tiledDepthMs, 2 * depth.size() * sizeof(uint16_t));
+
+            if (rotatedImage != previousImage || rotatedDepth != previousDepth) {
+                throw runtime_error("The tiled " + rotationToString(rotation) +
+                                    " rotation differs from imageDataRotation");
+            }
+        }
+    } catch (exception &ex) {
+        cout << "Caught exception while benchmarking the rotations: " << ex.what() << endl;
+        return 1;
+    }
+
+    return 0;
+}